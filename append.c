@@ -56,25 +56,127 @@
 #define DEFAULT_DECIMAL_PRECISION	10
 
 /*
- * Internal method to process a long or int number and write into a buffer.
+ * Size of the buffer needed to convert a number in any base down to 2
+ * including a minus sign.
  */
-static	char	*handle_decimal(char *buf, char *limit, const long num, const int base)
+#define NUMBER_BUF_SIZE		(sizeof(PNT_ARITH_TYPE) * 8 + 2)
+
+/* pairs of decimal digits so we can convert two digits at a time */
+static	const char	decimal_pairs[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+/* digits for the bases other than 10 */
+static	const char	base_digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+/*
+ * Convert an unsigned number into a buffer working backwards from the
+ * end pointer.  Base 10 is done two digits at a time out of a table
+ * and bases 16 and 8 with shifts.  A pointer to the first digit will
+ * be returned.
+ */
+static	char	*convert_ulong(char *end_p, unsigned long value, const int base)
 {
-  char *buf_p = buf;
-  buf_p = append_long(buf_p, limit, num, base);
-  append_null(buf_p, limit);
-  return buf_p;
+  char	*digit_p = end_p;
+  int	pair;
+  
+  if (base == 10) {
+    while (value >= 100) {
+      pair = (int)(value % 100) * 2;
+      value /= 100;
+      *--digit_p = decimal_pairs[pair + 1];
+      *--digit_p = decimal_pairs[pair];
+    }
+    if (value >= 10) {
+      pair = (int)value * 2;
+      *--digit_p = decimal_pairs[pair + 1];
+      *--digit_p = decimal_pairs[pair];
+    }
+    else {
+      *--digit_p = '0' + (char)value;
+    }
+  }
+  else if (base == 16) {
+    do {
+      *--digit_p = base_digits[value & 0xf];
+      value >>= 4;
+    } while (value != 0);
+  }
+  else if (base == 8) {
+    do {
+      *--digit_p = base_digits[value & 07];
+      value >>= 3;
+    } while (value != 0);
+  }
+  else {
+    do {
+      *--digit_p = base_digits[value % base];
+      value /= base;
+    } while (value != 0);
+  }
+  
+  return digit_p;
 }
 
 /*
- * Internal method to process a long or int number and write into a buffer.
+ * Convert a signed number into a buffer working backwards from the
+ * end pointer.  A pointer to the first character will be returned.
  */
-static	char	*handle_pointer(char *buf, char *limit, const PNT_ARITH_TYPE num, const int base)
+static	char	*convert_long(char *end_p, const long value, const int base)
 {
-  char *buf_p = buf;
-  buf_p = append_pointer(buf_p, limit, num, base);
-  append_null(buf_p, limit);
-  return buf_p;
+  char	*digit_p;
+  
+  if (value >= 0) {
+    return convert_ulong(end_p, value, base);
+  }
+  
+  /* negate as unsigned so the most negative number works */
+  digit_p = convert_ulong(end_p, - (unsigned long)value, base);
+  *--digit_p = '-';
+  return digit_p;
+}
+
+/*
+ * Convert a pointer value into a buffer working backwards from the
+ * end pointer.  A pointer to the first digit will be returned.
+ */
+static	char	*convert_pointer(char *end_p, PNT_ARITH_TYPE value,
+				 const int base)
+{
+  char	*digit_p = end_p;
+  
+  if (sizeof(PNT_ARITH_TYPE) <= sizeof(unsigned long)) {
+    return convert_ulong(end_p, (unsigned long)value, base);
+  }
+  
+  do {
+    *--digit_p = base_digits[value % base];
+    value /= base;
+  } while (value != 0);
+  
+  return digit_p;
+}
+
+/*
+ * Copy the characters from a converted number to the destination up to
+ * limit pointer.  Pointer to the end of the characters added will be
+ * returned.
+ */
+static	char	*append_digits(char *dest, const char *limit, const char *digit_p,
+			       const char *end_p)
+{
+  while (dest < limit && digit_p < end_p) {
+    *dest++ = *digit_p++;
+  }
+  return dest;
 }
 
 /*
@@ -146,114 +248,111 @@ char	*append_string(char *dest, const char *limit, const char *value)
 /*
  * Append long value argument to destination up to limit pointer.
  * Pointer to the end of the added characters will be returned.  No \0
- * character will be added.  Variant of itoa() written by Lukas
- * Chmela which is released under GPLv3.
+ * character will be added.
  */
 char	*append_long(char *dest, char *limit, long value, int base)
 {
-  char buf[30];
-  char *ptr = buf;
-  char *ptr1 = buf;
-  char tmp_char;
-  long tmp_value;
-
-  /* letters that handle both negative and positive values */
-  char *letters =
-    "zyxwvutsrqponmlkjihgfedcba9876543210123456789abcdefghijklmnopqrstuvwxyz";
-  int mid = 35;
-  /* build the string with low order digits first: 100 => "001" */
-  do {
-    tmp_value = value;
-    value /= base;
-    *ptr++ = letters[mid + tmp_value - (value * base)];
-  } while (value != 0);
-
-  /* apply negative sign */
-  if (tmp_value < 0) {
-    *ptr++ = '-';
-  }
-  *ptr-- = '\0';
-  /* now we swap the characters to move high order digits first */
-  while (ptr1 < ptr) {
-    tmp_char = *ptr;
-    *ptr--= *ptr1;
-    *ptr1++ = tmp_char;
-  }
-  return append_string(dest, limit, buf);
+  char	buf[NUMBER_BUF_SIZE];
+  char	*end_p = buf + sizeof(buf);
+  
+  return append_digits(dest, limit, convert_long(end_p, value, base), end_p);
 }
 
 /*
  * Append unsigned long value argument to destination up to limit
  * pointer.  Pointer to the end of the added characters will be
- * returned.  No \0 character will be added.  Variant of itoa()
- * written by Lukas Chmela. Released under GPLv3.
+ * returned.  No \0 character will be added.
  */
 char	*append_ulong(char *dest, char *limit, unsigned long value, int base)
 {
-  char buf[30];
-  char *ptr = buf;
-  char *ptr1 = buf;
-  char tmp_char;
-  unsigned long tmp_value;
-
-  /* letters that handle both negative and positive values */
-  char *letters =
-    "zyxwvutsrqponmlkjihgfedcba9876543210123456789abcdefghijklmnopqrstuvwxyz";
-  int mid = 35;
-  /* build the string with low order digits first: 100 => "001" */
-  do {
-    tmp_value = value;
-    value /= base;
-    *ptr++ = letters[mid + tmp_value - (value * base)];
-  } while (value != 0);
-
-  *ptr-- = '\0';
-  /* now we swap the characters to move high order digits first */
-  while (ptr1 < ptr) {
-    tmp_char = *ptr;
-    *ptr--= *ptr1;
-    *ptr1++ = tmp_char;
-  }
-  return append_string(dest, limit, buf);
+  char	buf[NUMBER_BUF_SIZE];
+  char	*end_p = buf + sizeof(buf);
+  
+  return append_digits(dest, limit, convert_ulong(end_p, value, base), end_p);
 }
 
 /*
  * Append pointer value argument to destination up to limit pointer.
  * Pointer to the end of the added characters will be returned.  No \0
- * character will be added.  Variant of itoa() written by Lukas
- * Chmela which is released under GPLv3.
+ * character will be added.
  */
 char	*append_pointer(char *dest, char *limit, PNT_ARITH_TYPE value, int base)
 {
-  char buf[30];
-  char *ptr = buf;
-  char *ptr1 = buf;
-  char tmp_char;
-  PNT_ARITH_TYPE tmp_value;
-
-  /* letters that handle both negative and positive values */
-  char *letters =
-    "zyxwvutsrqponmlkjihgfedcba9876543210123456789abcdefghijklmnopqrstuvwxyz";
-  int mid = 35;
-  /* build the string with low order digits first: 100 => "001" */
-  do {
-    tmp_value = value;
-    value /= base;
-    *ptr++ = letters[mid + tmp_value - (value * base)];
-  } while (value != 0);
+  char	buf[NUMBER_BUF_SIZE];
+  char	*end_p = buf + sizeof(buf);
+  
+  return append_digits(dest, limit, convert_pointer(end_p, value, base),
+		       end_p);
+}
 
-  /* apply negative sign */
-  if (tmp_value < 0) {
-    *ptr++ = '-';
+/*
+ * Append string argument to destination up to limit pointer as a
+ * quoted JSON string with the quote, backslash, and control
+ * characters escaped.  A NULL value is written as null.  If the
+ * string does not fit it is cut short but still closed with a quote.
+ * Pointer to the end of the characters added will be returned.  No \0
+ * character will be added.
+ */
+char	*append_json_string(char *dest, const char *limit, const char *value)
+{
+  const unsigned char	*value_p;
+  const char		*end_p;
+  int			ch;
+  
+  if (value == NULL) {
+    return append_string(dest, limit, "null");
   }
-  *ptr-- = '\0';
-  /* now we swap the characters to move high order digits first */
-  while (ptr1 < ptr) {
-    tmp_char = *ptr;
-    *ptr--= *ptr1;
-    *ptr1++ = tmp_char;
+  if (limit - dest < 2) {
+    return dest;
   }
-  return append_string(dest, limit, buf);
+  
+  /* leave room for the closing quote */
+  end_p = limit - 1;
+  *dest++ = '"';
+  
+  for (value_p = (const unsigned char *)value; *value_p != '\0'; value_p++) {
+    ch = *value_p;
+    if (ch >= ' ' && ch != '"' && ch != '\\') {
+      if (dest >= end_p) {
+	break;
+      }
+      *dest++ = ch;
+      continue;
+    }
+    
+    if (ch == '"' || ch == '\\' || ch == '\n' || ch == '\t' || ch == '\r') {
+      if (end_p - dest < 2) {
+	break;
+      }
+      *dest++ = '\\';
+      if (ch == '\n') {
+	*dest++ = 'n';
+      }
+      else if (ch == '\t') {
+	*dest++ = 't';
+      }
+      else if (ch == '\r') {
+	*dest++ = 'r';
+      }
+      else {
+	*dest++ = ch;
+      }
+    }
+    else {
+      if (end_p - dest < 6) {
+	break;
+      }
+      *dest++ = '\\';
+      *dest++ = 'u';
+      *dest++ = '0';
+      *dest++ = '0';
+      *dest++ = base_digits[ch >> 4];
+      *dest++ = base_digits[ch & 0xf];
+    }
+  }
+  
+  *dest++ = '"';
+  return dest;
 }
 
 /*
@@ -264,17 +363,29 @@ char	*append_vformat(char *dest, char *limit, const char *format,
 			va_list args)
 {
   const char *format_p = format;
-  char value_buf[64];
+  /* room for a number in base 2 or a float with its decimals */
+  char value_buf[NUMBER_BUF_SIZE + 32];
   char *value_limit = value_buf + sizeof(value_buf);
   char *dest_p = dest;
   int format_prefix, neg_pad, trunc, long_arg;
   char pad_char;
   char *prefix, *prefix_p;
-  int width_len, trunc_len, prefix_len;
+  int width_len, trunc_len, prefix_len, value_len;
   
   while (*format_p != '\0' && dest_p < limit) {
     if (*format_p != '%') {
-      *dest_p++ = *format_p++;
+      /* copy the run of plain characters up to the next % in one go */
+      const char *literal_p = format_p;
+      int literal_len;
+      while (*format_p != '%' && *format_p != '\0') {
+	format_p++;
+      }
+      literal_len = format_p - literal_p;
+      if (literal_len > limit - dest_p) {
+	literal_len = limit - dest_p;
+      }
+      memcpy(dest_p, literal_p, literal_len);
+      dest_p += literal_len;
       continue;
     }
     format_p++;
@@ -336,7 +447,12 @@ char	*append_vformat(char *dest, char *limit, const char *format,
       
       /* process the % format character */
       
+      /*
+       * Numbers are converted backwards from the end of the value
+       * buffer so we know their length without a strlen.
+       */
       const char *value;
+      value_len = -1;
       if (ch == 'c') {
 	value_buf[0] = (char)va_arg(args, int);
 	value_buf[1] = '\0';
@@ -348,8 +464,8 @@ char	*append_vformat(char *dest, char *limit, const char *format,
 	} else {
 	  num = va_arg(args, int);
 	}
-	handle_decimal(value_buf, value_limit, num, 10);
-	value = value_buf;
+	value = convert_long(value_limit, num, 10);
+	value_len = value_limit - value;
       } else if (ch == 'f') {
 	double num = va_arg(args, double);
 	if (trunc_len < 0) {
@@ -367,8 +483,8 @@ char	*append_vformat(char *dest, char *limit, const char *format,
 	} else {
 	  num = va_arg(args, int);
 	}
-	handle_decimal(value_buf, value_limit, num, 8);
-	value = value_buf;
+	value = convert_long(value_limit, num, 8);
+	value_len = value_limit - value;
 	if (format_prefix) {
 	  prefix = "0";
 	  prefix_len = 1;
@@ -376,13 +492,19 @@ char	*append_vformat(char *dest, char *limit, const char *format,
       } else if (ch == 'p') {
 	DMALLOC_PNT pnt = va_arg(args, DMALLOC_PNT);
 	PNT_ARITH_TYPE num = (PNT_ARITH_TYPE)pnt;
-	handle_pointer(value_buf, value_limit, num, 16);
-	value = value_buf;
+	value = convert_pointer(value_limit, num, 16);
+	value_len = value_limit - value;
 	// because %#p throws a gcc warning, I've decreed that %p has a 0x hex prefix
 	prefix = "0x";
 	prefix_len = 2;
       } else if (ch == 's') {
 	value = va_arg(args, char *);
+	/* take the length once so we can copy the string in one go */
+	if (trunc_len < 0) {
+	  value_len = strlen(value);
+	} else {
+	  value_len = strnlen(value, trunc_len);
+	}
       } else if (ch == 'u') {
 	unsigned long num;
 	if (long_arg) {
@@ -390,10 +512,8 @@ char	*append_vformat(char *dest, char *limit, const char *format,
 	} else {
 	  num = va_arg(args, unsigned int);
 	}
-	char *value_buf_p = value_buf;
-	value_buf_p = append_ulong(value_buf_p, value_limit, num, 10);
-	append_null(value_buf_p, value_limit);
-	value = value_buf;
+	value = convert_ulong(value_limit, num, 10);
+	value_len = value_limit - value;
       } else if (ch == 'x') {
 	long num;
 	if (long_arg) {
@@ -401,12 +521,12 @@ char	*append_vformat(char *dest, char *limit, const char *format,
 	} else {
 	  num = va_arg(args, int);
 	}
-	handle_decimal(value_buf, value_limit, num, 16);
+	value = convert_long(value_limit, num, 16);
+	value_len = value_limit - value;
 	if (format_prefix) {
 	  prefix = "0x";
 	  prefix_len = 2;
 	}
-	value = value_buf;
       } else {
 	continue;
       }
@@ -422,7 +542,13 @@ char	*append_vformat(char *dest, char *limit, const char *format,
       /* handle our pre-padding with spaces or 0s */
       int pad = 0;
       if (width_len >= 0) {
-	if (trunc_len >= 0) {
+	if (value_len >= 0) {
+	  if (trunc_len >= 0 && trunc_len < value_len) {
+	    pad = width_len - trunc_len - prefix_len;
+	  } else {
+	    pad = width_len - value_len - prefix_len;
+	  }
+	} else if (trunc_len >= 0) {
 	  pad = width_len - strnlen(value, trunc_len) - prefix_len;
 	} else {
 	  pad = width_len - strlen(value) - prefix_len;
@@ -444,8 +570,16 @@ char	*append_vformat(char *dest, char *limit, const char *format,
       }
 
       /* copy the value watching our limit */
-      while (*value != '\0' && dest_p < str_limit) {
-	*dest_p++ = *value++;
+      if (value_len >= 0) {
+	if (value_len > str_limit - dest_p) {
+	  value_len = str_limit - dest_p;
+	}
+	memcpy(dest_p, value, value_len);
+	dest_p += value_len;
+      } else {
+	while (*value != '\0' && dest_p < str_limit) {
+	  *dest_p++ = *value++;
+	}
       }
       
       /* maybe handle left over padding which would be negative padding */
@@ -68,6 +68,17 @@ char	*append_ulong(char *dest, char *limit, unsigned long value, int base);
 extern
 char	*append_pointer(char *dest, char *limit, PNT_ARITH_TYPE value, int base);
 
+/*
+ * Append string argument to destination up to limit pointer as a
+ * quoted JSON string with the quote, backslash, and control
+ * characters escaped.  A NULL value is written as null.  If the
+ * string does not fit it is cut short but still closed with a quote.
+ * Pointer to the end of the characters added will be returned.  No \0
+ * character will be added.
+ */
+extern
+char	*append_json_string(char *dest, const char *limit, const char *value);
+
 /*
  * Append a varargs format to destination.  Pointer to the end of the
  * characters added will be returned.  No \0 character will be added.
@@ -25,6 +25,9 @@
  * heap-based strings (such as fence errors) much closer to the error.
  */
 
+/* for memrchr and memmem */
+#define _GNU_SOURCE
+
 #define DMALLOC_DISABLE
 
 #if HAVE_STRING_H
@@ -38,6 +41,11 @@
 #endif
 
 #include "conf.h"
+
+#if HAVE_WMEMCPY
+# include <wchar.h>
+#endif
+
 #include "dmalloc.h"
 
 #include "chunk.h"
@@ -45,27 +53,139 @@
 #include "error.h"
 #include "dmalloc_loc.h"
 #include "arg_check.h"
+#include "return.h"
+
+/* the inline wrappers in dmalloc.h test this bit of the flags */
+#if DMALLOC_FUNC_CHECK_FLAG != DMALLOC_DEBUG_CHECK_FUNCS
+#error DMALLOC_FUNC_CHECK_FLAG does not match the check-funcs token
+#endif
 
 /*
- * Dummy function for checking strlen's arguments.
+ * static int loc_strlen
+ *
+ * Verify a string argument and return its length.  If the string is
+ * in the heap then the length comes from the pointer check so we
+ * only walk the string once.
+ *
+ * Returns the length of the string.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * func -> Function which is checking the string.
+ *
+ * str -> String we are checking.
  */
 static	int	loc_strlen(const char *file, const int line,
 			   const char *func, const char *str)
 {
-  int		len = 0;
-  const	char	*str_p;
+  dmalloc_range_t	range;
   
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if (! dmalloc_verify_pnt(file, line, func, str, 0 /* not exact */, -1)) {
+    range.vr_pnt = str;
+    range.vr_min_size = -1;
+    if (! dmalloc_verify_ranges(file, line, func, 0 /* not exact */, &range,
+				1)) {
       dmalloc_message("bad pointer argument found in %s", func);
     }
+    else if (range.vr_strlen >= 0) {
+      return range.vr_strlen;
+    }
   }
   
-  for (str_p = str; *str_p != '\0'; str_p++) {
-    len++;
+  return strlen(str);
+}
+
+/*
+ * static int verify_pair
+ *
+ * Verify two pointer arguments with one entry into the library.
+ *
+ * Returns MALLOC_VERIFY_NOERROR on success or MALLOC_VERIFY_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * func -> Function which is checking the pointers.
+ *
+ * pnt1 -> First pointer we are checking.
+ *
+ * min_size1 -> Bytes the first pointer needs to hold or -1 for
+ * strlen(pnt1) + 1.
+ *
+ * pnt2 -> Second pointer we are checking.
+ *
+ * min_size2 -> Bytes the second pointer needs to hold or -1 for
+ * strlen(pnt2) + 1.
+ */
+static	int	verify_pair(const char *file, const int line,
+			    const char *func, const void *pnt1,
+			    const int min_size1, const void *pnt2,
+			    const int min_size2)
+{
+  dmalloc_range_t	ranges[2];
+  
+  ranges[0].vr_pnt = pnt1;
+  ranges[0].vr_min_size = min_size1;
+  ranges[1].vr_pnt = pnt2;
+  ranges[1].vr_min_size = min_size2;
+  
+  return dmalloc_verify_ranges(file, line, func, 0 /* not exact */, ranges,
+			       2);
+}
+
+/*
+ * static void check_args
+ *
+ * Verify the pointer arguments of a function if the check-funcs
+ * token is enabled and log a message if one of them is bad.  This is
+ * the common core of the wrappers below.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * func -> Function whose arguments we are checking.
+ *
+ * pnt1 -> First pointer we are checking.
+ *
+ * min_size1 -> Bytes the first pointer needs to hold, 0 for none, or
+ * -1 for strlen(pnt1) + 1.
+ *
+ * pnt2 -> Second pointer we are checking or NULL if none.
+ *
+ * min_size2 -> Bytes the second pointer needs to hold, 0 for none, or
+ * -1 for strlen(pnt2) + 1.
+ */
+static	void	check_args(const char *file, const int line,
+			   const char *func, const void *pnt1,
+			   const int min_size1, const void *pnt2,
+			   const int min_size2)
+{
+  int	ret;
+  
+  if (! BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
+    return;
   }
   
-  return len;
+  if (pnt2 == NULL) {
+    ret = dmalloc_verify_pnt(file, line, func, pnt1, 0 /* not exact */,
+			     min_size1);
+  }
+  else {
+    ret = verify_pair(file, line, func, pnt1, min_size1, pnt2, min_size2);
+  }
+  if (! ret) {
+    dmalloc_message("bad pointer argument found in %s", func);
+  }
 }
 
 #if HAVE_ATOI
@@ -74,12 +194,7 @@ static	int	loc_strlen(const char *file, const int line,
  */
 int	_dmalloc_atoi(const char *file, const int line, const char *str)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if (! dmalloc_verify_pnt(file, line, "atoi", str,
-			     0 /* not exact */, -1)) {
-      dmalloc_message("bad pointer argument found in atoi");
-    }
-  }
+  check_args(file, line, "atoi", str, -1, NULL, 0);
   return atoi(str);
 }
 #endif /* HAVE_ATOI */
@@ -90,12 +205,7 @@ int	_dmalloc_atoi(const char *file, const int line, const char *str)
  */
 long	_dmalloc_atol(const char *file, const int line, const char *str)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if (! dmalloc_verify_pnt(file, line, "atol", str,
-			     0 /* not exact */, -1)) {
-      dmalloc_message("bad pointer argument found in atol");
-    }
-  }
+  check_args(file, line, "atol", str, -1, NULL, 0);
   return atol(str);
 }
 #endif /* HAVE_ATOL */
@@ -107,14 +217,7 @@ long	_dmalloc_atol(const char *file, const int line, const char *str)
 int	_dmalloc_bcmp(const char *file, const int line,
 		      const void *b1, const void *b2, const DMALLOC_SIZE len)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if ((! dmalloc_verify_pnt(file, line, "bcmp", b1,
-			      0 /* not exact */, len))
-	|| (! dmalloc_verify_pnt(file, line, "bcmp", b2,
-				 0 /* not exact */, len))) {
-      dmalloc_message("bad pointer argument found in bcmp");
-    }
-  }
+  check_args(file, line, "bcmp", b1, len, b2, len);
   return bcmp(b1, b2, len);
 }
 #endif /* HAVE_BCMP */
@@ -126,14 +229,7 @@ int	_dmalloc_bcmp(const char *file, const int line,
 void	_dmalloc_bcopy(const char *file, const int line,
 		       const void *from, void *to, const DMALLOC_SIZE len)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if ((! dmalloc_verify_pnt(file, line, "bcopy", from,
-			      0 /* not exact */, len))
-	|| (! dmalloc_verify_pnt(file, line, "bcopy", to,
-				 0 /* not exact */, len))) {
-      dmalloc_message("bad pointer argument found in bcopy");
-    }
-  }
+  check_args(file, line, "bcopy", from, len, to, len);
   bcopy(from, to, len);
 }
 #endif /* HAVE_BCOPY */
@@ -145,12 +241,7 @@ void	_dmalloc_bcopy(const char *file, const int line,
 void	_dmalloc_bzero(const char *file, const int line,
 		       void *buf, const DMALLOC_SIZE len)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if (! dmalloc_verify_pnt(file, line, "bzero", buf,
-			     0 /* not exact */, len)) {
-      dmalloc_message("bad pointer argument found in bzero");
-    }
-  }
+  check_args(file, line, "bzero", buf, len, NULL, 0);
   bzero(buf, len);
 }
 #endif /* HAVE_BZERO */
@@ -162,12 +253,7 @@ void	_dmalloc_bzero(const char *file, const int line,
 char	*_dmalloc_index(const char *file, const int line,
 			const char *str, const char ch)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if (! dmalloc_verify_pnt(file, line, "index", str,
-			     0 /* not exact */, -1)) {
-      dmalloc_message("bad pointer argument found in index");
-    }
-  }
+  check_args(file, line, "index", str, -1, NULL, 0);
   return (char *)index(str, ch);
 }
 #endif /* HAVE_INDEX */
@@ -194,10 +280,7 @@ void	*_dmalloc_memccpy(const char *file, const int line,
     min_size = src_p - (char *)src;
     
     /* maybe len maybe first ch */
-    if ((! dmalloc_verify_pnt(file, line, "memccpy", dest,
-			      0 /* not exact */, min_size))
-	|| (! dmalloc_verify_pnt(file, line, "memccpy", src,
-				 0 /* not exact */, min_size))) {
+    if (! verify_pair(file, line, "memccpy", dest, min_size, src, min_size)) {
       dmalloc_message("bad pointer argument found in memccpy");
     }
   }
@@ -212,12 +295,7 @@ void	*_dmalloc_memccpy(const char *file, const int line,
 void	*_dmalloc_memchr(const char *file, const int line,
 			 const void *s1, const int ch, const DMALLOC_SIZE len)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if (! dmalloc_verify_pnt(file, line, "memchr", s1,
-			     0 /* not exact */, len)) {
-      dmalloc_message("bad pointer argument found in memchr");
-    }
-  }
+  check_args(file, line, "memchr", s1, len, NULL, 0);
   return (void *)memchr(s1, ch, len);
 }
 #endif /* HAVE_MEMCHR */
@@ -229,14 +307,7 @@ void	*_dmalloc_memchr(const char *file, const int line,
 int	_dmalloc_memcmp(const char *file, const int line,
 			const void *b1, const void *b2, const DMALLOC_SIZE len)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if ((! dmalloc_verify_pnt(file, line, "memcmp", b1,
-			      0 /* not exact */, len))
-	|| (! dmalloc_verify_pnt(file, line, "memcmp", b2,
-				 0 /* not exact */, len))) {
-      dmalloc_message("bad pointer argument found in memcmp");
-    }
-  }
+  check_args(file, line, "memcmp", b1, len, b2, len);
   return memcmp(b1, b2, len);
 }
 #endif /* HAVE_MEMCMP */
@@ -249,10 +320,7 @@ void	*_dmalloc_memcpy(const char *file, const int line,
 			 void *to, const void *from, const DMALLOC_SIZE len)
 {
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if ((! dmalloc_verify_pnt(file, line, "memcpy", to,
-			      0 /* not exact */, len))
-	|| (! dmalloc_verify_pnt(file, line, "memcpy", from,
-				 0 /* not exact */, len))) {
+    if (! verify_pair(file, line, "memcpy", to, len, from, len)) {
       dmalloc_message("bad pointer argument found in memcpy");
     }
     
@@ -272,6 +340,20 @@ void	*_dmalloc_memcpy(const char *file, const int line,
 }
 #endif /* HAVE_MEMCPY */
 
+#if HAVE_MEMMEM
+/*
+ * Dummy function for checking memmem's arguments.
+ */
+void	*_dmalloc_memmem(const char *file, const int line,
+			 const void *haystack, const DMALLOC_SIZE haystack_len,
+			 const void *needle, const DMALLOC_SIZE needle_len)
+{
+  check_args(file, line, "memmem", haystack, haystack_len, needle,
+	     needle_len);
+  return (void *)memmem(haystack, haystack_len, needle, needle_len);
+}
+#endif /* HAVE_MEMMEM */
+
 #if HAVE_MEMMOVE
 /*
  * Dummy function for checking memmove's arguments.
@@ -279,18 +361,23 @@ void	*_dmalloc_memcpy(const char *file, const int line,
 void	*_dmalloc_memmove(const char *file, const int line,
 			  void *to, const void *from, const DMALLOC_SIZE len)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if ((! dmalloc_verify_pnt(file, line, "memmove", to,
-			      0 /* not exact */, len))
-	|| (! dmalloc_verify_pnt(file, line, "memmove", from,
-				 0 /* not exact */, len))) {
-      dmalloc_message("bad pointer argument found in memmove");
-    }
-  }
+  check_args(file, line, "memmove", to, len, from, len);
   return (void *)memmove(to, from, len);
 }
 #endif /* HAVE_MEMMOVE */
 
+#if HAVE_MEMRCHR
+/*
+ * Dummy function for checking memrchr's arguments.
+ */
+void	*_dmalloc_memrchr(const char *file, const int line,
+			  const void *s1, const int ch, const DMALLOC_SIZE len)
+{
+  check_args(file, line, "memrchr", s1, len, NULL, 0);
+  return (void *)memrchr(s1, ch, len);
+}
+#endif /* HAVE_MEMRCHR */
+
 #if HAVE_MEMSET
 /*
  * Dummy function for checking memset's arguments.
@@ -298,12 +385,7 @@ void	*_dmalloc_memmove(const char *file, const int line,
 void	*_dmalloc_memset(const char *file, const int line, void *buf,
 			 const int ch, const DMALLOC_SIZE len)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if (! dmalloc_verify_pnt(file, line, "memset", buf,
-			     0 /* not exact */, len)) {
-      dmalloc_message("bad pointer argument found in memset");
-    }
-  }
+  check_args(file, line, "memset", buf, len, NULL, 0);
   return (void *)memset(buf, ch, len);
 }
 #endif /* HAVE_MEMSET */
@@ -315,16 +397,28 @@ void	*_dmalloc_memset(const char *file, const int line, void *buf,
 char	*_dmalloc_rindex(const char *file, const int line,
 			 const char *str, const char ch)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if (! dmalloc_verify_pnt(file, line, "rindex", str,
-			     0 /* not exact */, -1)) {
-      dmalloc_message("bad pointer argument found in rindex");
-    }
-  }
+  check_args(file, line, "rindex", str, -1, NULL, 0);
   return (char *)rindex(str, ch);
 }
 #endif /* HAVE_RINDEX */
 
+#if HAVE_STPCPY
+/*
+ * Dummy function for checking stpcpy's arguments.
+ */
+char	*_dmalloc_stpcpy(const char *file, const int line,
+			 char *to, const char *from)
+{
+  int	len;
+  
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
+    len = loc_strlen(file, line, "stpcpy", from);
+    check_args(file, line, "stpcpy", to, len + 1, NULL, 0);
+  }
+  return (char *)stpcpy(to, from);
+}
+#endif /* HAVE_STPCPY */
+
 #if HAVE_STRCASECMP
 /*
  * Dummy function for checking strcasecmp's arguments.
@@ -332,14 +426,7 @@ char	*_dmalloc_rindex(const char *file, const int line,
 int	_dmalloc_strcasecmp(const char *file, const int line,
 			    const char *s1, const char *s2)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if ((! dmalloc_verify_pnt(file, line, "strcasecmp", s1,
-			      0 /* not exact */, -1))
-	|| (! dmalloc_verify_pnt(file, line, "strcasecmp", s2,
-				 0 /* not exact */, -1))) {
-      dmalloc_message("bad pointer argument found in strcasecmp");
-    }
-  }
+  check_args(file, line, "strcasecmp", s1, -1, s2, -1);
   return strcasecmp(s1, s2);
 }
 #endif /* HAVE_STRCASECMP */
@@ -351,13 +438,14 @@ int	_dmalloc_strcasecmp(const char *file, const int line,
 char	*_dmalloc_strcat(const char *file, const int line,
 			 char *to, const char *from)
 {
+  int	len;
+  
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if ((! dmalloc_verify_pnt(file, line, "strcat", to,
-			      0 /* not exact */,
-			      loc_strlen(file, line, "strcat", to)
-			      + loc_strlen(file, line, "strcat", from) + 1))
-	|| (! dmalloc_verify_pnt(file, line, "strcat", from,
-				 0 /* not exact */, -1))) {
+    /* the lengths come back from the checks of both strings */
+    len = loc_strlen(file, line, "strcat", to)
+      + loc_strlen(file, line, "strcat", from);
+    if (! dmalloc_verify_pnt(file, line, "strcat", to, 0 /* not exact */,
+			     len + 1)) {
       dmalloc_message("bad pointer argument found in strcat");
     }
   }
@@ -372,12 +460,7 @@ char	*_dmalloc_strcat(const char *file, const int line,
 char	*_dmalloc_strchr(const char *file, const int line,
 			 const char *str, const int ch)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if (! dmalloc_verify_pnt(file, line, "strchr", str,
-			     0 /* not exact */, -1)) {
-      dmalloc_message("bad pointer argument found in strchr");
-    }
-  }
+  check_args(file, line, "strchr", str, -1, NULL, 0);
   return (char *)strchr(str, ch);
 }
 #endif /* HAVE_STRCHR */
@@ -389,14 +472,7 @@ char	*_dmalloc_strchr(const char *file, const int line,
 int	_dmalloc_strcmp(const char *file, const int line,
 			const char *s1, const char *s2)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if ((! dmalloc_verify_pnt(file, line, "strcmp", s1,
-			      0 /* not exact */, -1))
-	|| (! dmalloc_verify_pnt(file, line, "strcmp", s2,
-				 0 /* not exact */, -1))) {
-      dmalloc_message("bad pointer argument found in strcmp");
-    }
-  }
+  check_args(file, line, "strcmp", s1, -1, s2, -1);
   return strcmp(s1, s2);
 }
 #endif /* HAVE_STRCMP */
@@ -408,12 +484,13 @@ int	_dmalloc_strcmp(const char *file, const int line,
 char	*_dmalloc_strcpy(const char *file, const int line,
 			 char *to, const char *from)
 {
+  int	len;
+  
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if ((! dmalloc_verify_pnt(file, line, "strcpy", to,
-			      0 /* not exact */,
-			      loc_strlen(file, line, "strcpy", from) + 1))
-	|| (! dmalloc_verify_pnt(file, line, "strcpy", from,
-				 0 /* not exact */, -1))) {
+    /* from is checked while we get its length */
+    len = loc_strlen(file, line, "strcpy", from);
+    if (! dmalloc_verify_pnt(file, line, "strcpy", to, 0 /* not exact */,
+			     len + 1)) {
       dmalloc_message("bad pointer argument found in strcpy");
     }
   }
@@ -428,17 +505,59 @@ char	*_dmalloc_strcpy(const char *file, const int line,
 int	_dmalloc_strcspn(const char *file, const int line,
 			 const char *str, const char *list)
 {
+  check_args(file, line, "strcspn", str, -1, list, -1);
+  return strcspn(str, list);
+}
+#endif /* HAVE_STRCSPN */
+
+#if HAVE_STRLCAT
+/*
+ * Dummy function for checking strlcat's arguments.
+ */
+DMALLOC_SIZE	_dmalloc_strlcat(const char *file, const int line,
+				 char *to, const char *from,
+				 const DMALLOC_SIZE size)
+{
+  int	to_len, from_len;
+  
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if ((! dmalloc_verify_pnt(file, line, "strcspn", str,
-			      0 /* not exact */, -1))
-	|| (! dmalloc_verify_pnt(file, line, "strcspn", list,
-				 0 /* not exact */, -1))) {
-      dmalloc_message("bad pointer argument found in strcspn");
+    /* to is only looked at up to size bytes */
+    to_len = strnlen(to, size);
+    from_len = loc_strlen(file, line, "strlcat", from);
+    if (to_len + from_len + 1 < size) {
+      check_args(file, line, "strlcat", to, to_len + from_len + 1, NULL, 0);
+    }
+    else {
+      check_args(file, line, "strlcat", to, size, NULL, 0);
     }
   }
-  return strcspn(str, list);
+  return strlcat(to, from, size);
 }
-#endif /* HAVE_STRCSPN */
+#endif /* HAVE_STRLCAT */
+
+#if HAVE_STRLCPY
+/*
+ * Dummy function for checking strlcpy's arguments.
+ */
+DMALLOC_SIZE	_dmalloc_strlcpy(const char *file, const int line,
+				 char *to, const char *from,
+				 const DMALLOC_SIZE size)
+{
+  int	len;
+  
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
+    /* from is always read to the end but to only gets size bytes */
+    len = loc_strlen(file, line, "strlcpy", from);
+    if (len + 1 < size) {
+      check_args(file, line, "strlcpy", to, len + 1, NULL, 0);
+    }
+    else {
+      check_args(file, line, "strlcpy", to, size, NULL, 0);
+    }
+  }
+  return strlcpy(to, from, size);
+}
+#endif /* HAVE_STRLCPY */
 
 #if HAVE_STRLEN
 /*
@@ -447,13 +566,7 @@ int	_dmalloc_strcspn(const char *file, const int line,
 DMALLOC_SIZE	_dmalloc_strlen(const char *file, const int line,
 				const char *str)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if (! dmalloc_verify_pnt(file, line, "strlen", str,
-			     0 /* not exact */, -1)) {
-      dmalloc_message("bad pointer argument found in strlen");
-    }
-  }
-  
+  /* the pointer check is done in loc_strlen */
   return loc_strlen(file, line, "strlen", str);
 }
 #endif
@@ -479,10 +592,7 @@ int	_dmalloc_strncasecmp(const char *file, const int line,
     }
     min_size = s1_p - s1;
     
-    if ((! dmalloc_verify_pnt(file, line, "strncasecmp", s1,
-			      0 /* not exact */, min_size))
-	|| (! dmalloc_verify_pnt(file, line, "strncasecmp", s2,
-				 0 /* not exact */, min_size))) {
+    if (! verify_pair(file, line, "strncasecmp", s1, min_size, s2, min_size)) {
       dmalloc_message("bad pointer argument found in strncasecmp");
     }
   }
@@ -511,12 +621,9 @@ char	*_dmalloc_strncat(const char *file, const int line,
     min_size = from_p - from;
     
     /* either len or nullc */
-    if ((! dmalloc_verify_pnt(file, line, "strncat", to,
-			      0 /* not exact */,
-			      loc_strlen(file, line, "strncat", to) + min_size
-			      + 1))
-	|| (! dmalloc_verify_pnt(file, line, "strncat", from,
-				 0 /* not exact */, min_size))) {
+    if (! verify_pair(file, line, "strncat", to,
+		      loc_strlen(file, line, "strncat", to) + min_size + 1,
+		      from, min_size)) {
       dmalloc_message("bad pointer argument found in strncat");
     }
   }
@@ -546,10 +653,7 @@ int	_dmalloc_strncmp(const char *file, const int line,
     min_size = s1_p - s1;
     
     /* either len or nullc */
-    if ((! dmalloc_verify_pnt(file, line, "strncmp", s1,
-			      0 /* not exact */, min_size))
-	|| (! dmalloc_verify_pnt(file, line, "strncmp", s2,
-				 0 /* not exact */, min_size))) {
+    if (! verify_pair(file, line, "strncmp", s1, min_size, s2, min_size)) {
       dmalloc_message("bad pointer argument found in strncmp");
     }
   }
@@ -578,10 +682,7 @@ char	*_dmalloc_strncpy(const char *file, const int line,
     min_size = from_p - from;
     
     /* len or until nullc */
-    if ((! dmalloc_verify_pnt(file, line, "strncpy", to,
-			      0 /* not exact */, min_size))
-	|| (! dmalloc_verify_pnt(file, line, "strncpy", from,
-				 0 /* not exact */, min_size))) {
+    if (! verify_pair(file, line, "strncpy", to, min_size, from, min_size)) {
       dmalloc_message("bad pointer argument found in strncpy");
     }
   }
@@ -589,6 +690,24 @@ char	*_dmalloc_strncpy(const char *file, const int line,
 }
 #endif /* HAVE_STRNCPY */
 
+#if HAVE_STRNLEN
+/*
+ * Dummy function for checking strnlen's arguments.
+ */
+DMALLOC_SIZE	_dmalloc_strnlen(const char *file, const int line,
+				 const char *str, const DMALLOC_SIZE max_len)
+{
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
+    if (! dmalloc_verify_pnt_strsize(file, line, "strnlen", str,
+				     0 /* not exact */, 1 /* strlen */,
+				     max_len)) {
+      dmalloc_message("bad pointer argument found in strnlen");
+    }
+  }
+  return strnlen(str, max_len);
+}
+#endif /* HAVE_STRNLEN */
+
 #if HAVE_STRPBRK
 /*
  * Dummy function for checking strpbrk's arguments.
@@ -596,14 +715,7 @@ char	*_dmalloc_strncpy(const char *file, const int line,
 char	*_dmalloc_strpbrk(const char *file, const int line,
 			  const char *str, const char *list)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if ((! dmalloc_verify_pnt(file, line, "strpbrk", str,
-			      0 /* not exact */, -1))
-	|| (! dmalloc_verify_pnt(file, line, "strpbrk", list,
-				 0 /* not exact */, -1))) {
-      dmalloc_message("bad pointer argument found in strpbrk");
-    }
-  }
+  check_args(file, line, "strpbrk", str, -1, list, -1);
   return (char *)strpbrk(str, list);
 }
 #endif /* HAVE_STRPBRK */
@@ -615,12 +727,7 @@ char	*_dmalloc_strpbrk(const char *file, const int line,
 char	*_dmalloc_strrchr(const char *file, const int line,
 			  const char *str, const int ch)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if (! dmalloc_verify_pnt(file, line, "strrchr", str,
-			     0 /* not exact */, -1)) {
-      dmalloc_message("bad pointer argument found in strrchr");
-    }
-  }
+  check_args(file, line, "strrchr", str, -1, NULL, 0);
   return (char *)strrchr(str, ch);
 }
 #endif /* HAVE_STRRCHR */
@@ -632,14 +739,7 @@ char	*_dmalloc_strrchr(const char *file, const int line,
 int	_dmalloc_strspn(const char *file, const int line,
 			const char *str, const char *list)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if ((! dmalloc_verify_pnt(file, line, "strspn", str,
-			      0 /* not exact */, -1))
-	|| (! dmalloc_verify_pnt(file, line, "strspn", list,
-				 0 /* not exact */, -1))) {
-      dmalloc_message("bad pointer argument found in strspn");
-    }
-  }
+  check_args(file, line, "strspn", str, -1, list, -1);
   return strspn(str, list);
 }
 #endif /* HAVE_STRSPN */
@@ -651,14 +751,7 @@ int	_dmalloc_strspn(const char *file, const int line,
 char	*_dmalloc_strstr(const char *file, const int line,
 			 const char *str, const char *pat)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if ((! dmalloc_verify_pnt(file, line, "strstr", str,
-			      0 /* not exact */, -1))
-	|| (! dmalloc_verify_pnt(file, line, "strstr", pat,
-				 0 /* not exact */, -1))) {
-      dmalloc_message("bad pointer argument found in strstr");
-    }
-  }
+  check_args(file, line, "strstr", str, -1, pat, -1);
   return (char *)strstr(str, pat);
 }
 #endif /* HAVE_STRSTR */
@@ -671,14 +764,177 @@ char	*_dmalloc_strtok(const char *file, const int line,
 			 char *str, const char *sep)
 {
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if ((str != NULL
-	 && (! dmalloc_verify_pnt(file, line, "strtok", str,
-				  0 /* not exact */, -1)))
-	|| (! dmalloc_verify_pnt(file, line, "strtok", sep,
-				 0 /* not exact */, -1))) {
+    if (str == NULL) {
+      if (! dmalloc_verify_pnt(file, line, "strtok", sep,
+			       0 /* not exact */, -1)) {
+	dmalloc_message("bad pointer argument found in strtok");
+      }
+    }
+    else if (! verify_pair(file, line, "strtok", str, -1, sep, -1)) {
       dmalloc_message("bad pointer argument found in strtok");
     }
   }
   return (char *)strtok(str, sep);
 }
 #endif /* HAVE_STRTOK */
+
+#if HAVE_WMEMCPY
+/*
+ * Dummy function for checking wmemcpy's arguments.  The pointers are
+ * void so dmalloc.h does not need wchar.h.
+ */
+void	*_dmalloc_wmemcpy(const char *file, const int line,
+			  void *to, const void *from, const DMALLOC_SIZE len)
+{
+  int	size = len * sizeof(wchar_t);
+  
+  check_args(file, line, "wmemcpy", to, size, from, size);
+  return (void *)wmemcpy((wchar_t *)to, (const wchar_t *)from, len);
+}
+#endif /* HAVE_WMEMCPY */
+
+/**************************** fortify functions ******************************/
+
+#if HAVE___CHK_FAIL
+/*
+ * The following replace the _chk functions which the compiler calls
+ * under _FORTIFY_SOURCE when it knows the size of the destination.
+ * Code which was not compiled with dmalloc.h still comes through
+ * these so we can check its arguments.
+ */
+
+/* system routine which reports the overflow and aborts */
+extern	void	__chk_fail(void);
+
+/*
+ * static void check_fortify
+ *
+ * Common core of the fortify functions.  Fail like the system would
+ * if the write does not fit in the destination and otherwise check
+ * the arguments like the other wrappers.
+ *
+ * ARGUMENTS:
+ *
+ * file -> Return-address of the caller.
+ *
+ * func -> Function whose arguments we are checking.
+ *
+ * dest -> Destination pointer.
+ *
+ * size -> Number of bytes which will be written to dest.
+ *
+ * dest_size -> Size of dest as known by the compiler.
+ *
+ * src -> Source pointer which is read for size bytes or NULL if none.
+ */
+static	void	check_fortify(const char *file, const char *func,
+			      const void *dest, const DMALLOC_SIZE size,
+			      const DMALLOC_SIZE dest_size, const void *src)
+{
+  if (size > dest_size) {
+    dmalloc_message("%s: writing %lu bytes into a buffer of %lu", func,
+		    (unsigned long)size, (unsigned long)dest_size);
+    __chk_fail();
+  }
+  
+  /* our own code can get here if the library was fortified */
+  if (! _dmalloc_in_library()) {
+    check_args(file, 0 /* no line */, func, dest, size, src, size);
+  }
+}
+
+#if HAVE___MEMCPY_CHK
+/*
+ * Checked version of the fortify memcpy.
+ */
+void	*__memcpy_chk(void *to, const void *from, const DMALLOC_SIZE len,
+		      const DMALLOC_SIZE to_size)
+{
+  char	*file;
+  
+  GET_RET_ADDR(file);
+  check_fortify(file, "memcpy", to, len, to_size, from);
+  return (void *)memcpy(to, from, len);
+}
+#endif /* HAVE___MEMCPY_CHK */
+
+#if HAVE___MEMMOVE_CHK
+/*
+ * Checked version of the fortify memmove.
+ */
+void	*__memmove_chk(void *to, const void *from, const DMALLOC_SIZE len,
+		       const DMALLOC_SIZE to_size)
+{
+  char	*file;
+  
+  GET_RET_ADDR(file);
+  check_fortify(file, "memmove", to, len, to_size, from);
+  return (void *)memmove(to, from, len);
+}
+#endif /* HAVE___MEMMOVE_CHK */
+
+#if HAVE___MEMSET_CHK
+/*
+ * Checked version of the fortify memset.
+ */
+void	*__memset_chk(void *buf, const int ch, const DMALLOC_SIZE len,
+		      const DMALLOC_SIZE buf_size)
+{
+  char	*file;
+  
+  GET_RET_ADDR(file);
+  check_fortify(file, "memset", buf, len, buf_size, NULL);
+  return (void *)memset(buf, ch, len);
+}
+#endif /* HAVE___MEMSET_CHK */
+
+#if HAVE___STPCPY_CHK
+/*
+ * Checked version of the fortify stpcpy.
+ */
+char	*__stpcpy_chk(char *to, const char *from, const DMALLOC_SIZE to_size)
+{
+  char	*file;
+  
+  GET_RET_ADDR(file);
+  check_fortify(file, "stpcpy", to, strlen(from) + 1, to_size, from);
+  return (char *)stpcpy(to, from);
+}
+#endif /* HAVE___STPCPY_CHK */
+
+#if HAVE___STRCAT_CHK
+/*
+ * Checked version of the fortify strcat.
+ */
+char	*__strcat_chk(char *to, const char *from, const DMALLOC_SIZE to_size)
+{
+  char		*file;
+  DMALLOC_SIZE	to_len;
+  
+  GET_RET_ADDR(file);
+  /* the check of to covers the string already in there */
+  to_len = strlen(to);
+  check_fortify(file, "strcat", to, to_len + strlen(from) + 1, to_size,
+		NULL);
+  if (! _dmalloc_in_library()) {
+    check_args(file, 0 /* no line */, "strcat", from, -1, NULL, 0);
+  }
+  return (char *)strcat(to, from);
+}
+#endif /* HAVE___STRCAT_CHK */
+
+#if HAVE___STRCPY_CHK
+/*
+ * Checked version of the fortify strcpy.
+ */
+char	*__strcpy_chk(char *to, const char *from, const DMALLOC_SIZE to_size)
+{
+  char	*file;
+  
+  GET_RET_ADDR(file);
+  check_fortify(file, "strcpy", to, strlen(from) + 1, to_size, from);
+  return (char *)strcpy(to, from);
+}
+#endif /* HAVE___STRCPY_CHK */
+
+#endif /* HAVE___CHK_FAIL */
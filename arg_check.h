@@ -116,6 +116,16 @@ void	*_dmalloc_memcpy(const char *file, const int line,
 			 void *to, const void *from, const DMALLOC_SIZE len);
 #endif /* if HAVE_MEMCPY */
 
+#if HAVE_MEMMEM
+/*
+ * Dummy function for checking memmem's arguments.
+ */
+extern
+void	*_dmalloc_memmem(const char *file, const int line,
+			 const void *haystack, const DMALLOC_SIZE haystack_len,
+			 const void *needle, const DMALLOC_SIZE needle_len);
+#endif /* if HAVE_MEMMEM */
+
 #if HAVE_MEMMOVE
 /*
  * Dummy function for checking memmove's arguments.
@@ -125,6 +135,15 @@ void	*_dmalloc_memmove(const char *file, const int line,
 			  void *to, const void *from, const DMALLOC_SIZE len);
 #endif /* if HAVE_MEMMOVE */
 
+#if HAVE_MEMRCHR
+/*
+ * Dummy function for checking memrchr's arguments.
+ */
+extern
+void	*_dmalloc_memrchr(const char *file, const int line,
+			  const void *s1, const int ch, const DMALLOC_SIZE len);
+#endif /* if HAVE_MEMRCHR */
+
 #if HAVE_MEMSET
 /*
  * Dummy function for checking memset's arguments.
@@ -143,6 +162,15 @@ char	*_dmalloc_rindex(const char *file, const int line,
 			 const char *str, const char ch);
 #endif /* if HAVE_RINDEX */
 
+#if HAVE_STPCPY
+/*
+ * Dummy function for checking stpcpy's arguments.
+ */
+extern
+char	*_dmalloc_stpcpy(const char *file, const int line,
+			 char *to, const char *from);
+#endif /* if HAVE_STPCPY */
+
 #if HAVE_STRCASECMP
 /*
  * Dummy function for checking strcasecmp's arguments.
@@ -197,6 +225,26 @@ int	_dmalloc_strcspn(const char *file, const int line,
 			 const char *str, const char *list);
 #endif /* if HAVE_STRCSPN */
 
+#if HAVE_STRLCAT
+/*
+ * Dummy function for checking strlcat's arguments.
+ */
+extern
+DMALLOC_SIZE	_dmalloc_strlcat(const char *file, const int line,
+				 char *to, const char *from,
+				 const DMALLOC_SIZE size);
+#endif /* if HAVE_STRLCAT */
+
+#if HAVE_STRLCPY
+/*
+ * Dummy function for checking strlcpy's arguments.
+ */
+extern
+DMALLOC_SIZE	_dmalloc_strlcpy(const char *file, const int line,
+				 char *to, const char *from,
+				 const DMALLOC_SIZE size);
+#endif /* if HAVE_STRLCPY */
+
 #if HAVE_STRLEN
 /*
  * Dummy function for checking strlen's arguments.
@@ -244,6 +292,15 @@ char	*_dmalloc_strncpy(const char *file, const int line,
 			  char *to, const char *from, const DMALLOC_SIZE len);
 #endif /* if HAVE_STRNCPY */
 
+#if HAVE_STRNLEN
+/*
+ * Dummy function for checking strnlen's arguments.
+ */
+extern
+DMALLOC_SIZE	_dmalloc_strnlen(const char *file, const int line,
+				 const char *str, const DMALLOC_SIZE max_len);
+#endif /* if HAVE_STRNLEN */
+
 #if HAVE_STRPBRK
 /*
  * Dummy function for checking strpbrk's arguments.
@@ -289,6 +346,16 @@ char	*_dmalloc_strtok(const char *file, const int line,
 			 char *str, const char *sep);
 #endif /* if HAVE_STRTOK */
 
+#if HAVE_WMEMCPY
+/*
+ * Dummy function for checking wmemcpy's arguments.  The pointers are
+ * void so dmalloc.h does not need wchar.h.
+ */
+extern
+void	*_dmalloc_wmemcpy(const char *file, const int line,
+			  void *to, const void *from, const DMALLOC_SIZE len);
+#endif /* if HAVE_WMEMCPY */
+
 /*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
 
 #endif /* ! __ARG_CHECK_H__ */
@@ -32,6 +32,9 @@
 #if HAVE_STDLIB_H
 # include <stdlib.h>
 #endif
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for write, getpid */
+#endif
 
 #define DMALLOC_DISABLE
 
@@ -62,6 +65,9 @@
 #include "error.h"
 #include "error_val.h"
 #include "heap.h"
+#include "snapshot.h"
+#include "stack.h"
+#include "stats.h"
 
 /*
  * Library Copyright and URL information for ident and what programs
@@ -114,6 +120,9 @@ static	skip_alloc_t	*skip_address_list = skip_address_alloc;
 /* update slots which we use to update the skip lists */
 static	skip_alloc_t	skip_update[MAX_SKIP_LEVEL /* read note ^^ */];
 
+/* update slots for walking the used list while freeing from it */
+static	skip_alloc_t	skip_region_update[MAX_SKIP_LEVEL /* read note ^^ */];
+
 /* linked list of slots of various sizes */
 static	skip_alloc_t	*entry_free_list[MAX_SKIP_LEVEL];
 /* linked list of blocks of the sizes */
@@ -129,9 +138,17 @@ static	int		bit_sizes[BASIC_BLOCK]; /* number bits for div-blocks*/
 
 /* memory tables */
 static	mem_table_t	mem_table_alloc;
-static	mem_entry_t	mem_table_alloc_entries[MEM_ALLOC_ENTRIES];
 static	mem_table_t	mem_table_changed;
-static	mem_entry_t	mem_table_changed_entries[MEM_ALLOC_ENTRIES];
+
+/* allocation regions, the region-id is the index + 1 */
+static	region_t	regions[MAX_REGIONS];
+
+#if PNT_CHECK_CACHE_SIZE > 0
+/* slots found by the pointer checks, forgotten when anything is freed */
+static	unsigned long	check_cache_gen = 1;
+static	THREAD_LOCAL check_cache_t	check_cache[PNT_CHECK_CACHE_SIZE];
+static	THREAD_LOCAL int		check_cache_next = 0;
+#endif
 
 /* memory stats */
 static	unsigned long	alloc_current = 0;	/* current memory usage */
@@ -162,6 +179,13 @@ static	unsigned long	func_new_c = 0;		/* count the news */
 static	unsigned long	func_free_c = 0;	/* count the frees */
 static	unsigned long	func_delete_c = 0;	/* count the deletes */
 
+/* live statistics page, created the first time export-stats publishes */
+static	stats_page_t	*stats_page_p = NULL;
+static	int		stats_failed_b = 0;	/* could not create page */
+
+/* buffer used to batch up the snapshot records into large writes */
+static	char		snapshot_buf[SNAPSHOT_BUFFER_SIZE];
+
 /**************************** skip list routines *****************************/
 
 /*
@@ -225,7 +249,7 @@ static	int	random_level(const int max_level)
  * address could be inside a block.
  *
  * update_p -> Pointer to the skip_alloc entry we are using to hold
- * the update pointers.
+ * the update pointers or NULL if we are only looking.
  */
 static	skip_alloc_t	*find_address(const void *address, const int free_b,
 				      const int exact_b,
@@ -285,7 +309,9 @@ static	skip_alloc_t	*find_address(const void *address, const int free_b,
     
     /* we are lowering the level */
     
-    update_p->sa_next_p[level_c] = slot_p;
+    if (update_p != NULL) {
+      update_p->sa_next_p[level_c] = slot_p;
+    }
     if (level_c == 0) {
       break;
     }
@@ -295,6 +321,53 @@ static	skip_alloc_t	*find_address(const void *address, const int free_b,
   return found_p;
 }
 
+/*
+ * static skip_alloc_t *find_checked_address
+ *
+ * Look for the used slot which holds an address that we are checking.
+ * The slots we found recently are remembered per-thread so repeated
+ * checks of the same buffer don't have to search the skip list.
+ *
+ * Returns a pointer to the slot holding the address or NULL if not
+ * found.
+ *
+ * ARGUMENTS:
+ *
+ * address -> Address we are looking for.
+ */
+static	skip_alloc_t	*find_checked_address(const void *address)
+{
+#if PNT_CHECK_CACHE_SIZE > 0
+  check_cache_t	*cache_p, *bounds_p;
+  skip_alloc_t	*slot_p;
+  
+  bounds_p = check_cache + PNT_CHECK_CACHE_SIZE;
+  for (cache_p = check_cache; cache_p < bounds_p; cache_p++) {
+    if (cache_p->cc_gen == check_cache_gen
+	&& (char *)address >= cache_p->cc_start_p
+	&& (char *)address < cache_p->cc_end_p) {
+      return cache_p->cc_slot_p;
+    }
+  }
+  
+  slot_p = find_address(address, 0 /* used list */, 0 /* not exact pointer */,
+			NULL /* no update */);
+  if (slot_p != NULL) {
+    cache_p = check_cache + check_cache_next;
+    cache_p->cc_start_p = slot_p->sa_mem;
+    cache_p->cc_end_p = (char *)slot_p->sa_mem + slot_p->sa_total_size;
+    cache_p->cc_slot_p = slot_p;
+    cache_p->cc_gen = check_cache_gen;
+    check_cache_next = (check_cache_next + 1) % PNT_CHECK_CACHE_SIZE;
+  }
+  
+  return slot_p;
+#else
+  return find_address(address, 0 /* used list */, 0 /* not exact pointer */,
+		      NULL /* no update */);
+#endif
+}
+
 /*
  * static skip_alloc_t *find_free_size
  *
@@ -796,18 +869,22 @@ static	void	get_pnt_info(const skip_alloc_t *slot_p, pnt_info_t *info_p)
   
   info_p->pi_alloc_start = slot_p->sa_mem;
   
-  if (info_p->pi_fence_b) {
-    if (info_p->pi_valloc_b) {
-      info_p->pi_user_start = (char *)info_p->pi_alloc_start + BLOCK_SIZE;
+  if (info_p->pi_valloc_b) {
+    /* aligned pointers sit at an offset with the fence right below */
+    info_p->pi_user_start = (char *)info_p->pi_alloc_start + slot_p->sa_offset;
+    if (info_p->pi_fence_b) {
       info_p->pi_fence_bottom = (char *)info_p->pi_user_start -
 	FENCE_BOTTOM_SIZE;
     }
     else {
-      info_p->pi_fence_bottom = info_p->pi_alloc_start;
-      info_p->pi_user_start = (char *)info_p->pi_alloc_start +
-	FENCE_BOTTOM_SIZE;
+      info_p->pi_fence_bottom = NULL;
     }
   }
+  else if (info_p->pi_fence_b) {
+    info_p->pi_fence_bottom = info_p->pi_alloc_start;
+    info_p->pi_user_start = (char *)info_p->pi_alloc_start +
+      FENCE_BOTTOM_SIZE;
+  }
   else {
     info_p->pi_fence_bottom = NULL;
     info_p->pi_user_start = info_p->pi_alloc_start;
@@ -828,6 +905,78 @@ static	void	get_pnt_info(const skip_alloc_t *slot_p, pnt_info_t *info_p)
   }
 }
 
+/*
+ * static unsigned long aligned_size
+ *
+ * Figure out how many bytes we need to ask for so that an aligned
+ * user pointer, along with its fence-posts, fits inside of the chunk.
+ * Divided blocks are aligned on their own size so a small chunk at
+ * least as large as the alignment only needs room for the bottom
+ * fence rounded up.  Multi-block chunks are only block aligned so
+ * larger alignments need the difference as slack at the front.
+ *
+ * Returns the number of bytes needed.
+ *
+ * ARGUMENTS:
+ *
+ * size -> Number of bytes the user asked for.
+ *
+ * alignment -> Power-of-two alignment of the user pointer.
+ *
+ * fence_b -> Set to 1 if the chunk is fence-posted.
+ */
+static	unsigned long	aligned_size(const unsigned long size,
+				     const unsigned int alignment,
+				     const int fence_b)
+{
+  unsigned long	front_size, top_size, need_size;
+  unsigned int	block_align;
+  
+  if (fence_b) {
+    front_size = FENCE_BOTTOM_SIZE;
+    top_size = FENCE_TOP_SIZE;
+  }
+  else {
+    front_size = 0;
+    top_size = 0;
+  }
+  
+  /* see if a divided block of at least the alignment will do */
+  need_size = ALIGN_UP(front_size, alignment) + size + top_size;
+  need_size = MAX(need_size, alignment);
+  if (need_size <= BLOCK_SIZE / 2) {
+    return need_size;
+  }
+  
+  /* make sure that we get at least a block so we are block aligned */
+  block_align = MIN(alignment, BLOCK_SIZE);
+  need_size = ALIGN_UP(front_size, block_align) + (alignment - block_align) +
+    size + top_size;
+  return MAX(need_size, BLOCK_SIZE);
+}
+
+/*
+ * static void record_stack
+ *
+ * Record the call stack of an allocation in a slot if the log-stack
+ * token is enabled.
+ *
+ * ARGUMENTS:
+ *
+ * slot_p <-> Slot we are recording the stack in.
+ */
+static	void	record_stack(skip_alloc_t *slot_p)
+{
+#if LOG_PNT_STACK_DEPTH
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_STACK)) {
+    slot_p->sa_stack_p = _dmalloc_stack_get(&admin_block_c);
+  }
+  else {
+    slot_p->sa_stack_p = NULL;
+  }
+#endif
+}
+
 /*
  * static char *display_pnt
  *
@@ -855,14 +1004,18 @@ static	char	*display_pnt(const void *user_pnt, const skip_alloc_t *alloc_p,
   buf_p = buf;
   bounds_p = buf_p + buf_size;
   
-  buf_p = append_format(buf_p, bounds_p, "%p", user_pnt);
+  /* these are logged for every transaction so skip the format parsing */
+  buf_p = append_string(buf_p, bounds_p, "0x");
+  buf_p = append_pointer(buf_p, bounds_p, (PNT_ARITH_TYPE)user_pnt, 16);
   
 #if LOG_PNT_SEEN_COUNT
-  buf_p = append_format(buf_p, bounds_p, "|s%lu", alloc_p->sa_seen_c);
+  buf_p = append_string(buf_p, bounds_p, "|s");
+  buf_p = append_ulong(buf_p, bounds_p, alloc_p->sa_seen_c, 10);
 #endif
   
 #if LOG_PNT_ITERATION
-  buf_p = append_format(buf_p, bounds_p, "|i%lu", alloc_p->sa_iteration);
+  buf_p = append_string(buf_p, bounds_p, "|i");
+  buf_p = append_ulong(buf_p, bounds_p, alloc_p->sa_iteration, 10);
 #endif
   
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ELAPSED_TIME)) {
@@ -905,6 +1058,58 @@ static	char	*display_pnt(const void *user_pnt, const skip_alloc_t *alloc_p,
   return buf;
 }
 
+/*
+ * static int trans_json_begin
+ *
+ * Start the JSON record of a memory transaction.
+ *
+ * Returns 1 if the record was started else 0.
+ *
+ * ARGUMENTS:
+ *
+ * func -> Name of the transaction.
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller or 0.
+ */
+static	int	trans_json_begin(const char *func, const char *file,
+				 const unsigned int line)
+{
+  if (! _dmalloc_json_begin("trans")) {
+    return 0;
+  }
+  _dmalloc_json_string("func", func);
+  _dmalloc_json_where("", file, line);
+  return 1;
+}
+
+/*
+ * static void trans_json_pnt
+ *
+ * Add the fields which describe a pointer to a transaction record.
+ * These are the JSON equivalent of display_pnt.
+ *
+ * ARGUMENTS:
+ *
+ * name -> Name of the pointer field.
+ *
+ * user_pnt -> Pointer that we are describing.
+ *
+ * alloc_p -> Pointer to the skip slot of the pointer.
+ */
+static	void	trans_json_pnt(const char *name, const void *user_pnt,
+			       const skip_alloc_t *alloc_p)
+{
+  _dmalloc_json_pnt(name, user_pnt);
+#if LOG_PNT_SEEN_COUNT
+  _dmalloc_json_ulong("seen", alloc_p->sa_seen_c);
+#endif
+#if LOG_PNT_ITERATION
+  _dmalloc_json_ulong("alloc_iter", alloc_p->sa_iteration);
+#endif
+}
+
 /*
  * static void log_error_info
  *
@@ -963,26 +1168,42 @@ static	void	log_error_info(const char *now_file,
     }
   }
   
-  /* get a proper reason string */
-  if (reason != NULL) {
-    dmalloc_message("  error details: %s", reason);
-  }
-  
-  /* dump the pointer information */
-  if (start_user == NULL) {
-    dmalloc_message("  from '%s' prev access '%s'",
-		    _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
-					    now_file, now_line),
-		    _dmalloc_chunk_desc_pnt(where_buf2, sizeof(where_buf2),
-					    prev_file, prev_line));
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_JSON)) {
+    /* the reason and pointer information go into one record */
+    if (_dmalloc_json_begin("error_info")) {
+      _dmalloc_json_string("func", where);
+      _dmalloc_json_string("reason", reason);
+      if (start_user != NULL) {
+	_dmalloc_json_pnt("pnt", start_user);
+	_dmalloc_json_ulong("size", user_size);
+      }
+      _dmalloc_json_where("", now_file, now_line);
+      _dmalloc_json_where("prev_", prev_file, prev_line);
+      _dmalloc_json_end();
+    }
   }
   else {
-    dmalloc_message("  pointer '%p' from '%s' prev access '%s'",
-		    start_user,
-		    _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
-					    now_file, now_line),
-		    _dmalloc_chunk_desc_pnt(where_buf2, sizeof(where_buf2),
-					    prev_file, prev_line));
+    /* get a proper reason string */
+    if (reason != NULL) {
+      dmalloc_message("  error details: %s", reason);
+    }
+    
+    /* dump the pointer information */
+    if (start_user == NULL) {
+      dmalloc_message("  from '%s' prev access '%s'",
+		      _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
+					      now_file, now_line),
+		      _dmalloc_chunk_desc_pnt(where_buf2, sizeof(where_buf2),
+					      prev_file, prev_line));
+    }
+    else {
+      dmalloc_message("  pointer '%p' from '%s' prev access '%s'",
+		      start_user,
+		      _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
+					      now_file, now_line),
+		      _dmalloc_chunk_desc_pnt(where_buf2, sizeof(where_buf2),
+					      prev_file, prev_line));
+    }
   }
   
   /*
@@ -1089,31 +1310,30 @@ static	void	log_error_info(const char *now_file,
 }
 
 /*
- * static int fence_read
+ * static int fence_error
  *
  * Check a pointer for fence-post magic numbers.
  *
- * Returns 1 if the fence posts are good or 0 if they are not.
+ * Returns DMALLOC_ERROR_NONE if the fence posts are good or the error
+ * number if they are not.
  *
  * ARGUMENTS:
  *
  * info_p -> Pointer information that we are checking.
  */
-static	int	fence_read(const pnt_info_t *info_p)
+static	int	fence_error(const pnt_info_t *info_p)
 {
   /* check magic numbers in bottom of allocation block */
   if (memcmp(fence_bottom, info_p->pi_fence_bottom, FENCE_BOTTOM_SIZE) != 0) {
-    dmalloc_errno = DMALLOC_ERROR_UNDER_FENCE;
-    return 0;
+    return DMALLOC_ERROR_UNDER_FENCE;
   }
   
   /* check numbers at top of allocation block */
   if (memcmp(fence_top, info_p->pi_fence_top, FENCE_TOP_SIZE) != 0) {
-    dmalloc_errno = DMALLOC_ERROR_OVER_FENCE;
-    return 0;
+    return DMALLOC_ERROR_OVER_FENCE;
   }
   
-  return 1;
+  return DMALLOC_ERROR_NONE;
 }
 
 /*
@@ -1160,11 +1380,17 @@ static	void	clear_alloc(skip_alloc_t *slot_p, pnt_info_t *info_p,
   }
   
   /*
-   * If we have a fence post protected valloc then there is almost a
-   * full block at the front what is "free".  Set it with blank chars.
+   * If we have an aligned allocation then there may be space at the
+   * front below the user pointer and any fence that is "free".  Set
+   * it with blank chars.
    */
-  if (info_p->pi_fence_b) {
-    num = (char *)info_p->pi_fence_bottom - (char *)info_p->pi_alloc_start;
+  if (info_p->pi_fence_b || info_p->pi_valloc_b) {
+    if (info_p->pi_fence_b) {
+      num = (char *)info_p->pi_fence_bottom - (char *)info_p->pi_alloc_start;
+    }
+    else {
+      num = (char *)info_p->pi_user_start - (char *)info_p->pi_alloc_start;
+    }
     /* alloc-blank NOT free-blank */
     if (num > 0 && BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_BLANK)) {
       memset(info_p->pi_alloc_start, ALLOC_BLANK_CHAR, num);
@@ -1474,11 +1700,14 @@ static	skip_alloc_t	*get_memory(const unsigned int size)
 }
 
 /*
- * static int check_used_slot
+ * static int used_slot_error
  *
  * Check out the pointer in a allocated slot to make sure it is good.
+ * This does not change any global state so it can be used by threads
+ * which are sharing the library lock.
  *
- * Returns 1 on success or 0 on failure.
+ * Returns DMALLOC_ERROR_NONE on success or the error number on
+ * failure.
  *
  * ARGUMENTS:
  *
@@ -1494,20 +1723,24 @@ static	skip_alloc_t	*get_memory(const unsigned int size)
  *
  * min_size -> Make sure that pnt can hold at least that many bytes.
  * If 0 then ignore.
+ *
+ * strlen_p <- If not NULL and strlen_b is set, this will be set to
+ * the length of the string found during the check.
  */
-static	int	check_used_slot(const skip_alloc_t *slot_p,
+static	int	used_slot_error(const skip_alloc_t *slot_p,
 				const void *user_pnt, const int exact_b,
-				const int strlen_b, const int min_size)
+				const int strlen_b, const int min_size,
+				int *strlen_p)
 {
   const char	*file, *name_p, *bounds_p, *mem_p;
-  unsigned int	line, num;
+  unsigned int	line;
+  int		error;
   pnt_info_t	pnt_info;
   
   if (! (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER)
 	 || BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_EXTERN)
 	 || BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_ADMIN))) {
-    dmalloc_errno = DMALLOC_ERROR_SLOT_CORRUPT;
-    return 0;
+    return DMALLOC_ERROR_SLOT_CORRUPT;
   }
   
   /* get pointer info */
@@ -1515,66 +1748,65 @@ static	int	check_used_slot(const skip_alloc_t *slot_p,
   
   /* the user pointer needs to be within the user space */
   if (user_pnt != NULL && (char *)user_pnt < (char *)pnt_info.pi_user_start) {
-    dmalloc_errno = DMALLOC_ERROR_WOULD_OVERWRITE;
-    return 0;
+    return DMALLOC_ERROR_WOULD_OVERWRITE;
   }
   
   /* if we need the exact pointer, make sure that the user_pnt agrees */
   if (exact_b && user_pnt != pnt_info.pi_user_start) {
-    dmalloc_errno = DMALLOC_ERROR_NOT_START_BLOCK;
-    return 0;
+    return DMALLOC_ERROR_NOT_START_BLOCK;
   }
   
 #if LARGEST_ALLOCATION
   /* have we exceeded the upper bounds */
   if (slot_p->sa_user_size > LARGEST_ALLOCATION) {
-    dmalloc_errno = DMALLOC_ERROR_BAD_SIZE;
-    return 0;
+    return DMALLOC_ERROR_BAD_SIZE;
   }
 #endif
   
+  if (slot_p->sa_region > MAX_REGIONS) {
+    return DMALLOC_ERROR_SLOT_CORRUPT;
+  }
+  
   /* check our total block size */
   if (slot_p->sa_total_size > BLOCK_SIZE / 2
       && slot_p->sa_total_size % BLOCK_SIZE != 0) {
-    dmalloc_errno = DMALLOC_ERROR_BAD_SIZE;
-    return 0;
+    return DMALLOC_ERROR_BAD_SIZE;
   }
   
   /*
-   * If we have a valloc allocation then the _user_ pnt should be
-   * block aligned otherwise the chunk_pnt should be.
+   * If we have an aligned allocation then the user pnt is at an
+   * offset inside of the chunk which has to leave room for the fences
+   * and the user space.
    */
   if (pnt_info.pi_valloc_b) {
     
-    if ((PNT_ARITH_TYPE)pnt_info.pi_user_start % BLOCK_SIZE != 0) {
-      dmalloc_errno = DMALLOC_ERROR_NOT_ON_BLOCK;
-      return 0;
-    }
-    if (slot_p->sa_total_size < BLOCK_SIZE) {
-      dmalloc_errno = DMALLOC_ERROR_SLOT_CORRUPT;
-      return 0;
+    if ((pnt_info.pi_fence_b && slot_p->sa_offset < FENCE_BOTTOM_SIZE)
+	|| (char *)pnt_info.pi_user_bounds > (char *)pnt_info.pi_upper_bounds) {
+      return DMALLOC_ERROR_SLOT_CORRUPT;
     }
     
     /* now check the below space to make sure it is still clear */
-    if (pnt_info.pi_fence_b && pnt_info.pi_blanked_b) {
-      num = (char *)pnt_info.pi_fence_bottom - (char *)pnt_info.pi_alloc_start;
-      if (num > 0) {
-	for (mem_p = pnt_info.pi_alloc_start;
-	     mem_p < (char *)pnt_info.pi_fence_bottom;
-	     mem_p++) {
-	  if (*mem_p != ALLOC_BLANK_CHAR) {
-	    dmalloc_errno = DMALLOC_ERROR_FREE_OVERWRITTEN;
-	    return 0;
-	  }
+    if (pnt_info.pi_blanked_b) {
+      if (pnt_info.pi_fence_b) {
+	bounds_p = pnt_info.pi_fence_bottom;
+      }
+      else {
+	bounds_p = pnt_info.pi_user_start;
+      }
+      for (mem_p = pnt_info.pi_alloc_start; mem_p < bounds_p; mem_p++) {
+	if (*mem_p != ALLOC_BLANK_CHAR) {
+	  return DMALLOC_ERROR_FREE_OVERWRITTEN;
 	}
       }
     }
   }
   
   /* check out the fence-posts */
-  if (pnt_info.pi_fence_b && (! fence_read(&pnt_info))) {
-    /* errno set in fence_read */
-    return 0;
+  if (pnt_info.pi_fence_b) {
+    error = fence_error(&pnt_info);
+    if (error != DMALLOC_ERROR_NONE) {
+      return error;
+    }
   }
   
   /* check above the allocation to see if it's been overwritten */
@@ -1589,20 +1821,18 @@ static	int	check_used_slot(const skip_alloc_t *slot_p,
     
     for (; mem_p < (char *)pnt_info.pi_alloc_bounds; mem_p++) {
       if (*mem_p != ALLOC_BLANK_CHAR) {
-	dmalloc_errno = DMALLOC_ERROR_FREE_OVERWRITTEN;
-	return 0;
+	return DMALLOC_ERROR_FREE_OVERWRITTEN;
       }
     }
   }
-
+  
   file = slot_p->sa_file;
   line = slot_p->sa_line;
   
   /* check line number */
 #if MAX_LINE_NUMBER
   if (line > MAX_LINE_NUMBER) {
-    dmalloc_errno = DMALLOC_ERROR_BAD_LINE;
-    return 0;
+    return DMALLOC_ERROR_BAD_LINE;
   }
 #endif
   
@@ -1618,8 +1848,7 @@ static	int	check_used_slot(const skip_alloc_t *slot_p,
     }
     if (name_p > bounds_p
 	|| name_p < file + MIN_FILE_LENGTH) {
-      dmalloc_errno = DMALLOC_ERROR_BAD_FILE;
-      return 0;
+      return DMALLOC_ERROR_BAD_FILE;
     }
   }
 #endif
@@ -1632,8 +1861,7 @@ static	int	check_used_slot(const skip_alloc_t *slot_p,
    * iter_c * 2.
    */
   if (slot_p->sa_seen_c / 2 > _dmalloc_iter_c) {
-    dmalloc_errno = DMALLOC_ERROR_SLOT_CORRUPT;
-    return 0;
+    return DMALLOC_ERROR_SLOT_CORRUPT;
   }
 #endif
   
@@ -1652,24 +1880,69 @@ static	int	check_used_slot(const skip_alloc_t *slot_p,
     } else {
       bounds_p = (char *)pnt_info.pi_user_bounds;
     }
-    for (; mem_p < bounds_p; mem_p++) {
-      if (*mem_p == '\0') {
-	break;
-      }
+    /* a pointer into the slack or fence has no room for any string */
+    if (mem_p >= bounds_p) {
+      return DMALLOC_ERROR_WOULD_OVERWRITE;
     }
+    /* one bounded pass finds the \0 and gives us the length */
+    mem_p += strnlen(mem_p, bounds_p - mem_p);
     /* mem_p can == bounds_p (if equals-ok) if we hit the min_size but can't >= user_bounds */ 
     if (mem_p > (char *)pnt_info.pi_user_bounds
 	|| ((! equals_okay_b) && mem_p == (char *)pnt_info.pi_user_bounds)) {
-      dmalloc_errno = DMALLOC_ERROR_WOULD_OVERWRITE;
-      return 0;
+      return DMALLOC_ERROR_WOULD_OVERWRITE;
+    }
+    if (strlen_p != NULL) {
+      *strlen_p = mem_p - (char *)user_pnt;
     }
   } else if (min_size > 0) {
     if ((char *)user_pnt + min_size > (char *)pnt_info.pi_user_bounds) {
-      dmalloc_errno = DMALLOC_ERROR_WOULD_OVERWRITE;
-      return 0;
+      return DMALLOC_ERROR_WOULD_OVERWRITE;
     }
   }
   
+  return DMALLOC_ERROR_NONE;
+}
+
+/*
+ * static int check_used_slot
+ *
+ * Check out the pointer in a allocated slot to make sure it is good
+ * and set dmalloc_errno if it is not.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * slot_p -> Slot that we are checking.
+ *
+ * user_pnt -> User pointer which was used to get the slot or NULL.
+ *
+ * exact_b -> Set to 1 to find the pointer specifically.  Otherwise we
+ * can find the pointer inside of an allocation.
+ *
+ * strlen_b -> Make sure that pnt can hold at least a strlen + 1
+ * bytes.  If 0 then ignore.
+ *
+ * min_size -> Make sure that pnt can hold at least that many bytes.
+ * If 0 then ignore.
+ *
+ * strlen_p <- If not NULL and strlen_b is set, this will be set to
+ * the length of the string found during the check.
+ */
+static	int	check_used_slot(const skip_alloc_t *slot_p,
+				const void *user_pnt, const int exact_b,
+				const int strlen_b, const int min_size,
+				int *strlen_p)
+{
+  int	error;
+  
+  error = used_slot_error(slot_p, user_pnt, exact_b, strlen_b, min_size,
+			  strlen_p);
+  if (error != DMALLOC_ERROR_NONE) {
+    dmalloc_errno = error;
+    return 0;
+  }
+  
   return 1;
 }
 
@@ -1771,12 +2044,9 @@ int	_dmalloc_chunk_startup(void)
   skip_free_list->sa_flags = ALLOC_FLAG_ADMIN;
   skip_address_list->sa_flags = ALLOC_FLAG_ADMIN;
   
-  _dmalloc_table_init(&mem_table_alloc, mem_table_alloc_entries,
-		      sizeof(mem_table_alloc_entries) /
-		      sizeof(*mem_table_alloc_entries));
-  _dmalloc_table_init(&mem_table_changed, mem_table_changed_entries,
-		      sizeof(mem_table_changed_entries) /
-		      sizeof(*mem_table_changed_entries));
+  _dmalloc_table_init(&mem_table_alloc, MEM_ALLOC_ENTRIES, &admin_block_c);
+  _dmalloc_table_init(&mem_table_changed, MEM_CHANGED_ENTRIES,
+		      &admin_block_c);
   
   return 1;
 }
@@ -1812,7 +2082,15 @@ char	*_dmalloc_chunk_desc_pnt(char *buf, const int buf_size,
     (void)loc_snprintf(buf, buf_size, "ra=ERROR(line=%u)", line);
   }
   else {
-    (void)loc_snprintf(buf, buf_size, "%.*s:%u", MAX_FILE_LENGTH, file, line);
+    /* this is the common case so we build it without parsing a format */
+    char	*buf_p, *bounds_p = buf + buf_size;
+    
+    buf_p = append_string(buf, buf + MIN(buf_size, MAX_FILE_LENGTH), file);
+    if (buf_p < bounds_p) {
+      *buf_p++ = ':';
+    }
+    buf_p = append_ulong(buf_p, bounds_p, line, 10);
+    append_null(buf_p, bounds_p);
   }
   
   return buf;
@@ -1874,7 +2152,7 @@ int	_dmalloc_chunk_read_info(const void *user_pnt, const char *where,
   
   /* find the pointer with loose checking for fence */
   slot_p = find_address(user_pnt, 0 /* used list */, 0 /* not exact pointer */,
-			skip_update);
+			NULL /* no update */);
   if (slot_p == NULL) {
     dmalloc_errno = DMALLOC_ERROR_NOT_FOUND;
     log_error_info(NULL, 0, user_pnt, NULL, "finding address in heap", where);
@@ -1883,7 +2161,7 @@ int	_dmalloc_chunk_read_info(const void *user_pnt, const char *where,
   
   /* might as well check the pointer now */
   if (! check_used_slot(slot_p, user_pnt, 1 /* exact */, 0 /* no strlen */,
-			0 /* no min-size */)) {
+			0 /* no min-size */, NULL)) {
     /* errno set in check_slot */
     log_error_info(NULL, 0, user_pnt, slot_p, "checking pointer admin", where);
     return 0;
@@ -2075,7 +2353,7 @@ int	_dmalloc_chunk_heap_check(void)
     if (checking_list_c == 0) {
       ret = check_used_slot(slot_p, NULL /* no user pnt */,
 			    0 /* loose pnt checking */, 0 /* no strlen */,
-			    0 /* no min-size */);
+			    0 /* no min-size */, NULL);
       if (! ret) {
 	/* error set in check_slot */
 	log_error_info(NULL, 0, NULL, slot_p, "checking user pointer",
@@ -2120,13 +2398,21 @@ int	_dmalloc_chunk_heap_check(void)
  *
  * min_size -> Make sure that pnt can hold at least that many bytes.
  * If 0 then ignore.
+ *
+ * strlen_p <- If not NULL, this will be set to the length of the
+ * string if strlen_b is set and the pointer is in the heap, or -1 if
+ * the length is not known.
  */
 int	_dmalloc_chunk_pnt_check(const char *func, const void *user_pnt,
 				 const int exact_b, const int strlen_b,
-				 const int min_size)
+				 const int min_size, int *strlen_p)
 {
   skip_alloc_t	*slot_p;
   
+  if (strlen_p != NULL) {
+    *strlen_p = -1;
+  }
+  
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
     if (func == NULL) {
       dmalloc_message("checking pointer '%p'", user_pnt);
@@ -2137,8 +2423,7 @@ int	_dmalloc_chunk_pnt_check(const char *func, const void *user_pnt,
   }
   
   /* try to find the address */
-  slot_p = find_address(user_pnt, 0 /* used list */, 0 /* not exact pointer */,
-			skip_update);
+  slot_p = find_checked_address(user_pnt);
   if (slot_p == NULL) {
     if (exact_b) {
       dmalloc_errno = DMALLOC_ERROR_NOT_FOUND;
@@ -2151,7 +2436,8 @@ int	_dmalloc_chunk_pnt_check(const char *func, const void *user_pnt,
   }
   
   /* now make sure that the user slot is valid */
-  if (! check_used_slot(slot_p, user_pnt, exact_b, strlen_b, min_size)) {
+  if (! check_used_slot(slot_p, user_pnt, exact_b, strlen_b, min_size,
+			strlen_p)) {
     /* dmalloc_error set in check_used_slot */
     log_error_info(NULL, 0, user_pnt, slot_p, "pointer-check", func);
     return 0;
@@ -2160,101 +2446,294 @@ int	_dmalloc_chunk_pnt_check(const char *func, const void *user_pnt,
   return 1;
 }
 
-/************************** low-level user functions *************************/
-
 /*
- * void *_dmalloc_chunk_malloc
+ * int _dmalloc_chunk_pnt_peek
  *
- * Allocate a chunk of memory.
+ * Quietly run the tests of _dmalloc_chunk_pnt_check on a pointer.
+ * This does not log anything, change the heap, or set dmalloc_errno
+ * so it can be called by threads which are sharing the library lock.
+ * If it fails, the caller should redo the check with
+ * _dmalloc_chunk_pnt_check while holding the lock to report the
+ * problem.
  *
- * Returns a valid pointer on success or NULL on failure.
+ * Returns 1 if the pointer is okay or 0 if not
  *
  * ARGUMENTS:
  *
- * file -> File-name or return-address location of the allocation.
+ * user_pnt -> Pointer we are checking.
  *
- * line -> Line-number location of the allocation.
+ * exact_b -> Set to 1 to find the pointer specifically.  Otherwise we
+ * can find the pointer inside of an allocation.
  *
- * size -> Number of bytes to allocate.
+ * strlen_b -> Make sure that pnt can hold at least a strlen + 1
+ * bytes.  If 0 then ignore.
  *
- * func_id -> Calling function-id as defined in dmalloc.h.
+ * min_size -> Make sure that pnt can hold at least that many bytes.
+ * If 0 then ignore.
  *
- * alignment -> If greater than 0 then try to align the returned
- * block.
+ * strlen_p <- If not NULL, this will be set to the length of the
+ * string if strlen_b is set and the pointer is in the heap, or -1 if
+ * the length is not known.
  */
-void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
-			       const unsigned long size, const int func_id,
-			       const unsigned int alignment)
+int	_dmalloc_chunk_pnt_peek(const void *user_pnt, const int exact_b,
+				const int strlen_b, const int min_size,
+				int *strlen_p)
 {
-  unsigned long	needed_size;
-  int		valloc_b = 0, fence_b = 0;
-  char		where_buf[MAX_FILE_LENGTH + 64], disp_buf[64];
   skip_alloc_t	*slot_p;
-  pnt_info_t	pnt_info;
-  const char	*trans_log;
-  
-  // TOTO: is alignment used here appropriately?
-  
-  /* counts calls to malloc */
-  if (func_id == DMALLOC_FUNC_CALLOC) {
-    func_calloc_c++;
-  }
-  else if (alignment == BLOCK_SIZE) {
-    func_valloc_c++;
-    valloc_b = 1;
-  }
-  else if (alignment > 0) {
-    func_memalign_c++;
-  }
-  else if (func_id == DMALLOC_FUNC_NEW) {
-    func_new_c++;
-  }
-  else if (func_id != DMALLOC_FUNC_REALLOC
-	   && func_id != DMALLOC_FUNC_RECALLOC) {
-    func_malloc_c++;
-  }
   
-#if ALLOW_ALLOC_ZERO_SIZE == 0
-  if (size == 0) {
-    dmalloc_errno = DMALLOC_ERROR_BAD_SIZE;
-    log_error_info(file, line, NULL, NULL, "bad zero byte allocation request",
-		   "malloc");
-    return MALLOC_ERROR;
+  if (strlen_p != NULL) {
+    *strlen_p = -1;
   }
-#endif
   
-#if LARGEST_ALLOCATION
-  /* have we exceeded the upper bounds */
-  if (size > LARGEST_ALLOCATION) {
-    dmalloc_errno = DMALLOC_ERROR_TOO_BIG;
-    log_error_info(file, line, NULL, NULL, "allocation too big", "malloc");
-    return MALLOC_ERROR;
+  slot_p = find_checked_address(user_pnt);
+  if (slot_p == NULL) {
+    /* only the exact checks need the pointer to be in the heap */
+    return (! exact_b);
   }
-#endif
   
-  needed_size = size;
-  
-  /* adjust the size */
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FENCE)) {
-    needed_size += FENCE_OVERHEAD_SIZE;
-    fence_b = 1;
-    
+  return (used_slot_error(slot_p, user_pnt, exact_b, strlen_b, min_size,
+			  strlen_p) == DMALLOC_ERROR_NONE);
+}
+
+/*
+ * static int free_slot
+ *
+ * Release a checked slot from the used list and put it on the free
+ * list or the free wait list.
+ *
+ * Returns FREE_NOERROR on success or FREE_ERROR on failure
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the free.
+ *
+ * line -> Line-number location of the free.
+ *
+ * slot_p <-> Slot that we are freeing.
+ *
+ * update_p -> Pointer to the skip_alloc entry holding the update
+ * pointers which lead to the slot in the used list.
+ *
+ * user_pnt -> User pointer of the slot.
+ */
+static	int	free_slot(const char *file, const unsigned int line,
+			  skip_alloc_t *slot_p, skip_alloc_t *update_p,
+			  const void *user_pnt)
+{
+  char		where_buf[MAX_FILE_LENGTH + 64];
+  char		where_buf2[MAX_FILE_LENGTH + 64], disp_buf[64];
+  
+  if (! remove_slot(slot_p, update_p)) {
+    /* error set and dumped in remove_slot */
+    return FREE_ERROR;
+  }
+#if PNT_CHECK_CACHE_SIZE > 0
+  /* the pointer checks can't use anything they remember now */
+  check_cache_gen++;
+#endif
+  if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FENCE)) {
     /*
-     * If the user is requesting a page-aligned block of data then we
-     * will need another block below the allocation just for the fence
-     * information.  Ugh.
+     * We need to preserve the fence-post flag because we may need to
+     * properly check for previously freed pointers in the future.
      */
-    if (valloc_b) {
-      needed_size += BLOCK_SIZE;
+    slot_p->sa_flags = ALLOC_FLAG_FREE | ALLOC_FLAG_FENCE;
+  }
+  else {
+    slot_p->sa_flags = ALLOC_FLAG_FREE;
+  }
+  
+  alloc_cur_pnts--;
+  
+  /* the pointer is no longer in its region */
+  if (slot_p->sa_region > 0) {
+    regions[slot_p->sa_region - 1].rg_pnt_c--;
+    slot_p->sa_region = 0;
+  }
+  
+  slot_p->sa_use_iter = _dmalloc_iter_c;
+#if LOG_PNT_SEEN_COUNT
+  slot_p->sa_seen_c++;
+#endif
+  
+  /* do we need to print transaction info? */
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
+    if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_JSON)) {
+      if (trans_json_begin("free", file, line)) {
+	trans_json_pnt("pnt", user_pnt, slot_p);
+	_dmalloc_json_ulong("size", slot_p->sa_user_size);
+	_dmalloc_json_where("alloc_", slot_p->sa_file, slot_p->sa_line);
+	_dmalloc_json_end();
+      }
+    }
+    else {
+      dmalloc_message("*** free: at '%s' pnt '%s': size %u, alloced at '%s'",
+		      _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
+					      file, line),
+		      display_pnt(user_pnt, slot_p, disp_buf,
+				  sizeof(disp_buf)),
+		      slot_p->sa_user_size,
+		      _dmalloc_chunk_desc_pnt(where_buf2, sizeof(where_buf2),
+					      slot_p->sa_file,
+					      slot_p->sa_line));
     }
   }
-  else if (valloc_b && needed_size <= BLOCK_SIZE / 2) {
-    /*
-     * If we are valloc-ing, make sure that we get a blocksized chunk
-     * because they are always block aligned.  We know here that fence
-     * posting is not on otherwise it would have been set above.
-     */
-    needed_size = BLOCK_SIZE;
+  
+#if MEMORY_TABLE_TOP_LOG
+  _dmalloc_table_delete(&mem_table_alloc, slot_p->sa_file, slot_p->sa_line,
+			SLOT_STACK(slot_p), slot_p->sa_user_size);
+#endif
+  
+  /* update the file/line -- must be after _dmalloc_table_delete */
+  slot_p->sa_file = file;
+  slot_p->sa_line = line;
+#if LOG_PNT_STACK_DEPTH
+  /* the stack was for the allocation and not the free */
+  slot_p->sa_stack_p = NULL;
+#endif
+  
+  /* monitor current allocation level */
+  alloc_current -= slot_p->sa_user_size;
+  alloc_cur_given -= slot_p->sa_total_size;
+  free_space_bytes += slot_p->sa_total_size;
+  
+  /* clear the memory */
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_FREE_BLANK)
+      || BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_BLANK)) {
+    memset(slot_p->sa_mem, FREE_BLANK_CHAR, slot_p->sa_total_size);
+    /* set our slot blank flag */
+    BIT_SET(slot_p->sa_flags, ALLOC_FLAG_BLANK);
+  }
+  
+  /*
+   * The question is should we combine multiple free chunks together
+   * into one.  This would help we with fragmentation but it would
+   * screwup the seen counter.
+   *
+   * Check above and below the free bblock looking for neighbors that
+   * are free so we can add them together and put them in a different
+   * free slot.
+   *
+   * NOTE: all of these block's reuse-iter count will be moved ahead
+   * because we are encorporating in this newly freed block.
+   */
+  
+  if (! BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_NEVER_REUSE)) {
+#if FREED_POINTER_DELAY
+    slot_p->sa_next_p[0] = NULL;
+    if (free_wait_list_head == NULL) {
+      free_wait_list_head = slot_p;
+    }
+    else {
+      free_wait_list_tail->sa_next_p[0] = slot_p;
+    }
+    free_wait_list_tail = slot_p;
+#else
+    /* put slot on free list */
+    if (! insert_slot(slot_p, 1 /* free list */)) {
+      /* error dumped in insert_slot */
+      return FREE_ERROR;
+    }
+#endif
+  }
+  
+  return FREE_NOERROR;
+}
+
+/************************** low-level user functions *************************/
+
+/*
+ * void *_dmalloc_chunk_malloc
+ *
+ * Allocate a chunk of memory.
+ *
+ * Returns a valid pointer on success or NULL on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the allocation.
+ *
+ * line -> Line-number location of the allocation.
+ *
+ * size -> Number of bytes to allocate.
+ *
+ * func_id -> Calling function-id as defined in dmalloc.h.
+ *
+ * alignment -> If greater than 0 then the returned pointer is aligned
+ * on this power-of-two boundary.
+ *
+ * region -> Region-id to put the allocation in or 0 for none.
+ */
+void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
+			       const unsigned long size, const int func_id,
+			       const unsigned int alignment,
+			       const unsigned int region)
+{
+  unsigned long	needed_size;
+  PNT_ARITH_TYPE	user_addr;
+  int		fence_b = 0;
+  char		where_buf[MAX_FILE_LENGTH + 64], disp_buf[64];
+  skip_alloc_t	*slot_p;
+  pnt_info_t	pnt_info;
+  const char	*trans_log;
+  
+  /* counts calls to malloc */
+  if (func_id == DMALLOC_FUNC_CALLOC) {
+    func_calloc_c++;
+  }
+  else if (alignment == BLOCK_SIZE) {
+    func_valloc_c++;
+  }
+  else if (alignment > 0) {
+    func_memalign_c++;
+  }
+  else if (func_id == DMALLOC_FUNC_NEW) {
+    func_new_c++;
+  }
+  else if (func_id != DMALLOC_FUNC_REALLOC
+	   && func_id != DMALLOC_FUNC_RECALLOC) {
+    func_malloc_c++;
+  }
+  
+#if ALLOW_ALLOC_ZERO_SIZE == 0
+  if (size == 0) {
+    dmalloc_errno = DMALLOC_ERROR_BAD_SIZE;
+    log_error_info(file, line, NULL, NULL, "bad zero byte allocation request",
+		   "malloc");
+    return MALLOC_ERROR;
+  }
+#endif
+  
+#if LARGEST_ALLOCATION
+  /* have we exceeded the upper bounds */
+  if (size > LARGEST_ALLOCATION) {
+    dmalloc_errno = DMALLOC_ERROR_TOO_BIG;
+    log_error_info(file, line, NULL, NULL, "allocation too big", "malloc");
+    return MALLOC_ERROR;
+  }
+#endif
+  
+  if (region > 0
+      && (region > MAX_REGIONS || (! regions[region - 1].rg_in_use_b))) {
+    dmalloc_errno = DMALLOC_ERROR_BAD_REGION;
+    log_error_info(file, line, NULL, NULL, "checking region", "malloc");
+    return MALLOC_ERROR;
+  }
+  
+  needed_size = size;
+  
+  /* adjust the size */
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FENCE)) {
+    needed_size += FENCE_OVERHEAD_SIZE;
+    fence_b = 1;
+  }
+  
+  /*
+   * If the user is requesting an aligned block of data then we need
+   * room to slide the user pointer (and the bottom fence below it) up
+   * to the alignment inside of the chunk.
+   */
+  if (alignment > 0) {
+    needed_size = aligned_size(size, alignment, fence_b);
   }
   
   /* get some space for our memory */
@@ -2266,8 +2745,25 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
   if (fence_b) {
     BIT_SET(slot_p->sa_flags, ALLOC_FLAG_FENCE);
   }
-  if (valloc_b) {
+  if (alignment > 0) {
     BIT_SET(slot_p->sa_flags, ALLOC_FLAG_VALLOC);
+    user_addr = (PNT_ARITH_TYPE)slot_p->sa_mem;
+    if (fence_b) {
+      user_addr += FENCE_BOTTOM_SIZE;
+    }
+    user_addr = ALIGN_UP(user_addr, alignment);
+    slot_p->sa_offset = user_addr - (PNT_ARITH_TYPE)slot_p->sa_mem;
+  }
+  else {
+    slot_p->sa_offset = 0;
+  }
+  slot_p->sa_region = region;
+  if (region > 0) {
+    regions[region - 1].rg_pnt_c++;
+    if (regions[region - 1].rg_pnt_c == 1
+	|| (char *)slot_p->sa_mem < (char *)regions[region - 1].rg_low_p) {
+      regions[region - 1].rg_low_p = slot_p->sa_mem;
+    }
   }
   slot_p->sa_user_size = size;
   
@@ -2303,6 +2799,7 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
 #if LOG_PNT_THREAD_ID
   slot_p->sa_thread_id = THREAD_GET_ID();
 #endif
+  record_stack(slot_p);
   
   /* do we need to print transaction info? */
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
@@ -2320,16 +2817,26 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
       trans_log = "alloc";
       break;
     }
-    dmalloc_message("*** %s: at '%s' for %ld bytes, got '%s'",
-		    trans_log,
-		    _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
-					    file, line),
-		    size, display_pnt(pnt_info.pi_user_start, slot_p, disp_buf,
-				      sizeof(disp_buf)));
+    if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_JSON)) {
+      if (trans_json_begin(trans_log, file, line)) {
+	_dmalloc_json_ulong("size", size);
+	trans_json_pnt("pnt", pnt_info.pi_user_start, slot_p);
+	_dmalloc_json_end();
+      }
+    }
+    else {
+      dmalloc_message("*** %s: at '%s' for %ld bytes, got '%s'",
+		      trans_log,
+		      _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
+					      file, line),
+		      size, display_pnt(pnt_info.pi_user_start, slot_p,
+					disp_buf, sizeof(disp_buf)));
+    }
   }
   
 #if MEMORY_TABLE_TOP_LOG
-  _dmalloc_table_insert(&mem_table_alloc, file, line, size);
+  _dmalloc_table_insert(&mem_table_alloc, file, line, SLOT_STACK(slot_p),
+			size);
 #endif
   
   /* monitor current allocation level */
@@ -2362,12 +2869,18 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
  * user_pnt -> Pointer we are freeing.
  *
  * func_id -> Function ID
+ *
+ * size_b -> Set to 1 if the caller knows the size of the pointer.
+ *
+ * size -> Size that the caller thinks the pointer is.  We generate an
+ * error if it does not match the size allocated.  Ignored if size_b
+ * is 0.
  */
 int	_dmalloc_chunk_free(const char *file, const unsigned int line,
-			    void *user_pnt, const int func_id)
+			    void *user_pnt, const int func_id, const int size_b,
+			    const unsigned long size)
 {
   char		where_buf[MAX_FILE_LENGTH + 64];
-  char		where_buf2[MAX_FILE_LENGTH + 64], disp_buf[64];
   skip_alloc_t	*slot_p, *update_p;
   
   /* counts calls to free */
@@ -2453,101 +2966,27 @@ int	_dmalloc_chunk_free(const char *file, const unsigned int line,
   }
   
   if (! check_used_slot(slot_p, user_pnt, 1 /* exact pnt */, 0 /* no strlen */,
-			0 /* no min-size */)) {
+			0 /* no min-size */, NULL)) {
     /* error set in check slot */
     log_error_info(file, line, user_pnt, slot_p, "checking pointer admin",
 		   "free");
     return FREE_ERROR;
   }
   
-  if (! remove_slot(slot_p, update_p)) {
-    /* error set and dumped in remove_slot */
-    return FREE_ERROR;
-  }
-  if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FENCE)) {
-    /*
-     * We need to preserve the fence-post flag because we may need to
-     * properly check for previously freed pointers in the future.
-     */
-    slot_p->sa_flags = ALLOC_FLAG_FREE | ALLOC_FLAG_FENCE;
-  }
-  else {
-    slot_p->sa_flags = ALLOC_FLAG_FREE;
-  }
-  
-  alloc_cur_pnts--;
-  
-  slot_p->sa_use_iter = _dmalloc_iter_c;
-#if LOG_PNT_SEEN_COUNT
-  slot_p->sa_seen_c++;
-#endif
-  
-  /* do we need to print transaction info? */
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
-    dmalloc_message("*** free: at '%s' pnt '%s': size %u, alloced at '%s'",
-		    _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf), file,
-					    line),
-		    display_pnt(user_pnt, slot_p, disp_buf, sizeof(disp_buf)),
-		    slot_p->sa_user_size,
-		    _dmalloc_chunk_desc_pnt(where_buf2, sizeof(where_buf2),
-					    slot_p->sa_file, slot_p->sa_line));
-  }
-  
-#if MEMORY_TABLE_TOP_LOG
-  _dmalloc_table_delete(&mem_table_alloc, slot_p->sa_file, slot_p->sa_line,
-			slot_p->sa_user_size);
-#endif
-  
-  /* update the file/line -- must be after _dmalloc_table_delete */
-  slot_p->sa_file = file;
-  slot_p->sa_line = line;
-  
-  /* monitor current allocation level */
-  alloc_current -= slot_p->sa_user_size;
-  alloc_cur_given -= slot_p->sa_total_size;
-  free_space_bytes += slot_p->sa_total_size;
-  
-  /* clear the memory */
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_FREE_BLANK)
-      || BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_BLANK)) {
-    memset(slot_p->sa_mem, FREE_BLANK_CHAR, slot_p->sa_total_size);
-    /* set our slot blank flag */
-    BIT_SET(slot_p->sa_flags, ALLOC_FLAG_BLANK);
-  }
-  
   /*
-   * The question is should we combine multiple free chunks together
-   * into one.  This would help we with fragmentation but it would
-   * screwup the seen counter.
-   *
-   * Check above and below the free bblock looking for neighbors that
-   * are free so we can add them together and put them in a different
-   * free slot.
-   *
-   * NOTE: all of these block's reuse-iter count will be moved ahead
-   * because we are encorporating in this newly freed block.
+   * Once a pointer has been grown in place the caller may still know
+   * it by the size it asked for which we no longer have.
    */
-  
-  if (! BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_NEVER_REUSE)) {
-#if FREED_POINTER_DELAY
-    slot_p->sa_next_p[0] = NULL;
-    if (free_wait_list_head == NULL) {
-      free_wait_list_head = slot_p;
-    }
-    else {
-      free_wait_list_tail->sa_next_p[0] = slot_p;
-    }
-    free_wait_list_tail = slot_p;
-#else
-    /* put slot on free list */
-    if (! insert_slot(slot_p, 1 /* free list */)) {
-      /* error dumped in insert_slot */
-      return FREE_ERROR;
-    }
-#endif
+  if (size_b
+      && (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_EXPAND)
+	  ? size > slot_p->sa_user_size : size != slot_p->sa_user_size)) {
+    dmalloc_errno = DMALLOC_ERROR_WRONG_SIZE;
+    log_error_info(file, line, user_pnt, slot_p, "checking pointer size",
+		   "free");
+    return FREE_ERROR;
   }
   
-  return FREE_NOERROR;
+  return free_slot(file, line, slot_p, update_p, user_pnt);
 }
 
 /*
@@ -2630,7 +3069,7 @@ void	*_dmalloc_chunk_realloc(const char *file, const unsigned int line,
     
     /* allocate space for new chunk */
     new_user_pnt = _dmalloc_chunk_malloc(file, line, new_size, func_id,
-				    0 /* no align */);
+					 0 /* no align */, slot_p->sa_region);
     if (new_user_pnt == MALLOC_ERROR) {
       return REALLOC_ERROR;
     }
@@ -2647,8 +3086,8 @@ void	*_dmalloc_chunk_realloc(const char *file, const unsigned int line,
     }
     
     /* free old pointer */
-    if (_dmalloc_chunk_free(file, line, old_user_pnt,
-			    func_id) != FREE_NOERROR) {
+    if (_dmalloc_chunk_free(file, line, old_user_pnt, func_id,
+			    0 /* no size */, 0) != FREE_NOERROR) {
       return REALLOC_ERROR;
     }
   }
@@ -2672,6 +3111,7 @@ void	*_dmalloc_chunk_realloc(const char *file, const unsigned int line,
     
     /* change the slot information */
     slot_p->sa_user_size = new_size;
+    BIT_CLEAR(slot_p->sa_flags, ALLOC_FLAG_EXPAND);
     get_pnt_info(slot_p, &pnt_info);
     
     clear_alloc(slot_p, &pnt_info, old_size, func_id);
@@ -2684,8 +3124,12 @@ void	*_dmalloc_chunk_realloc(const char *file, const unsigned int line,
     
 #if MEMORY_TABLE_TOP_LOG
     _dmalloc_table_delete(&mem_table_alloc, slot_p->sa_file, slot_p->sa_line,
-			  old_size);
-    _dmalloc_table_insert(&mem_table_alloc, file, line, new_size);
+			  SLOT_STACK(slot_p), old_size);
+#endif
+    record_stack(slot_p);
+#if MEMORY_TABLE_TOP_LOG
+    _dmalloc_table_insert(&mem_table_alloc, file, line, SLOT_STACK(slot_p),
+			  new_size);
 #endif
   
     /*
@@ -2707,21 +3151,313 @@ void	*_dmalloc_chunk_realloc(const char *file, const unsigned int line,
     else {
       trans_log = "realloc";
     }
-    dmalloc_message("*** %s: at '%s' from '%p' (%u bytes) file '%s' to '%p' (%lu bytes)",
-		    trans_log,
-		    _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
-					    file, line),
-		    old_user_pnt, old_size,
-		    _dmalloc_chunk_desc_pnt(where_buf2, sizeof(where_buf2),
-					    old_file, old_line),
-		    new_user_pnt, new_size);
+    if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_JSON)) {
+      if (trans_json_begin(trans_log, file, line)) {
+	_dmalloc_json_pnt("old_pnt", old_user_pnt);
+	_dmalloc_json_ulong("old_size", old_size);
+	_dmalloc_json_where("alloc_", old_file, old_line);
+	_dmalloc_json_pnt("pnt", new_user_pnt);
+	_dmalloc_json_ulong("size", new_size);
+	_dmalloc_json_end();
+      }
+    }
+    else {
+      dmalloc_message("*** %s: at '%s' from '%p' (%u bytes) file '%s' to '%p' (%lu bytes)",
+		      trans_log,
+		      _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
+					      file, line),
+		      old_user_pnt, old_size,
+		      _dmalloc_chunk_desc_pnt(where_buf2, sizeof(where_buf2),
+					      old_file, old_line),
+		      new_user_pnt, new_size);
+    }
   }
   
   return new_user_pnt;
 }
 
+/*
+ * unsigned long _dmalloc_chunk_expand
+ *
+ * Grow a user pointer in place into the slack at the end of its chunk
+ * without moving it.  The top fence-post is moved up and the new
+ * space is blanked as with an in-place realloc so it can be used
+ * right away.
+ *
+ * Returns the new user size of the pointer or 0 if it could not be
+ * grown to min_size in place.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the call.
+ *
+ * line -> Line-number location of the call.
+ *
+ * user_pnt -> Pointer we are expanding.
+ *
+ * min_size -> Number of bytes the pointer needs to hold.
+ *
+ * max_b -> Set to 1 to claim all of the slack in the chunk instead of
+ * just min_size bytes.
+ */
+unsigned long	_dmalloc_chunk_expand(const char *file, const unsigned int line,
+				      void *user_pnt,
+				      const unsigned long min_size,
+				      const int max_b)
+{
+  skip_alloc_t	*slot_p;
+  pnt_info_t	pnt_info;
+  unsigned long	new_size, max_size;
+  unsigned int	old_size;
+  char		where_buf[MAX_FILE_LENGTH + 64];
+  
+  /* try to find the address with loose match */
+  slot_p = find_address(user_pnt, 0 /* used list */, 0 /* not exact pointer */,
+			skip_update);
+  if (slot_p == NULL) {
+    dmalloc_errno = DMALLOC_ERROR_NOT_FOUND;
+    log_error_info(file, line, user_pnt, NULL, "finding address in heap",
+		   "expand");
+    return 0;
+  }
+  
+  if (! check_used_slot(slot_p, user_pnt, 1 /* exact pnt */, 0 /* no strlen */,
+			0 /* no min-size */, NULL)) {
+    /* error set in check slot */
+    log_error_info(file, line, user_pnt, slot_p, "checking pointer admin",
+		   "expand");
+    return 0;
+  }
+  
+  get_pnt_info(slot_p, &pnt_info);
+  old_size = slot_p->sa_user_size;
+  
+  /* the top fence-post has to fit above the user space */
+  max_size = (char *)pnt_info.pi_upper_bounds - (char *)pnt_info.pi_user_start;
+  if (min_size > max_size) {
+    return 0;
+  }
+  
+  if (max_b) {
+    new_size = max_size;
+  }
+  else {
+    new_size = MAX(min_size, old_size);
+  }
+  if (new_size == old_size) {
+    return new_size;
+  }
+  
+  /* monitor current allocation level */
+  alloc_current += new_size - old_size;
+  alloc_maximum = MAX(alloc_maximum, alloc_current);
+  alloc_one_max = MAX(alloc_one_max, new_size);
+  
+  /* change the slot information */
+  slot_p->sa_user_size = new_size;
+  BIT_SET(slot_p->sa_flags, ALLOC_FLAG_EXPAND);
+  get_pnt_info(slot_p, &pnt_info);
+  
+  clear_alloc(slot_p, &pnt_info, old_size, DMALLOC_FUNC_MALLOC);
+  
+  slot_p->sa_use_iter = _dmalloc_iter_c;
+  
+#if MEMORY_TABLE_TOP_LOG
+  /* the pointer still belongs to the place that allocated it */
+  _dmalloc_table_delete(&mem_table_alloc, slot_p->sa_file, slot_p->sa_line,
+			SLOT_STACK(slot_p), old_size);
+  _dmalloc_table_insert(&mem_table_alloc, slot_p->sa_file, slot_p->sa_line,
+			SLOT_STACK(slot_p), new_size);
+#endif
+  
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
+    if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_JSON)) {
+      if (trans_json_begin("expand", file, line)) {
+	_dmalloc_json_pnt("pnt", user_pnt);
+	_dmalloc_json_ulong("old_size", old_size);
+	_dmalloc_json_ulong("size", new_size);
+	_dmalloc_json_end();
+      }
+    }
+    else {
+      dmalloc_message("*** expand: at '%s' '%p' from %u to %lu bytes",
+		      _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
+					      file, line),
+		      user_pnt, old_size, new_size);
+    }
+  }
+  
+  return new_size;
+}
+
+/*
+ * unsigned int _dmalloc_chunk_region_create
+ *
+ * Create a new allocation region.
+ *
+ * Returns the region-id on success or 0 if all of the regions are in
+ * use.
+ */
+unsigned int	_dmalloc_chunk_region_create(void)
+{
+  unsigned int	region_c;
+  
+  for (region_c = 0; region_c < MAX_REGIONS; region_c++) {
+    if (! regions[region_c].rg_in_use_b) {
+      regions[region_c].rg_in_use_b = 1;
+      regions[region_c].rg_pnt_c = 0;
+      regions[region_c].rg_low_p = NULL;
+      return region_c + 1;
+    }
+  }
+  
+  dmalloc_errno = DMALLOC_ERROR_BAD_REGION;
+  dmalloc_error("_dmalloc_chunk_region_create");
+  return 0;
+}
+
+/*
+ * int _dmalloc_chunk_region_destroy
+ *
+ * Free all of the pointers in a region and release the region-id.
+ * The used list is walked once starting at the region's low address
+ * and each of the region's pointers is checked and freed as it is
+ * found.  Pointers which fail their checks are logged and left
+ * allocated.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the call.
+ *
+ * line -> Line-number location of the call.
+ *
+ * region -> Region-id that we are destroying.
+ */
+int	_dmalloc_chunk_region_destroy(const char *file, const unsigned int line,
+				      const unsigned int region)
+{
+  region_t	*region_p;
+  skip_alloc_t	*slot_p, *update_p;
+  pnt_info_t	pnt_info;
+  int		level_c, ret = 1;
+  
+  if (region == 0 || region > MAX_REGIONS
+      || (! regions[region - 1].rg_in_use_b)) {
+    dmalloc_errno = DMALLOC_ERROR_BAD_REGION;
+    log_error_info(file, line, NULL, NULL, "checking region",
+		   "region_destroy");
+    return 0;
+  }
+  region_p = regions + region - 1;
+  
+  /*
+   * We need our own update pointers because freeing the slots uses
+   * skip_update to insert them into the free list.
+   */
+  update_p = skip_region_update;
+  if (region_p->rg_pnt_c > 0) {
+    (void)find_address(region_p->rg_low_p, 0 /* used list */,
+		       1 /* exact */, update_p);
+  }
+  
+  while (region_p->rg_pnt_c > 0) {
+    slot_p = update_p->sa_next_p[0]->sa_next_p[0];
+    if (slot_p == NULL) {
+      /* we ran out of slots before finding all of the region's */
+      dmalloc_errno = DMALLOC_ERROR_ADDRESS_LIST;
+      dmalloc_error("_dmalloc_chunk_region_destroy");
+      return 0;
+    }
+    
+    if (slot_p->sa_region == region) {
+      get_pnt_info(slot_p, &pnt_info);
+      if (check_used_slot(slot_p, pnt_info.pi_user_start, 1 /* exact pnt */,
+			  0 /* no strlen */, 0 /* no min-size */, NULL)) {
+	func_free_c++;
+	/* this takes the slot out from after the update pointers */
+	if (free_slot(file, line, slot_p, update_p,
+		      pnt_info.pi_user_start) != FREE_NOERROR) {
+	  return 0;
+	}
+	continue;
+      }
+      
+      /* error set in check slot */
+      log_error_info(file, line, pnt_info.pi_user_start, slot_p,
+		     "checking pointer admin", "region_destroy");
+      ret = 0;
+      
+      /* leave the bad pointer allocated but outside of the region */
+      slot_p->sa_region = 0;
+      region_p->rg_pnt_c--;
+    }
+    
+    /* move the update pointers past the slot */
+    for (level_c = 0; level_c <= slot_p->sa_level_n; level_c++) {
+      update_p->sa_next_p[level_c] = slot_p;
+    }
+  }
+  
+  region_p->rg_in_use_b = 0;
+  
+  return ret;
+}
+
 /***************************** diagnostic routines ***************************/
 
+/*
+ * static void log_stats_json
+ *
+ * Log the general statistics as one JSON record.
+ *
+ * ARGUMENTS:
+ *
+ * user_space -> Bytes in the user blocks.
+ *
+ * overhead -> Bytes in the admin blocks.
+ *
+ * tot_space -> Bytes in all of the blocks.
+ */
+static	void	log_stats_json(const unsigned long user_space,
+			       const unsigned long overhead,
+			       const unsigned long tot_space)
+{
+  if (! _dmalloc_json_begin("stats")) {
+    return;
+  }
+  _dmalloc_json_ulong("block_size", BLOCK_SIZE);
+  _dmalloc_json_ulong("alignment", ALLOCATION_ALIGNMENT);
+  _dmalloc_json_pnt("heap_low", _dmalloc_heap_low);
+  _dmalloc_json_pnt("heap_high", _dmalloc_heap_high);
+  _dmalloc_json_ulong("user_blocks", user_block_c);
+  _dmalloc_json_ulong("user_bytes", user_space);
+  _dmalloc_json_ulong("admin_blocks", admin_block_c);
+  _dmalloc_json_ulong("admin_bytes", overhead);
+  _dmalloc_json_ulong("total_blocks", user_block_c + admin_block_c);
+  _dmalloc_json_ulong("total_bytes", tot_space);
+  _dmalloc_json_ulong("heap_checks", heap_check_c);
+  _dmalloc_json_ulong("malloc_calls", func_malloc_c);
+  _dmalloc_json_ulong("calloc_calls", func_calloc_c);
+  _dmalloc_json_ulong("realloc_calls", func_realloc_c);
+  _dmalloc_json_ulong("free_calls", func_free_c);
+  _dmalloc_json_ulong("recalloc_calls", func_recalloc_c);
+  _dmalloc_json_ulong("memalign_calls", func_memalign_c);
+  _dmalloc_json_ulong("valloc_calls", func_valloc_c);
+  _dmalloc_json_ulong("new_calls", func_new_c);
+  _dmalloc_json_ulong("delete_calls", func_delete_c);
+  _dmalloc_json_ulong("current_bytes", alloc_current);
+  _dmalloc_json_ulong("current_pnts", alloc_cur_pnts);
+  _dmalloc_json_ulong("total_alloc_bytes", _dmalloc_alloc_total);
+  _dmalloc_json_ulong("total_alloc_pnts", alloc_tot_pnts);
+  _dmalloc_json_ulong("max_bytes", alloc_maximum);
+  _dmalloc_json_ulong("max_pnts", alloc_max_pnts);
+  _dmalloc_json_ulong("max_one_call", alloc_one_max);
+  _dmalloc_json_ulong("max_unused_bytes", alloc_max_given - alloc_maximum);
+  _dmalloc_json_end();
+}
+
 /*
  * void _dmalloc_chunk_log_stats
  *
@@ -2731,12 +3467,21 @@ void	_dmalloc_chunk_log_stats(void)
 {
   unsigned long	overhead, user_space, tot_space;
   
-  dmalloc_message("Dumping Chunk Statistics:");
-  
   tot_space = (user_block_c + admin_block_c) * BLOCK_SIZE;
   user_space = alloc_current + free_space_bytes;
   overhead = admin_block_c * BLOCK_SIZE;
   
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_JSON)) {
+    log_stats_json(user_space, overhead, tot_space);
+#if MEMORY_TABLE_TOP_LOG
+    _dmalloc_table_log_info(&mem_table_alloc, MEMORY_TABLE_TOP_LOG,
+			    MEMORY_TABLE_TOP_ORDER, 1 /* have in-use column */);
+#endif
+    return;
+  }
+  
+  dmalloc_message("Dumping Chunk Statistics:");
+  
   /* version information */
   dmalloc_message("basic-block %d bytes, alignment %d bytes",
 		  BLOCK_SIZE, ALLOCATION_ALIGNMENT);
@@ -2783,7 +3528,7 @@ void	_dmalloc_chunk_log_stats(void)
 #if MEMORY_TABLE_TOP_LOG
   dmalloc_message("top %d allocations:", MEMORY_TABLE_TOP_LOG);
   _dmalloc_table_log_info(&mem_table_alloc, MEMORY_TABLE_TOP_LOG,
-			  1 /* have in-use column */);
+			  MEMORY_TABLE_TOP_ORDER, 1 /* have in-use column */);
 #endif
 }
 
@@ -2839,9 +3584,8 @@ void	_dmalloc_chunk_log_changed(const unsigned long mark,
   }
   
   /* clear out our memory table so we can fill it with pointer info */
-  _dmalloc_table_init(&mem_table_changed, mem_table_changed_entries,
-		      sizeof(mem_table_changed_entries) /
-		      sizeof(*mem_table_changed_entries));
+  _dmalloc_table_init(&mem_table_changed, MEM_CHANGED_ENTRIES,
+		      &admin_block_c);
   
   /* run through the blocks */
   for (slot_p = skip_address_list->sa_next_p[0];
@@ -2923,13 +3667,14 @@ void	_dmalloc_chunk_log_changed(const unsigned long mark,
 	}
       }
       _dmalloc_table_insert(&mem_table_changed, slot_p->sa_file,
-			    slot_p->sa_line, slot_p->sa_user_size);
+			    slot_p->sa_line, SLOT_STACK(slot_p),
+			    slot_p->sa_user_size);
     }
   }
   
   /* dump the summary from the table table */
   _dmalloc_table_log_info(&mem_table_changed, 0 /* log all entries */,
-			  0 /* no in-use column */);
+			  MEM_TABLE_ORDER_TOTAL_SIZE, 0 /* no in-use column */);
   
   /* copy out size of pointers */
   if (block_c > 0) {
@@ -2947,6 +3692,128 @@ void	_dmalloc_chunk_log_changed(const unsigned long mark,
   }
 }
 
+/*
+ * static int write_fully
+ *
+ * Write a buffer out to a file descriptor retrying partial writes.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * fd -> File descriptor to write to.
+ *
+ * buf -> Buffer to write.
+ *
+ * buf_len -> Number of bytes in the buffer.
+ */
+static	int	write_fully(const int fd, const char *buf, const int buf_len)
+{
+  const char	*buf_p = buf;
+  int		left = buf_len, ret;
+  
+  while (left > 0) {
+    ret = write(fd, buf_p, left);
+    if (ret <= 0) {
+      return 0;
+    }
+    buf_p += ret;
+    left -= ret;
+  }
+  
+  return 1;
+}
+
+/*
+ * int _dmalloc_chunk_write_snapshot
+ *
+ * Write a binary snapshot of the pointers currently in use.  The
+ * records are gathered in a large buffer so that the file is written
+ * with a small number of big writes.  See snapshot.h for the format.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * fd -> File descriptor to write the snapshot to.
+ */
+int	_dmalloc_chunk_write_snapshot(const int fd)
+{
+  skip_alloc_t	*slot_p;
+  pnt_info_t	pnt_info;
+  snap_header_t	header;
+  snap_record_t	record;
+  char		*buf_p, *bounds_p;
+  int		file_len;
+  
+  buf_p = snapshot_buf;
+  bounds_p = snapshot_buf + sizeof(snapshot_buf);
+  
+  memset(&header, 0, sizeof(header));
+  header.sh_magic = SNAPSHOT_MAGIC;
+  header.sh_version = SNAPSHOT_VERSION;
+  header.sh_record_size = sizeof(snap_record_t);
+#if HAVE_GETPID
+  header.sh_pid = getpid();
+#endif
+  header.sh_iter_c = _dmalloc_iter_c;
+  memcpy(buf_p, &header, sizeof(header));
+  buf_p += sizeof(header);
+  
+  /* so the padding bytes are consistent */
+  memset(&record, 0, sizeof(record));
+  
+  for (slot_p = skip_address_list->sa_next_p[0];
+       slot_p != NULL;
+       slot_p = slot_p->sa_next_p[0]) {
+    
+    if (! BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER)) {
+      continue;
+    }
+    
+    get_pnt_info(slot_p, &pnt_info);
+    
+    record.sr_addr = (PNT_ARITH_TYPE)pnt_info.pi_user_start;
+    record.sr_use_iter = slot_p->sa_use_iter;
+    record.sr_user_size = slot_p->sa_user_size;
+    record.sr_total_size = slot_p->sa_total_size;
+    record.sr_line = slot_p->sa_line;
+    record.sr_flags = slot_p->sa_flags;
+    
+    /* with no line number the file is really a return-address */
+    if (slot_p->sa_line == DMALLOC_DEFAULT_LINE
+	|| slot_p->sa_file == DMALLOC_DEFAULT_FILE) {
+      record.sr_ret_addr = (PNT_ARITH_TYPE)slot_p->sa_file;
+      file_len = 0;
+    }
+    else {
+      record.sr_ret_addr = 0;
+      file_len = strlen(slot_p->sa_file);
+      if (file_len > SNAPSHOT_MAX_FILE) {
+	file_len = SNAPSHOT_MAX_FILE;
+      }
+    }
+    record.sr_file_len = file_len;
+    
+    /* flush the buffer if the record won't fit */
+    if (buf_p + sizeof(record) + file_len > bounds_p) {
+      if (! write_fully(fd, snapshot_buf, buf_p - snapshot_buf)) {
+	return 0;
+      }
+      buf_p = snapshot_buf;
+    }
+    
+    memcpy(buf_p, &record, sizeof(record));
+    buf_p += sizeof(record);
+    if (file_len > 0) {
+      memcpy(buf_p, slot_p->sa_file, file_len);
+      buf_p += file_len;
+    }
+  }
+  
+  return write_fully(fd, snapshot_buf, buf_p - snapshot_buf);
+}
+
 /*
  * unsigned long _dmalloc_chunk_count_changed
  *
@@ -3085,3 +3952,70 @@ void	_dmalloc_chunk_get_stats(void **heap_low_p, void **heap_high_p,
   SET_POINTER(max_pnt_np, alloc_max_pnts);
   SET_POINTER(max_one_p, alloc_one_max);
 }
+
+/*
+ * void _dmalloc_chunk_export_stats
+ *
+ * Publish the current heap statistics to the shared statistics page
+ * for the export-stats token.  The page is created on the first call.
+ * This must be called while we are still holding the library lock so
+ * there is only ever one writer.
+ */
+void	_dmalloc_chunk_export_stats(void)
+{
+  if (stats_page_p == NULL) {
+    if (stats_failed_b) {
+      return;
+    }
+    stats_page_p = _dmalloc_stats_create();
+    if (stats_page_p == NULL) {
+      stats_failed_b = 1;
+      dmalloc_message("could not create the statistics page for export-stats");
+      return;
+    }
+  }
+  
+  STATS_WRITE_BEGIN(stats_page_p);
+  
+  stats_page_p->sp_iter_c = _dmalloc_iter_c;
+  
+  stats_page_p->sp_alloc_current = alloc_current;
+  stats_page_p->sp_alloc_maximum = alloc_maximum;
+  stats_page_p->sp_alloc_total = _dmalloc_alloc_total;
+  stats_page_p->sp_alloc_one_max = alloc_one_max;
+  stats_page_p->sp_free_space_bytes = free_space_bytes;
+  
+  stats_page_p->sp_alloc_cur_pnts = alloc_cur_pnts;
+  stats_page_p->sp_alloc_max_pnts = alloc_max_pnts;
+  stats_page_p->sp_alloc_tot_pnts = alloc_tot_pnts;
+  
+  stats_page_p->sp_heap_check_c = heap_check_c;
+  stats_page_p->sp_user_block_c = user_block_c;
+  stats_page_p->sp_admin_block_c = admin_block_c;
+  
+  stats_page_p->sp_func_malloc_c = func_malloc_c;
+  stats_page_p->sp_func_calloc_c = func_calloc_c;
+  stats_page_p->sp_func_realloc_c = func_realloc_c;
+  stats_page_p->sp_func_recalloc_c = func_recalloc_c;
+  stats_page_p->sp_func_memalign_c = func_memalign_c;
+  stats_page_p->sp_func_valloc_c = func_valloc_c;
+  stats_page_p->sp_func_new_c = func_new_c;
+  stats_page_p->sp_func_free_c = func_free_c;
+  stats_page_p->sp_func_delete_c = func_delete_c;
+  
+  STATS_WRITE_END(stats_page_p);
+}
+
+/*
+ * void _dmalloc_chunk_forked
+ *
+ * Called in the child after a fork.  The child must not write its
+ * statistics into the page of its parent so it forgets the page and
+ * creates its own if it needs it.
+ */
+void	_dmalloc_chunk_forked(void)
+{
+  _dmalloc_stats_forget(stats_page_p);
+  stats_page_p = NULL;
+  stats_failed_b = 0;
+}
@@ -144,11 +144,49 @@ int	_dmalloc_chunk_heap_check(void);
  *
  * min_size -> Make sure that pnt can hold at least that many bytes.
  * If 0 then ignore.
+ *
+ * strlen_p <- If not NULL, this will be set to the length of the
+ * string if strlen_b is set and the pointer is in the heap, or -1 if
+ * the length is not known.
  */
 extern
 int	_dmalloc_chunk_pnt_check(const char *func, const void *user_pnt,
 				 const int exact_b, const int strlen_b,
-				 const int min_size);
+				 const int min_size, int *strlen_p);
+
+/*
+ * int _dmalloc_chunk_pnt_peek
+ *
+ * Quietly run the tests of _dmalloc_chunk_pnt_check on a pointer.
+ * This does not log anything, change the heap, or set dmalloc_errno
+ * so it can be called by threads which are sharing the library lock.
+ * If it fails, the caller should redo the check with
+ * _dmalloc_chunk_pnt_check while holding the lock to report the
+ * problem.
+ *
+ * Returns 1 if the pointer is okay or 0 if not
+ *
+ * ARGUMENTS:
+ *
+ * user_pnt -> Pointer we are checking.
+ *
+ * exact_b -> Set to 1 to find the pointer specifically.  Otherwise we
+ * can find the pointer inside of an allocation.
+ *
+ * strlen_b -> Make sure that pnt can hold at least a strlen + 1
+ * bytes.  If 0 then ignore.
+ *
+ * min_size -> Make sure that pnt can hold at least that many bytes.
+ * If 0 then ignore.
+ *
+ * strlen_p <- If not NULL, this will be set to the length of the
+ * string if strlen_b is set and the pointer is in the heap, or -1 if
+ * the length is not known.
+ */
+extern
+int	_dmalloc_chunk_pnt_peek(const void *user_pnt, const int exact_b,
+				const int strlen_b, const int min_size,
+				int *strlen_p);
 
 /*
  * void *_dmalloc_chunk_malloc
@@ -167,13 +205,16 @@ int	_dmalloc_chunk_pnt_check(const char *func, const void *user_pnt,
  *
  * func_id -> Calling function-id as defined in dmalloc.h.
  *
- * alignment -> If greater than 0 then try to align the returned
- * block.
+ * alignment -> If greater than 0 then the returned pointer is aligned
+ * on this power-of-two boundary.
+ *
+ * region -> Region-id to put the allocation in or 0 for none.
  */
 extern
 void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
 			       const unsigned long size, const int func_id,
-			       const unsigned int alignment);
+			       const unsigned int alignment,
+			       const unsigned int region);
 
 /*
  * int _dmalloc_chunk_free
@@ -191,10 +232,17 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
  * user_pnt -> Pointer we are freeing.
  *
  * func_id -> Function ID
+ *
+ * size_b -> Set to 1 if the caller knows the size of the pointer.
+ *
+ * size -> Size that the caller thinks the pointer is.  We generate an
+ * error if it does not match the size allocated.  Ignored if size_b
+ * is 0.
  */
 extern
 int	_dmalloc_chunk_free(const char *file, const unsigned int line,
-			    void *user_pnt, const int func_id);
+			    void *user_pnt, const int func_id, const int size_b,
+			    const unsigned long size);
 
 /*
  * void *_dmalloc_chunk_realloc
@@ -221,6 +269,70 @@ void	*_dmalloc_chunk_realloc(const char *file, const unsigned int line,
 				const unsigned long new_size,
 				const int func_id);
 
+/*
+ * unsigned long _dmalloc_chunk_expand
+ *
+ * Grow a user pointer in place into the slack at the end of its chunk
+ * without moving it.  The top fence-post is moved up and the new
+ * space is blanked as with an in-place realloc so it can be used
+ * right away.
+ *
+ * Returns the new user size of the pointer or 0 if it could not be
+ * grown to min_size in place.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the call.
+ *
+ * line -> Line-number location of the call.
+ *
+ * user_pnt -> Pointer we are expanding.
+ *
+ * min_size -> Number of bytes the pointer needs to hold.
+ *
+ * max_b -> Set to 1 to claim all of the slack in the chunk instead of
+ * just min_size bytes.
+ */
+extern
+unsigned long	_dmalloc_chunk_expand(const char *file, const unsigned int line,
+				      void *user_pnt,
+				      const unsigned long min_size,
+				      const int max_b);
+
+/*
+ * unsigned int _dmalloc_chunk_region_create
+ *
+ * Create a new allocation region.
+ *
+ * Returns the region-id on success or 0 if all of the regions are in
+ * use.
+ */
+extern
+unsigned int	_dmalloc_chunk_region_create(void);
+
+/*
+ * int _dmalloc_chunk_region_destroy
+ *
+ * Free all of the pointers in a region and release the region-id.
+ * The used list is walked once starting at the region's low address
+ * and each of the region's pointers is checked and freed as it is
+ * found.  Pointers which fail their checks are logged and left
+ * allocated.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the call.
+ *
+ * line -> Line-number location of the call.
+ *
+ * region -> Region-id that we are destroying.
+ */
+extern
+int	_dmalloc_chunk_region_destroy(const char *file, const unsigned int line,
+				      const unsigned int region);
+
 /*
  * void _dmalloc_chunk_log_stats
  *
@@ -252,6 +364,22 @@ void	_dmalloc_chunk_log_changed(const unsigned long mark,
 				   const int log_not_freed_b,
 				   const int log_freed_b, const int details_b);
 
+/*
+ * int _dmalloc_chunk_write_snapshot
+ *
+ * Write a binary snapshot of the pointers currently in use.  The
+ * records are gathered in a large buffer so that the file is written
+ * with a small number of big writes.  See snapshot.h for the format.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * fd -> File descriptor to write the snapshot to.
+ */
+extern
+int	_dmalloc_chunk_write_snapshot(const int fd);
+
 /*
  * unsigned long _dmalloc_chunk_count_changed
  *
@@ -323,6 +451,27 @@ void	_dmalloc_chunk_get_stats(void **heap_low_p, void **heap_high_p,
 				 unsigned long *max_pnt_np,
 				 unsigned long *max_one_p);
 
+/*
+ * void _dmalloc_chunk_export_stats
+ *
+ * Publish the current heap statistics to the shared statistics page
+ * for the export-stats token.  The page is created on the first call.
+ * This must be called while we are still holding the library lock so
+ * there is only ever one writer.
+ */
+extern
+void	_dmalloc_chunk_export_stats(void);
+
+/*
+ * void _dmalloc_chunk_forked
+ *
+ * Called in the child after a fork.  The child must not write its
+ * statistics into the page of its parent so it forgets the page and
+ * creates its own if it needs it.
+ */
+extern
+void	_dmalloc_chunk_forked(void);
+
 /*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
 
 #endif /* ! __CHUNK_H__ */
@@ -60,6 +60,10 @@
 
 /* NOTE: FENCE_BOTTOM_SIZE and FENCE_TOP_SIZE defined in settings.h */
 #define FENCE_OVERHEAD_SIZE	(FENCE_BOTTOM_SIZE + FENCE_TOP_SIZE)
+
+/* round a size or address up to a power-of-two alignment */
+#define ALIGN_UP(val, align)	\
+	(((val) + (align) - 1) & ~((PNT_ARITH_TYPE)(align) - 1))
 #define FENCE_MAGIC_BOTTOM	0xC0C0AB1B
 #define FENCE_MAGIC_TOP		0xFACADE69
 /* smallest allocated block */
@@ -73,7 +77,15 @@
 #define ALLOC_FLAG_ADMIN	BIT_FLAG(3)	/* administrative space */
 #define ALLOC_FLAG_BLANK	BIT_FLAG(4)	/* slot has been blanked */
 #define ALLOC_FLAG_FENCE	BIT_FLAG(5)	/* slot is fence posted */
-#define ALLOC_FLAG_VALLOC	BIT_FLAG(6)	/* slot is block aligned */
+#define ALLOC_FLAG_VALLOC	BIT_FLAG(6)	/* user pnt aligned at sa_offset */
+#define ALLOC_FLAG_EXPAND	BIT_FLAG(7)	/* user size grown in place */
+
+/* the recorded call stack of a slot if we are recording them */
+#if LOG_PNT_STACK_DEPTH
+#define SLOT_STACK(slot_p)	((slot_p)->sa_stack_p)
+#else
+#define SLOT_STACK(slot_p)	NULL
+#endif
 
 /*
  * Below defines an allocation structure either on the free or used
@@ -91,6 +103,8 @@ typedef struct skip_alloc_st {
   
   unsigned int		sa_user_size;	/* size requested by user (wo fence) */
   unsigned int		sa_total_size;	/* total size of the block */
+  unsigned int		sa_offset;	/* offset of aligned user pnt */
+  unsigned int		sa_region;	/* region-id or 0 if none */
   
   void			*sa_mem;	/* pointer to the memory in question */
   const char		*sa_file;	/* .c filename where allocated */
@@ -112,6 +126,9 @@ typedef struct skip_alloc_st {
 #if LOG_PNT_THREAD_ID
   THREAD_TYPE		sa_thread_id;	/* thread id which allocaed pnt */
 #endif
+#if LOG_PNT_STACK_DEPTH
+  const struct stack_entry_st	*sa_stack_p;	/* call stack of alloc */
+#endif
   
   /*
    * Array of next pointers.  This may extend past the end of the
@@ -121,6 +138,29 @@ typedef struct skip_alloc_st {
   
 } skip_alloc_t;
 
+/*
+ * A region groups allocations so they can all be released at once.
+ * The low address only goes down while the region is in use so it is
+ * a safe place to start looking for the region's slots.
+ */
+typedef struct {
+  int			rg_in_use_b;	/* region has been created */
+  unsigned long		rg_pnt_c;	/* pointers in the region */
+  void			*rg_low_p;	/* lowest address in the region */
+} region_t;
+
+/*
+ * An allocation that _dmalloc_chunk_pnt_check found recently.  The
+ * entry is only good while the generation matches the global one
+ * which changes whenever a pointer is freed.
+ */
+typedef struct {
+  const char		*cc_start_p;	/* start of the slot's memory */
+  const char		*cc_end_p;	/* end of the slot's memory */
+  skip_alloc_t		*cc_slot_p;	/* the slot we found */
+  unsigned long		cc_gen;		/* generation when it was found */
+} check_cache_t;
+
 /*
  * This macro helps us determine how much memory we need to store to
  * hold all of the next pointers in the skip-list entry.  So if we are
@@ -164,7 +204,7 @@ typedef struct entry_block_st {
  */
 typedef struct {
   int		pi_fence_b;		/* fence-posts are on for pointer */
-  int		pi_valloc_b;		/* pointer is valloc-aligned */
+  int		pi_valloc_b;		/* pointer is specially aligned */
   int		pi_blanked_b;		/* pointer was blanked */
   void		*pi_alloc_start;	/* pnt to start of allocation */
   void		*pi_fence_bottom;	/* pnt to the bottom fence area */
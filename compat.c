@@ -312,16 +312,47 @@ int	strlen(const char *str)
 
 #if HAVE_STRNLEN == 0
 /*
- * Return the length in characters of STR limited by MAX_LENGTH.
+ * Return the length in characters of STR limited by MAX_LENGTH.  We
+ * look at a word at a time once STR is aligned and never read a word
+ * which reaches past MAX_LENGTH.
  */
 int	strnlen(const char *str, const int max_length)
 {
-  const char *str_p = str;
-  int len = 0;
-  while (len < max_length && *str_p++ != '\0') {
-    len++;
+  const char		*str_p = str, *bounds_p = str + max_length;
+  const unsigned long	*word_p;
+  unsigned long		ones, highs;
+  
+  /* 0x0101...01 and 0x8080...80 for the zero byte test */
+  ones = (unsigned long)-1 / 0xff;
+  highs = ones << 7;
+  
+  /* go a byte at a time until we are aligned */
+  for (; str_p < bounds_p; str_p++) {
+    if ((PNT_ARITH_TYPE)str_p % sizeof(unsigned long) == 0) {
+      break;
+    }
+    if (*str_p == '\0') {
+      return str_p - str;
+    }
   }
-  return len;
+  
+  /* stop at the first word which might have a \0 in it */
+  for (word_p = (const unsigned long *)str_p;
+       (const char *)(word_p + 1) <= bounds_p;
+       word_p++) {
+    if (((*word_p - ones) & ~*word_p & highs) != 0) {
+      break;
+    }
+  }
+  
+  /* find the exact byte in the word or the leftovers at the end */
+  for (str_p = (const char *)word_p; str_p < bounds_p; str_p++) {
+    if (*str_p == '\0') {
+      break;
+    }
+  }
+  
+  return str_p - str;
 }
 #endif /* HAVE_STRNLEN == 0 */
 
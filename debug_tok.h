@@ -35,15 +35,16 @@
 #define DMALLOC_DEBUG_LOG_NONFREE	BIT_FLAG(1)	/* report non-freed pointers */
 #define DMALLOC_DEBUG_LOG_KNOWN		BIT_FLAG(2)	/* report only known nonfreed*/
 #define DMALLOC_DEBUG_LOG_TRANS		BIT_FLAG(3)	/* log memory transactions */
-/* 4 available - 20001107 */
+#define DMALLOC_DEBUG_EXPORT_STATS	BIT_FLAG(4)	/* publish live statistics */
 #define DMALLOC_DEBUG_LOG_ADMIN		BIT_FLAG(5)	/* log background admin info */
-/* 6 available 20030508 */
-/* 7 available - 20001107 */
+#define DMALLOC_DEBUG_LOG_STACK		BIT_FLAG(6)	/* record alloc call stacks */
+#define DMALLOC_DEBUG_LOG_MMAP		BIT_FLAG(7)	/* memory-map the logfile */
 #define DMALLOC_DEBUG_LOG_BAD_SPACE	BIT_FLAG(8)	/* dump space from bad pnt */
 #define DMALLOC_DEBUG_LOG_NONFREE_SPACE	BIT_FLAG(9)	/* dump space from non-freed */
 
 #define DMALLOC_DEBUG_LOG_ELAPSED_TIME	BIT_FLAG(18)	/* log pnt elapsed time info */
 #define DMALLOC_DEBUG_LOG_CURRENT_TIME	BIT_FLAG(19)	/* log pnt current time info */
+#define DMALLOC_DEBUG_LOG_JSON		BIT_FLAG(16)	/* write JSON log lines */
 
 /* checking */
 #define DMALLOC_DEBUG_CHECK_FENCE	BIT_FLAG(10)	/* check fence-post errors  */
@@ -54,7 +55,7 @@
 #define DMALLOC_DEBUG_CHECK_SHUTDOWN	BIT_FLAG(15)	/* check pointers on shutdown*/
 
 /* misc */
-/* 16 available - 20040709 */
+/* 16 used above */
 #define DMALLOC_DEBUG_CATCH_SIGNALS	BIT_FLAG(17)	/* catch HUP, INT, and TERM */
 /* 18,19 used above */
 #define DMALLOC_DEBUG_REALLOC_COPY	BIT_FLAG(20)	/* copy all reallocations */
@@ -99,6 +100,14 @@ __attribute__ ((unused))
     "log elapsed-time for allocated pointer" },
   { "log-current-time",	DMALLOC_DEBUG_LOG_CURRENT_TIME,
     "log current-time for allocated pointer" },
+  { "export-stats",	DMALLOC_DEBUG_EXPORT_STATS,
+    "publish live statistics to shared memory" },
+  { "log-stack",	DMALLOC_DEBUG_LOG_STACK,
+    "record the call stack of allocations" },
+  { "log-mmap",		DMALLOC_DEBUG_LOG_MMAP,
+    "memory-map the logfile and copy messages into it" },
+  { "log-json",		DMALLOC_DEBUG_LOG_JSON,
+    "write log entries as JSON objects, one per line" },
   
   { "check-fence",	DMALLOC_DEBUG_CHECK_FENCE,	"check fence-post errors" },
   { "check-heap",	DMALLOC_DEBUG_CHECK_HEAP,	"check heap adm structs" },
@@ -41,6 +41,12 @@
 #if HAVE_STDLIB_H
 # include <stdlib.h>
 #endif
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for sleep */
+#endif
+#if HAVE_SIGNAL_H
+# include <signal.h>				/* for kill */
+#endif
 
 #include "conf.h"
 #include "dmalloc_argv.h"			/* for argument processing */
@@ -52,6 +58,8 @@
 #include "env.h"
 #include "error_val.h"
 #include "dmalloc_loc.h"
+#include "snapshot.h"
+#include "stats.h"
 #include "version.h"
 
 #define HOME_ENVIRON	"HOME"			/* home directory */
@@ -65,6 +73,7 @@
 #define THREAD_LOCK_ON_ARG	'o'		/* lock-on argument */
 #define LIMIT_ARG		'M'		/* memory-limit argument */
 #define LINE_WIDTH		75		/* num debug toks per line */
+#define SITE_HASH_SIZE		4096		/* buckets for snapshot sites */
 
 #define FILE_NOT_FOUND		1
 #define FILE_FOUND		2
@@ -109,6 +118,21 @@ static	const default_t	defaults[] = {
   { NULL }
 };
 
+/*
+ * allocation location summarized from the snapshot files
+ */
+typedef struct site_st {
+  char			*si_file;		/* file name or NULL */
+  unsigned long		si_ret_addr;		/* return-address if no file */
+  unsigned int		si_line;		/* line number in file */
+  unsigned long		si_size[2];		/* bytes in each snapshot */
+  unsigned long		si_count[2];		/* pointers in each snapshot */
+  struct site_st	*si_next_p;		/* next in the hash bucket */
+} site_t;
+
+static	site_t	*site_table[SITE_HASH_SIZE];	/* sites by hash */
+static	int	site_n = 0;			/* number of sites */
+
 /* argument variables */
 static	int	bourne_b = 0;			/* set bourne shell output */
 static	int	cshell_b = 0;			/* set c-shell output */
@@ -132,10 +156,13 @@ static	argv_array_t	minus;			/* tokens to remove */
 static	unsigned long limit_arg = 0;		/* memory limit */
 static	int	make_changes_b = 1;		/* make no changes to env */
 static	argv_array_t	plus;			/* tokens to add */
+static	argv_array_t	snapshots;		/* snapshot files to read */
 static	int	remove_auto_b = 0;		/* auto-remove settings */
 static	char	*start_file = NULL;		/* for START settings */
 static	unsigned long start_iter = 0;		/* for START settings */
 static	unsigned long start_size = 0;		/* for START settings */
+static	int	stats_pid = 0;			/* process to print stats of */
+static	int	stats_interval = 0;		/* seconds between stats */
 static	int	usage_b = 0;			/* usage messages */
 static	int	verbose_b = 0;			/* verbose flag */
 static	int	very_verbose_b = 0;		/* very-verbose flag */
@@ -199,6 +226,13 @@ static	argv_t	args[] = {
   { '\0',	"start-size",	ARGV_U_SIZE,	&start_size,
     "size",			"check heap after this mem size" },
   
+  { '\0',	"snapshot",	ARGV_CHAR_P | ARGV_FLAG_ARRAY,	&snapshots,
+    "file",			"summarize or diff 2 heap snapshots" },
+  { '\0',	"stats",	ARGV_INT,	&stats_pid,
+    "pid",			"print live stats of a process" },
+  { '\0',	"watch",	ARGV_INT,	&stats_interval,
+    "seconds",			"repeat --stats every number secs" },
+  
   { 't',	"list-tags",	ARGV_BOOL_INT,	&list_tags_b,
     NULL,			"list tags in rc file" },
   { 'u',	"usage",	ARGV_BOOL_INT,	&usage_b,
@@ -785,6 +819,270 @@ static	void	dump_current(void)
 	      argv_argv[0]);
 }
 
+/*
+ * Print the live statistics published by process PID with the
+ * export-stats token.  If INTERVAL is not 0 then keep printing them
+ * every INTERVAL seconds until the process goes away.
+ */
+static	void	dump_stats(const int pid, const int interval)
+{
+  const stats_page_t	*page_p;
+  stats_page_t		stats;
+  
+  page_p = _dmalloc_stats_attach(pid);
+  if (page_p == NULL) {
+    loc_fprintf(stderr, "%s: could not attach to the stats of process %d\n",
+		argv_program, pid);
+    loc_fprintf(stderr, "  Is it running with the export-stats token?\n");
+    exit(1);
+  }
+  
+  while (1) {
+    if (! _dmalloc_stats_read(page_p, &stats)) {
+      loc_fprintf(stderr, "%s: stats of process %d kept changing\n",
+		  argv_program, pid);
+    }
+    else {
+      loc_fprintf(stderr, "Process %lu, iteration %lu:\n",
+		  stats.sp_pid, stats.sp_iter_c);
+      loc_fprintf(stderr, "  current memory in use: %lu bytes (%lu pnts)\n",
+		  stats.sp_alloc_current, stats.sp_alloc_cur_pnts);
+      loc_fprintf(stderr, " total memory allocated: %lu bytes (%lu pnts)\n",
+		  stats.sp_alloc_total, stats.sp_alloc_tot_pnts);
+      loc_fprintf(stderr, " max in use at one time: %lu bytes (%lu pnts)\n",
+		  stats.sp_alloc_maximum, stats.sp_alloc_max_pnts);
+      loc_fprintf(stderr, "max alloced with 1 call: %lu bytes\n",
+		  stats.sp_alloc_one_max);
+      loc_fprintf(stderr, "     free space in heap: %lu bytes\n",
+		  stats.sp_free_space_bytes);
+      loc_fprintf(stderr, "    user / admin blocks: %lu / %lu, heap checked %lu\n",
+		  stats.sp_user_block_c, stats.sp_admin_block_c,
+		  stats.sp_heap_check_c);
+      loc_fprintf(stderr, "alloc calls: malloc %lu, calloc %lu, realloc %lu, free %lu\n",
+		  stats.sp_func_malloc_c, stats.sp_func_calloc_c,
+		  stats.sp_func_realloc_c, stats.sp_func_free_c);
+      loc_fprintf(stderr, "alloc calls: recalloc %lu, memalign %lu, valloc %lu\n",
+		  stats.sp_func_recalloc_c, stats.sp_func_memalign_c,
+		  stats.sp_func_valloc_c);
+      loc_fprintf(stderr, "alloc calls: new %lu, delete %lu\n",
+		  stats.sp_func_new_c, stats.sp_func_delete_c);
+    }
+    
+    if (interval <= 0) {
+      break;
+    }
+    (void)sleep(interval);
+    
+#if HAVE_SIGNAL_H
+    /* stop once the process has gone away */
+    if (kill(pid, 0) != 0) {
+      loc_fprintf(stderr, "%s: process %d has exited\n", argv_program, pid);
+      break;
+    }
+#endif
+    loc_fprintf(stderr, "\n");
+  }
+}
+
+/*
+ * Find the site for FILE of FILE_LEN bytes and LINE, or RET_ADDR if
+ * there is no file, adding it to the table if it is not there yet.
+ */
+static	site_t	*find_site(const char *file, const int file_len,
+			   const unsigned long ret_addr,
+			   const unsigned int line)
+{
+  site_t	*site_p;
+  unsigned int	hash = ret_addr ^ (line * 31);
+  int		file_c;
+  
+  for (file_c = 0; file_c < file_len; file_c++) {
+    hash = hash * 31 + (unsigned char)file[file_c];
+  }
+  hash %= SITE_HASH_SIZE;
+  
+  for (site_p = site_table[hash]; site_p != NULL; site_p = site_p->si_next_p) {
+    if (site_p->si_line != line || site_p->si_ret_addr != ret_addr) {
+      continue;
+    }
+    if (file_len == 0 && site_p->si_file == NULL) {
+      return site_p;
+    }
+    if (file_len > 0 && site_p->si_file != NULL
+	&& strncmp(site_p->si_file, file, file_len) == 0
+	&& site_p->si_file[file_len] == '\0') {
+      return site_p;
+    }
+  }
+  
+  site_p = (site_t *)calloc(1, sizeof(site_t));
+  if (site_p == NULL) {
+    loc_fprintf(stderr, "%s: could not allocate snapshot site\n",
+		argv_program);
+    exit(1);
+  }
+  if (file_len > 0) {
+    site_p->si_file = (char *)malloc(file_len + 1);
+    if (site_p->si_file == NULL) {
+      loc_fprintf(stderr, "%s: could not allocate snapshot site\n",
+		  argv_program);
+      exit(1);
+    }
+    memcpy(site_p->si_file, file, file_len);
+    site_p->si_file[file_len] = '\0';
+  }
+  site_p->si_ret_addr = ret_addr;
+  site_p->si_line = line;
+  site_p->si_next_p = site_table[hash];
+  site_table[hash] = site_p;
+  site_n++;
+  
+  return site_p;
+}
+
+/*
+ * Read in the snapshot file at PATH and add its pointers to the site
+ * table in the WHICH column.  Passes back the header in HEADER_P.
+ */
+static	void	read_snapshot(const char *path, const int which,
+			      snap_header_t *header_p)
+{
+  FILE		*infile;
+  snap_record_t	record;
+  site_t	*site_p;
+  char		file[SNAPSHOT_MAX_FILE];
+  
+  infile = fopen(path, "rb");
+  if (infile == NULL) {
+    loc_fprintf(stderr, "%s: could not read '%s': ", argv_program, path);
+    perror("");
+    exit(1);
+  }
+  
+  if (fread(header_p, sizeof(*header_p), 1, infile) != 1
+      || header_p->sh_magic != SNAPSHOT_MAGIC
+      || header_p->sh_version != SNAPSHOT_VERSION
+      || header_p->sh_record_size != sizeof(snap_record_t)) {
+    loc_fprintf(stderr, "%s: '%s' is not a snapshot from this architecture\n",
+		argv_program, path);
+    exit(1);
+  }
+  
+  while (fread(&record, sizeof(record), 1, infile) == 1) {
+    if (record.sr_file_len > 0
+	&& fread(file, record.sr_file_len, 1, infile) != 1) {
+      loc_fprintf(stderr, "%s: snapshot '%s' is truncated\n",
+		  argv_program, path);
+      exit(1);
+    }
+    site_p = find_site(file, record.sr_file_len, record.sr_ret_addr,
+		       record.sr_line);
+    site_p->si_size[which] += record.sr_user_size;
+    site_p->si_count[which]++;
+  }
+  
+  (void)fclose(infile);
+}
+
+/*
+ * Compare two sites so the largest growth in bytes comes first.
+ */
+static	int	site_compare(const void *site1_p, const void *site2_p)
+{
+  const site_t	*s1_p = *(const site_t **)site1_p;
+  const site_t	*s2_p = *(const site_t **)site2_p;
+  long		diff1, diff2;
+  
+  diff1 = (long)s1_p->si_size[1] - (long)s1_p->si_size[0];
+  diff2 = (long)s2_p->si_size[1] - (long)s2_p->si_size[0];
+  if (diff1 > diff2) {
+    return -1;
+  }
+  else if (diff1 < diff2) {
+    return 1;
+  }
+  else {
+    return 0;
+  }
+}
+
+/*
+ * Summarize the snapshot files by allocation location.  With one file
+ * we list what is in use.  With two files we list what changed from
+ * the first to the second which is where the leaks show up.
+ */
+static	void	dump_snapshots(void)
+{
+  snap_header_t	old_header, new_header;
+  site_t	**sites, *site_p;
+  char		where[SNAPSHOT_MAX_FILE + 32];
+  long		size_diff, count_diff, total_size = 0, total_count = 0;
+  int		bucket_c, site_c = 0;
+  
+  if (snapshots.aa_entry_n > 2) {
+    loc_fprintf(stderr, "%s: --snapshot takes one or two files\n",
+		argv_program);
+    exit(1);
+  }
+  
+  /* a single snapshot is compared against nothing in the 1st column */
+  if (snapshots.aa_entry_n == 2) {
+    read_snapshot(ARGV_ARRAY_ENTRY(snapshots, char *, 0), 0, &old_header);
+    read_snapshot(ARGV_ARRAY_ENTRY(snapshots, char *, 1), 1, &new_header);
+    loc_fprintf(stderr, "Changes in process %lu from iteration %lu to %lu:\n",
+		new_header.sh_pid, old_header.sh_iter_c, new_header.sh_iter_c);
+  }
+  else {
+    read_snapshot(ARGV_ARRAY_ENTRY(snapshots, char *, 0), 1, &new_header);
+    loc_fprintf(stderr, "Pointers in use by process %lu at iteration %lu:\n",
+		new_header.sh_pid, new_header.sh_iter_c);
+  }
+  
+  sites = (site_t **)malloc(sizeof(site_t *) * (site_n + 1));
+  if (sites == NULL) {
+    loc_fprintf(stderr, "%s: could not allocate snapshot sites\n",
+		argv_program);
+    exit(1);
+  }
+  for (bucket_c = 0; bucket_c < SITE_HASH_SIZE; bucket_c++) {
+    for (site_p = site_table[bucket_c];
+	 site_p != NULL;
+	 site_p = site_p->si_next_p) {
+      sites[site_c++] = site_p;
+    }
+  }
+  qsort(sites, site_c, sizeof(site_t *), site_compare);
+  
+  loc_fprintf(stderr, " %11s %7s  %s\n", "bytes", "pnts", "location");
+  for (bucket_c = 0; bucket_c < site_c; bucket_c++) {
+    site_p = sites[bucket_c];
+    size_diff = (long)site_p->si_size[1] - (long)site_p->si_size[0];
+    count_diff = (long)site_p->si_count[1] - (long)site_p->si_count[0];
+    if (size_diff == 0 && count_diff == 0) {
+      continue;
+    }
+    
+    if (site_p->si_file != NULL) {
+      (void)loc_snprintf(where, sizeof(where), "%s:%u",
+			 site_p->si_file, site_p->si_line);
+    }
+    else if (site_p->si_ret_addr != 0) {
+      (void)loc_snprintf(where, sizeof(where), "ra=%#lx",
+			 site_p->si_ret_addr);
+    }
+    else {
+      (void)loc_snprintf(where, sizeof(where), "unknown");
+    }
+    
+    loc_fprintf(stderr, " %11ld %7ld  %s\n", size_diff, count_diff, where);
+    total_size += size_diff;
+    total_count += count_diff;
+  }
+  loc_fprintf(stderr, " %11ld %7ld  %s\n", total_size, total_count, "Total");
+  
+  free(sites);
+}
+
 /*
  * output the code to set env VAR to VALUE
  */
@@ -1029,6 +1327,14 @@ int	main(int argc, char **argv)
     list_tags();
   }
   
+  if (stats_pid > 0) {
+    dump_stats(stats_pid, stats_interval);
+  }
+  
+  if (snapshots.aa_entry_n > 0) {
+    dump_snapshots();
+  }
+  
   if (debug_tokens_b) {
     const attr_t	*attr_p;
     unsigned int	left = 0x7fffffff;
@@ -1066,7 +1372,9 @@ int	main(int argc, char **argv)
   }
   else if (errno_to_print == 0
 	   && (! list_tags_b)
-	   && (! debug_tokens_b)) {
+	   && (! debug_tokens_b)
+	   && stats_pid == 0
+	   && snapshots.aa_entry_n == 0) {
     dump_current();
   }
   
@@ -39,6 +39,10 @@
 
 #include "conf.h"
 
+#if HAVE_WMEMCPY
+# include <wchar.h>
+#endif
+
 #if HAVE_TIME
 # ifdef TIME_INCLUDE
 #  include TIME_INCLUDE
@@ -52,6 +56,12 @@
 #include "debug_tok.h"
 #include "error_val.h"
 
+#if HAVE___CHK_FAIL && HAVE___MEMCPY_CHK
+/* fortify routine in the library which we call directly */
+extern	void	*__memcpy_chk(void *to, const void *from,
+			      const DMALLOC_SIZE len, const DMALLOC_SIZE to_size);
+#endif
+
 /* argument variables */
 static	char		*env_string = NULL;		/* env options */
 static	int		silent_b = ARGV_FALSE;		/* silent flag */
@@ -428,6 +438,35 @@ static	int	do_memcpy(void) {
 }
 #endif
 
+#if HAVE_MEMMEM
+static	int	do_memmem(void) {
+  char	*pnt, *val, *loc;
+  char	*func_name = "memmem";
+  int	ret;
+  
+  pnt = malloc(5);
+  val = "footy";
+  memmove(pnt, val, strlen(val));
+  
+  loc = memmem(pnt, strlen(val), "ty", 2);
+  if (! check_ok(func_name)) {
+    return 0;
+  }
+  
+  if (loc != pnt + 3) {
+    if (! silent_b) {
+      (void)printf("   ERROR: %s should have found the ty\n", func_name);
+    }
+    return 0;
+  }
+  
+  memmem(pnt, strlen(val) + 1, "ty", 2);
+  ret = check_fail(func_name, DMALLOC_ERROR_WOULD_OVERWRITE);
+  free(pnt);
+  return ret;
+}
+#endif
+
 #if HAVE_MEMMOVE
 static	int	do_memmove(void) {
   char	*pnt, *val;
@@ -457,6 +496,35 @@ static	int	do_memmove(void) {
 }
 #endif
 
+#if HAVE_MEMRCHR
+static	int	do_memrchr(void) {
+  char	*pnt, *val, *loc;
+  char	*func_name = "memrchr";
+  int	ret;
+  
+  pnt = malloc(5);
+  val = "footy";
+  memmove(pnt, val, strlen(val));
+  
+  loc = memrchr(pnt, 'o', strlen(val));
+  if (! check_ok(func_name)) {
+    return 0;
+  }
+  
+  if (loc != pnt + 2) {
+    if (! silent_b) {
+      (void)printf("   ERROR: %s should have found the last o\n", func_name);
+    }
+    return 0;
+  }
+  
+  memrchr(pnt, 'u', strlen(val) + 1);
+  ret = check_fail(func_name, DMALLOC_ERROR_WOULD_OVERWRITE);
+  free(pnt);
+  return ret;
+}
+#endif
+
 #if HAVE_MEMSET
 static	int	do_memset(void) {
   char	*pnt;
@@ -525,6 +593,35 @@ static	int	do_rindex(void) {
 }
 #endif
 
+#if HAVE_STPCPY
+static	int	do_stpcpy(void) {
+  char	*pnt, *val, *end;
+  char	*func_name = "stpcpy";
+  int	ret;
+
+  pnt = malloc(5);
+  val = "1234";
+  
+  end = stpcpy(pnt, val);
+  if (! check_ok(func_name)) {
+    return 0;
+  }
+  
+  if (end != pnt + 4 || memcmp(pnt, val, strlen(val) + 1) != 0) {
+    if (! silent_b) {
+      (void)printf("   ERROR: %s should have copied the bytes\n", func_name);
+    }
+    return 0;
+  }
+  
+  val = "12345";
+  stpcpy(pnt, val);
+  ret = check_fail(func_name, DMALLOC_ERROR_WOULD_OVERWRITE);
+  free(pnt);
+  return ret;
+}
+#endif
+
 #if HAVE_STRCASECMP
 static	int	do_strcasecmp(void) {
   char	*pnt, *val, *big_val;
@@ -713,6 +810,66 @@ static	int	do_strcspn(void) {
 }
 #endif
 
+#if HAVE_STRLCAT
+static	int	do_strlcat(void) {
+  char	*pnt;
+  char	*func_name = "strlcat";
+  int	ret;
+  
+  pnt = malloc(5);
+  strcpy(pnt, "12");
+  
+  /* truncated to the size we pass in which is okay */
+  ret = strlcat(pnt, "3456", 5);
+  if (! check_ok(func_name)) {
+    return 0;
+  }
+  
+  if (ret != 6 || strcmp(pnt, "1234") != 0) {
+    if (! silent_b) {
+      (void)printf("   ERROR: %s should have truncated the string\n",
+		   func_name);
+    }
+    return 0;
+  }
+  
+  strcpy(pnt, "12");
+  strlcat(pnt, "3456", 6);
+  ret = check_fail(func_name, DMALLOC_ERROR_WOULD_OVERWRITE);
+  free(pnt);
+  return ret;
+}
+#endif
+
+#if HAVE_STRLCPY
+static	int	do_strlcpy(void) {
+  char	*pnt;
+  char	*func_name = "strlcpy";
+  int	ret;
+  
+  pnt = malloc(5);
+  
+  /* truncated to the size we pass in which is okay */
+  ret = strlcpy(pnt, "123456", 5);
+  if (! check_ok(func_name)) {
+    return 0;
+  }
+  
+  if (ret != 6 || strcmp(pnt, "1234") != 0) {
+    if (! silent_b) {
+      (void)printf("   ERROR: %s should have truncated the string\n",
+		   func_name);
+    }
+    return 0;
+  }
+  
+  strlcpy(pnt, "123456", 6);
+  ret = check_fail(func_name, DMALLOC_ERROR_WOULD_OVERWRITE);
+  free(pnt);
+  return ret;
+}
+#endif
+
 #if HAVE_STRLEN
 static	int	do_strlen(void) {
   char	*pnt, *val;
@@ -871,6 +1028,36 @@ static	int	do_strncpy(void) {
 }
 #endif
 
+#if HAVE_STRNLEN
+static	int	do_strnlen(void) {
+  char	*pnt, *val;
+  char	*func_name = "strnlen";
+  int	ret;
+  
+  pnt = malloc(5);
+  val = "12345";
+  memmove(pnt, val, strlen(val));
+  
+  /* no \0 but we stop at the end of the allocation */
+  ret = strnlen(pnt, 5);
+  if (! check_ok(func_name)) {
+    return 0;
+  }
+  
+  if (ret != 5) {
+    if (! silent_b) {
+      (void)printf("   ERROR: %s got improper string length\n", func_name);
+    }
+    return 0;
+  }
+  
+  strnlen(pnt, 6);
+  ret = check_fail(func_name, DMALLOC_ERROR_WOULD_OVERWRITE);
+  free(pnt);
+  return ret;
+}
+#endif
+
 #if HAVE_STRPBRK
 static	int	do_strpbrk(void) {
   char	*pnt, *val, *loc;
@@ -1027,6 +1214,63 @@ static	int	do_strtok(void) {
 }
 #endif
 
+#if HAVE_WMEMCPY
+static	int	do_wmemcpy(void) {
+  wchar_t	*pnt, *val;
+  char		*func_name = "wmemcpy";
+  int		ret;
+  
+  pnt = malloc(5 * sizeof(wchar_t));
+  val = L"123456";
+  
+  wmemcpy(pnt, val, 5);
+  if (! check_ok(func_name)) {
+    return 0;
+  }
+  
+  if (memcmp(pnt, val, 5 * sizeof(wchar_t)) != 0) {
+    if (! silent_b) {
+      (void)printf("   ERROR: %s should have copied the chars\n", func_name);
+    }
+    return 0;
+  }
+  
+  wmemcpy(pnt, val, 6);
+  ret = check_fail(func_name, DMALLOC_ERROR_WOULD_OVERWRITE);
+  free(pnt);
+  return ret;
+}
+#endif
+
+#if HAVE___CHK_FAIL && HAVE___MEMCPY_CHK
+/*
+ * The fortify routines are called by the compiler when it thinks it
+ * knows the destination size, here it is wrong about the heap block.
+ * We call through a pointer so the compiler does not turn it back
+ * into a memcpy.
+ */
+static	int	do_memcpy_chk(void) {
+  void	*(*volatile chk_func)(void *, const void *, const DMALLOC_SIZE,
+			      const DMALLOC_SIZE) = __memcpy_chk;
+  char	*pnt, *val;
+  char	*func_name = "__memcpy_chk";
+  int	ret;
+  
+  pnt = malloc(5);
+  val = "123456";
+  
+  chk_func(pnt, val, 5, 5);
+  if (! check_ok(func_name)) {
+    return 0;
+  }
+  
+  chk_func(pnt, val, 6, 6);
+  ret = check_fail(func_name, DMALLOC_ERROR_WOULD_OVERWRITE);
+  free(pnt);
+  return ret;
+}
+#endif
+
 static	int	(*const test_funcs[])() = {
 #if HAVE_ATOI
   do_atoi,
@@ -1058,15 +1302,24 @@ static	int	(*const test_funcs[])() = {
 #if HAVE_MEMCPY
   do_memcpy,
 #endif
+#if HAVE_MEMMEM
+  do_memmem,
+#endif
 #if HAVE_MEMMOVE
   do_memmove,
 #endif
+#if HAVE_MEMRCHR
+  do_memrchr,
+#endif
 #if HAVE_MEMSET
   do_memset,
 #endif
 #if HAVE_RINDEX
   do_rindex,
 #endif
+#if HAVE_STPCPY
+  do_stpcpy,
+#endif
 #if HAVE_STRCASECMP
   do_strcasecmp,
 #endif
@@ -1085,6 +1338,12 @@ static	int	(*const test_funcs[])() = {
 #if HAVE_STRCSPN
   do_strcspn,
 #endif
+#if HAVE_STRLCAT
+  do_strlcat,
+#endif
+#if HAVE_STRLCPY
+  do_strlcpy,
+#endif
 #if HAVE_STRLEN
   do_strlen,
 #endif
@@ -1100,6 +1359,9 @@ static	int	(*const test_funcs[])() = {
 #if HAVE_STRNCPY
   do_strncpy,
 #endif
+#if HAVE_STRNLEN
+  do_strnlen,
+#endif
 #if HAVE_STRPBRK
   do_strpbrk,
 #endif
@@ -1114,6 +1376,12 @@ static	int	(*const test_funcs[])() = {
 #endif
 #if HAVE_STRTOK
   do_strtok,
+#endif
+#if HAVE_WMEMCPY
+  do_wmemcpy,
+#endif
+#if HAVE___CHK_FAIL && HAVE___MEMCPY_CHK
+  do_memcpy_chk,
 #endif
   0L,
 };
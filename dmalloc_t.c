@@ -24,6 +24,7 @@
  * should be script based.
  */
 
+#include <errno.h>				/* for EINVAL */
 #include <stdio.h>				/* for stdin */
 
 #if HAVE_STDLIB_H
@@ -57,6 +58,9 @@
 #include "debug_tok.h"
 #include "error_val.h"
 #include "heap.h"				/* for external testing */
+#include "snapshot.h"				/* for snapshot testing */
+#include "stack.h"				/* for log-stack testing */
+#include "stats.h"				/* for export-stats testing */
 
 #define INTER_CHAR		'i'
 #define DEFAULT_ITERATIONS	10000
@@ -83,6 +87,7 @@ static	pnt_info_t	*pointer_grid;
 /* argument variables */
 static	long		default_iter_n = DEFAULT_ITERATIONS; /* # of iters */
 static	char		*env_string = NULL;		/* env options */
+static	long		format_bench_n = 0;		/* format bench iters */
 static	int		interactive_b = ARGV_FALSE;	/* interactive flag */
 static	int		log_trans_b = ARGV_FALSE;	/* log transactions */
 static	int		no_special_b = ARGV_FALSE;	/* no-special flag */
@@ -98,6 +103,8 @@ static	argv_t		arg_list[] = {
     NULL,			"turn on interactive mode" },
   { 'e',	"env-string",		ARGV_CHAR_P,		&env_string,
     "string",			"string of env commands to set" },
+  { 'F',	"format-bench",		ARGV_SIZE,		&format_bench_n,
+    "number",			"time X log line formats and exit" },
   { 'l',	"log-trans",		ARGV_BOOL_INT,		&log_trans_b,
     NULL,			"log transactions via tracking-func" },
   { 'm',	"max-alloc",		ARGV_SIZE,		&max_alloc,
@@ -1742,7 +1749,7 @@ static	int	check_arg_check(void)
   
   {
     void	*new_pnt;
-
+  
     pnt = "12345";
     size = 5;
     /* this looks at enough characters in buffer */
@@ -2594,7 +2601,7 @@ static	int	check_special(void)
     unsigned int	old_flags = dmalloc_debug_current();
     
     old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
-
+  
     if (! silent_b) {
       loc_printf("  Checking per-pointer blanking flags\n");
     }
@@ -2678,7 +2685,7 @@ static	int	check_special(void)
     unsigned int	old_flags = dmalloc_debug_current();
     
     old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
-
+  
     if (! silent_b) {
       loc_printf("  Checking per-pointer alloc flags and realloc\n");
     }
@@ -2692,42 +2699,619 @@ static	int	check_special(void)
     pnt = malloc(size);
     if (pnt == NULL) {
       if (! silent_b) {
-	loc_printf("   ERROR: could not malloc %lu bytes.\n", size);
+	loc_printf("   ERROR: could not malloc %lu bytes.\n", size);
+      }
+      return 0;
+    }
+    
+    /* now disable all checking */
+    dmalloc_debug((old_flags | DMALLOC_DEBUG_CHECK_BLANK)
+		  & (~(DMALLOC_DEBUG_CHECK_FENCE
+		       | DMALLOC_DEBUG_ALLOC_BLANK | DMALLOC_DEBUG_FREE_BLANK)));
+    
+    pnt = realloc(pnt, size - 1);
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not realloc %p to %lu bytes.\n", pnt, size - 1);
+      }
+      return 0;
+    }
+    
+    /* overwrite one of the top chars */
+    save_ch = *((char *)pnt + size - 1);
+    *((char *)pnt + size - 1) = '\0';
+    
+    /* we should notice the overwrite */
+    if (dmalloc_free(__FILE__, __LINE__, pnt,
+		     DMALLOC_FUNC_FREE) == FREE_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: per-pointer alloc flags should have failed: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    
+    /* restore the overwrite */
+    *((char *)pnt + size - 1) = save_ch;
+    
+    /* restore flags */
+    dmalloc_debug_setup(old_env);
+    dmalloc_errno = errno_hold;
+  }
+  
+  /********************/
+  
+  /*
+   * Make sure that a free of an existing pointer gets the right error.
+   */
+  {
+    int		errno_hold = dmalloc_errno;
+    int		size = 10;
+    
+    if (! silent_b) {
+      loc_printf("  Checking double free error\n");
+    }
+    
+    pnt = malloc(size);
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not malloc %d bytes.\n", size);
+      }
+      return 0;
+    }
+    
+    if (dmalloc_free(__FILE__, __LINE__, pnt,
+		     DMALLOC_FUNC_FREE) != FREE_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: 1st of double free should not fail: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_free(__FILE__, __LINE__, pnt,
+		     DMALLOC_FUNC_FREE) == FREE_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: 2nd of double free should have failed: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    else if (dmalloc_errno != DMALLOC_ERROR_ALREADY_FREE) {
+      if (! silent_b) {
+	loc_printf("   ERROR: 2nd of double free should get DMALLOC_ERROR_ALREADY_FREE not: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    
+    dmalloc_errno = errno_hold;
+  }
+  
+  /********************/
+  
+  /*
+   * Coverage tests
+   */
+#if FREED_POINTER_DELAY > 0
+  {
+    int		errno_hold = dmalloc_errno;
+    int		size = 10, pnt_c;
+    
+    if (! silent_b) {
+      loc_printf("  Checking freed pointer delay\n");
+    }
+    
+    pnt = malloc(size);
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not malloc %d bytes.\n", size);
+      }
+      return 0;
+    }
+    for (pnt_c = 0; pnt_c < FREED_POINTER_DELAY; pnt_c++) {
+      void	*pnt2 = malloc(size);
+      if (pnt2 == NULL) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: could not malloc %d bytes.\n", size);
+	}
+	return 0;
+      }
+      free(pnt2);
+    }
+    
+    /* now double free the first one */
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_free(__FILE__, __LINE__, pnt,
+		     DMALLOC_FUNC_FREE) != FREE_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: 1st of double free should not fail: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    
+    if (dmalloc_free(__FILE__, __LINE__, pnt,
+		     DMALLOC_FUNC_FREE) == FREE_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: 2nd of double free should have failed: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    else if (dmalloc_errno != DMALLOC_ERROR_ALREADY_FREE) {
+      if (! silent_b) {
+	loc_printf("   ERROR: 2nd of double free should get DMALLOC_ERROR_ALREADY_FREE not: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    
+    dmalloc_errno = errno_hold;
+  }
+#endif
+  
+  /********************/
+  
+  /*
+   * Make sure that a sized free checks the size of the pointer.
+   */
+  {
+    int		errno_hold = dmalloc_errno;
+    int		size = 10;
+    
+    if (! silent_b) {
+      loc_printf("  Checking sized free\n");
+    }
+    
+    pnt = malloc(size);
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not malloc %d bytes.\n", size);
+      }
+      return 0;
+    }
+    
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_free_sized(__FILE__, __LINE__, pnt, size + 1,
+			   DMALLOC_FUNC_DELETE) == FREE_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: free with the wrong size should have failed\n");
+      }
+      final = 0;
+    }
+    else if (dmalloc_errno != DMALLOC_ERROR_WRONG_SIZE) {
+      if (! silent_b) {
+	loc_printf("   ERROR: wrong size free should get DMALLOC_ERROR_WRONG_SIZE not: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    
+    if (dmalloc_free_sized(__FILE__, __LINE__, pnt, size,
+			   DMALLOC_FUNC_DELETE) != FREE_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: free with the right size should not fail: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    
+    dmalloc_errno = errno_hold;
+  }
+  
+  /********************/
+  
+  /*
+   * Test that aligned allocations are aligned, usable, and still have
+   * working fence-posts.
+   */
+  {
+    int		errno_hold = dmalloc_errno;
+    int		align_c, size_c, fence_b, ret;
+    int		aligns[] = { 16, 64, 512, BLOCK_SIZE, BLOCK_SIZE * 4, 0 };
+    int		sizes[] = { 1, 100, BLOCK_SIZE / 2, BLOCK_SIZE * 3, 0 };
+    char	save_ch;
+    void	*pnt2;
+    DMALLOC_SIZE	ex_size;
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    
+    if (! silent_b) {
+      loc_printf("  Checking aligned allocations\n");
+    }
+    
+    /* hold a small pointer so divided blocks do not start on a block */
+    pnt2 = malloc(1);
+    
+    /* try with and without fence-posts */
+    for (fence_b = 0; fence_b < 2; fence_b++) {
+      if (fence_b) {
+	dmalloc_debug(DMALLOC_DEBUG_CHECK_FENCE | DMALLOC_DEBUG_ALLOC_BLANK
+		      | DMALLOC_DEBUG_CHECK_BLANK);
+      }
+      else {
+	dmalloc_debug(DMALLOC_DEBUG_ALLOC_BLANK | DMALLOC_DEBUG_CHECK_BLANK);
+      }
+      
+      for (align_c = 0; aligns[align_c] != 0; align_c++) {
+	for (size_c = 0; sizes[size_c] != 0; size_c++) {
+  
+	  pnt = memalign(aligns[align_c], sizes[size_c]);
+	  if (pnt == NULL) {
+	    if (! silent_b) {
+	      loc_printf("   ERROR: could not memalign %d bytes at %d.\n",
+			 sizes[size_c], aligns[align_c]);
+	    }
+	    final = 0;
+	    continue;
+	  }
+	  if ((PNT_ARITH_TYPE)pnt % aligns[align_c] != 0) {
+	    if (! silent_b) {
+	      loc_printf("   ERROR: memalign %d returned unaligned %p.\n",
+			 aligns[align_c], pnt);
+	    }
+	    final = 0;
+	  }
+  
+	  memset(pnt, 'x', sizes[size_c]);
+	  if (dmalloc_examine(pnt, &ex_size, NULL, NULL, NULL, NULL, NULL,
+			      NULL) != DMALLOC_NOERROR
+	      || ex_size != (DMALLOC_SIZE)sizes[size_c]
+	      || dmalloc_verify(pnt) != DMALLOC_NOERROR) {
+	    if (! silent_b) {
+	      loc_printf("   ERROR: verify of aligned %p failed: %s (err %d)\n",
+			 pnt, dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+	    }
+	    final = 0;
+	  }
+  
+	  if (! fence_b) {
+	    free(pnt);
+	    continue;
+	  }
+	  
+	  /* the byte below the user pointer is the bottom fence */
+	  save_ch = *((char *)pnt - 1);
+	  *((char *)pnt - 1) = save_ch + 1;
+	  dmalloc_errno = DMALLOC_ERROR_NONE;
+	  if (dmalloc_verify(pnt) == DMALLOC_NOERROR) {
+	    if (! silent_b) {
+	      loc_printf("   ERROR: underwrite of aligned %p not detected.\n",
+			 pnt);
+	    }
+	    final = 0;
+	  }
+	  else if (dmalloc_errno != DMALLOC_ERROR_UNDER_FENCE) {
+	    if (! silent_b) {
+	      loc_printf("   ERROR: underwrite of aligned pointer returned: %s (err %d)\n",
+			 dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+	    }
+	    final = 0;
+	  }
+	  *((char *)pnt - 1) = save_ch;
+  
+	  free(pnt);
+	}
+      }
+    }
+    
+    free(pnt2);
+    
+    /* posix_memalign rejects alignments which are not powers of two */
+    pnt2 = NULL;
+    ret = posix_memalign(&pnt2, 24, 10);
+    if (ret != EINVAL || pnt2 != NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: posix_memalign with bad alignment returned %d.\n",
+		   ret);
+      }
+      final = 0;
+    }
+    ret = posix_memalign(&pnt2, 256, 10);
+    if (ret != 0 || pnt2 == NULL || (PNT_ARITH_TYPE)pnt2 % 256 != 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: posix_memalign returned %d with %p.\n",
+		   ret, pnt2);
+      }
+      final = 0;
+    }
+    if (pnt2 != NULL) {
+      free(pnt2);
+    }
+    
+    /* as does aligned_alloc which sets errno */
+    errno = 0;
+    pnt2 = aligned_alloc(24, 10);
+    if (pnt2 != NULL || errno != EINVAL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: aligned_alloc with bad alignment returned %p.\n",
+		   pnt2);
+      }
+      final = 0;
+    }
+    if (pnt2 != NULL) {
+      free(pnt2);
+    }
+    
+    if (dmalloc_verify(NULL /* check all heap */) != DMALLOC_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: heap check after aligned allocations failed: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    
+    dmalloc_debug_setup(old_env);
+    dmalloc_errno = errno_hold;
+  }
+  
+  /********************/
+  
+  /*
+   * Test that the usable size and in-place expansion keep the
+   * fence-posts above the space handed out.
+   */
+  {
+    int			errno_hold = dmalloc_errno;
+    int			size = 10;
+    DMALLOC_SIZE	usable, ex_size;
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    dmalloc_debug(DMALLOC_DEBUG_CHECK_FENCE | DMALLOC_DEBUG_ALLOC_BLANK
+		  | DMALLOC_DEBUG_CHECK_BLANK);
+    
+    if (! silent_b) {
+      loc_printf("  Checking usable size and in-place expansion\n");
+    }
+    
+    pnt = malloc(size);
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not malloc %d bytes.\n", size);
+      }
+      return 0;
+    }
+    
+    /* we should be able to grow a little without moving */
+    if (! dmalloc_try_expand(pnt, size + 1)) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not expand %d bytes in place.\n", size);
+      }
+      final = 0;
+    }
+    else if (dmalloc_examine(pnt, &ex_size, NULL, NULL, NULL, NULL, NULL,
+			     NULL) != DMALLOC_NOERROR
+	     || ex_size != (DMALLOC_SIZE)size + 1) {
+      if (! silent_b) {
+	loc_printf("   ERROR: expanded pointer does not have %d bytes.\n",
+		   size + 1);
+      }
+      final = 0;
+    }
+    
+    /* now claim all of the slack and write to every byte of it */
+    usable = malloc_usable_size(pnt);
+    if (usable < (DMALLOC_SIZE)size + 1) {
+      if (! silent_b) {
+	loc_printf("   ERROR: usable size %lu is less than %d.\n",
+		   (unsigned long)usable, size + 1);
+      }
+      final = 0;
+    }
+    memset(pnt, 'x', usable);
+    if (dmalloc_verify(pnt) != DMALLOC_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: writing usable size overwrote the fence: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    
+    /* there is no more room at the end of the chunk */
+    if (dmalloc_try_expand(pnt, usable + 1)) {
+      if (! silent_b) {
+	loc_printf("   ERROR: expanded past the usable size %lu.\n",
+		   (unsigned long)usable);
+      }
+      final = 0;
+    }
+    
+    /* the size it was allocated with is still good */
+    if (dmalloc_free_sized(__FILE__, __LINE__, pnt, size,
+			   DMALLOC_FUNC_DELETE) != FREE_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: sized free of expanded pointer failed: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    
+    dmalloc_debug_setup(old_env);
+    dmalloc_errno = errno_hold;
+  }
+  
+  /********************/
+  
+  /*
+   * Test the batch allocation and free calls.
+   */
+  {
+#define BATCH_N		32
+    int			errno_hold = dmalloc_errno;
+    int			size = 24, pnt_c;
+    void		*pnts[BATCH_N];
+    unsigned long	before, mark;
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    dmalloc_debug(DMALLOC_DEBUG_CHECK_FENCE | DMALLOC_DEBUG_ALLOC_BLANK
+		  | DMALLOC_DEBUG_CHECK_BLANK);
+    
+    if (! silent_b) {
+      loc_printf("  Checking batch allocation and free\n");
+    }
+    
+    before = dmalloc_memory_allocated();
+    mark = dmalloc_mark();
+    
+    if (dmalloc_malloc_batch(__FILE__, __LINE__, BATCH_N, size,
+			     pnts) != DMALLOC_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not batch allocate %d pointers.\n",
+		   BATCH_N);
+      }
+      return 0;
+    }
+    
+    for (pnt_c = 0; pnt_c < BATCH_N; pnt_c++) {
+      if (pnts[pnt_c] == NULL
+	  || (pnt_c > 0 && pnts[pnt_c] == pnts[pnt_c - 1])) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: batch pointer %d is bad: %p.\n", pnt_c,
+		     pnts[pnt_c]);
+	}
+	final = 0;
+	continue;
+      }
+      memset(pnts[pnt_c], 'x', size);
+      if (dmalloc_verify(pnts[pnt_c]) != DMALLOC_NOERROR) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: verify of batch pointer %p failed: %s (err %d)\n",
+		     pnts[pnt_c], dmalloc_strerror(dmalloc_errno),
+		     dmalloc_errno);
+	}
+	final = 0;
+      }
+    }
+    
+    if (dmalloc_memory_allocated() != before + BATCH_N * size) {
+      if (! silent_b) {
+	loc_printf("   ERROR: batch allocation did not account %d bytes.\n",
+		   BATCH_N * size);
+      }
+      final = 0;
+    }
+    
+    if (dmalloc_free_batch(__FILE__, __LINE__, BATCH_N,
+			   pnts) != FREE_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: batch free failed: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    if (dmalloc_count_changed(mark, 1 /* not-freed */,
+			      0 /* no freed */) != 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: batch free did not release all of the memory.\n");
+      }
+      final = 0;
+    }
+    
+    dmalloc_debug_setup(old_env);
+    dmalloc_errno = errno_hold;
+  }
+  
+  /********************/
+  
+  /*
+   * Test allocation regions.
+   */
+  {
+#define REGION_N	50
+    int			errno_hold = dmalloc_errno;
+    int			size = 20, pnt_c, region;
+    void		*pnts[REGION_N], *others[REGION_N];
+    unsigned long	mark;
+    char		save_ch;
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    dmalloc_debug(DMALLOC_DEBUG_CHECK_FENCE);
+    
+    if (! silent_b) {
+      loc_printf("  Checking allocation regions\n");
+    }
+    
+    mark = dmalloc_mark();
+    
+    region = dmalloc_region_create();
+    if (region == 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not create a region.\n");
+      }
+      return 0;
+    }
+    
+    /* interleave the region's pointers with regular ones */
+    for (pnt_c = 0; pnt_c < REGION_N; pnt_c++) {
+      pnts[pnt_c] = dmalloc_region_alloc(__FILE__, __LINE__, region, size);
+      others[pnt_c] = malloc(size);
+      if (pnts[pnt_c] == NULL || others[pnt_c] == NULL) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: could not allocate %d bytes.\n", size);
+	}
+	return 0;
+      }
+    }
+    
+    /* pointers can still be freed individually */
+    free(pnts[0]);
+    
+    /* overwrite the top fence of one of the pointers */
+    save_ch = *((char *)pnts[1] + size);
+    *((char *)pnts[1] + size) = save_ch + 1;
+    
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_region_destroy(__FILE__, __LINE__, region) == DMALLOC_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: destroying the region did not notice the overwrite.\n");
+      }
+      final = 0;
+    }
+    else if (dmalloc_errno != DMALLOC_ERROR_OVER_FENCE) {
+      if (! silent_b) {
+	loc_printf("   ERROR: destroying the region returned: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
       }
-      return 0;
+      final = 0;
     }
     
-    /* now disable all checking */
-    dmalloc_debug((old_flags | DMALLOC_DEBUG_CHECK_BLANK)
-		  & (~(DMALLOC_DEBUG_CHECK_FENCE
-		       | DMALLOC_DEBUG_ALLOC_BLANK | DMALLOC_DEBUG_FREE_BLANK)));
-    
-    pnt = realloc(pnt, size - 1);
-    if (pnt == NULL) {
+    /* the bad pointer is left allocated, the rest should be gone */
+    *((char *)pnts[1] + size) = save_ch;
+    if (dmalloc_count_changed(mark, 1 /* not-freed */,
+			      0 /* no freed */) != (REGION_N + 1) * size) {
       if (! silent_b) {
-	loc_printf("   ERROR: could not realloc %p to %lu bytes.\n", pnt, size - 1);
+	loc_printf("   ERROR: destroying the region freed the wrong pointers.\n");
       }
-      return 0;
+      final = 0;
     }
+    free(pnts[1]);
     
-    /* overwrite one of the top chars */
-    save_ch = *((char *)pnt + size - 1);
-    *((char *)pnt + size - 1) = '\0';
-    
-    /* we should notice the overwrite */
-    if (dmalloc_free(__FILE__, __LINE__, pnt,
+    /* an escaped pointer freed after the region is gone is caught */
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_free(__FILE__, __LINE__, pnts[2],
 		     DMALLOC_FUNC_FREE) == FREE_NOERROR) {
       if (! silent_b) {
-	loc_printf("   ERROR: per-pointer alloc flags should have failed: %s (err %d)\n",
-		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+	loc_printf("   ERROR: free of a destroyed region's pointer did not fail.\n");
       }
       final = 0;
     }
     
-    /* restore the overwrite */
-    *((char *)pnt + size - 1) = save_ch;
+    /* the region-id is no longer valid */
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_region_alloc(__FILE__, __LINE__, region, size) != NULL
+	|| dmalloc_errno != DMALLOC_ERROR_BAD_REGION) {
+      if (! silent_b) {
+	loc_printf("   ERROR: allocating in a destroyed region did not fail.\n");
+      }
+      final = 0;
+    }
+    
+    for (pnt_c = 0; pnt_c < REGION_N; pnt_c++) {
+      free(others[pnt_c]);
+    }
     
-    /* restore flags */
     dmalloc_debug_setup(old_env);
     dmalloc_errno = errno_hold;
   }
@@ -2735,14 +3319,16 @@ static	int	check_special(void)
   /********************/
   
   /*
-   * Make sure that a free of an existing pointer gets the right error.
+   * Make sure that the remembered pointer checks still catch bad sizes
+   * and freed pointers.
    */
   {
-    int		errno_hold = dmalloc_errno;
-    int		size = 10;
+    int			errno_hold = dmalloc_errno;
+    int			size = 20;
+    dmalloc_range_t	ranges[2];
     
     if (! silent_b) {
-      loc_printf("  Checking double free error\n");
+      loc_printf("  Checking repeated pointer verification\n");
     }
     
     pnt = malloc(size);
@@ -2753,28 +3339,37 @@ static	int	check_special(void)
       return 0;
     }
     
-    if (dmalloc_free(__FILE__, __LINE__, pnt,
-		     DMALLOC_FUNC_FREE) != FREE_NOERROR) {
+    /* the second check of the same pointer comes from the cache */
+    if (dmalloc_verify_pnt(__FILE__, __LINE__, "cache", (char *)pnt + 4,
+			   0 /* not exact */, size - 4) != MALLOC_VERIFY_NOERROR
+	|| dmalloc_verify_pnt(__FILE__, __LINE__, "cache", pnt,
+			      1 /* exact */, size) != MALLOC_VERIFY_NOERROR) {
       if (! silent_b) {
-	loc_printf("   ERROR: 1st of double free should not fail: %s (err %d)\n",
-		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+	loc_printf("   ERROR: verifying a good pointer failed.\n");
       }
       final = 0;
     }
     
+    ranges[0].vr_pnt = pnt;
+    ranges[0].vr_min_size = size;
+    ranges[1].vr_pnt = (char *)pnt + 4;
+    ranges[1].vr_min_size = size;
     dmalloc_errno = DMALLOC_ERROR_NONE;
-    if (dmalloc_free(__FILE__, __LINE__, pnt,
-		     DMALLOC_FUNC_FREE) == FREE_NOERROR) {
+    if (dmalloc_verify_ranges(__FILE__, __LINE__, "cache", 0 /* not exact */,
+			      ranges, 2) != MALLOC_VERIFY_ERROR) {
       if (! silent_b) {
-	loc_printf("   ERROR: 2nd of double free should have failed: %s (err %d)\n",
-		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+	loc_printf("   ERROR: verifying a range past the end did not fail.\n");
       }
       final = 0;
     }
-    else if (dmalloc_errno != DMALLOC_ERROR_ALREADY_FREE) {
+    
+    free(pnt);
+    
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_verify_pnt(__FILE__, __LINE__, "cache", pnt,
+			   1 /* exact */, size) != MALLOC_VERIFY_ERROR) {
       if (! silent_b) {
-	loc_printf("   ERROR: 2nd of double free should get DMALLOC_ERROR_ALREADY_FREE not: %s (err %d)\n",
-		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+	loc_printf("   ERROR: verifying a freed pointer did not fail.\n");
       }
       final = 0;
     }
@@ -2785,15 +3380,57 @@ static	int	check_special(void)
   /********************/
   
   /*
-   * Coverage tests
+   * Allocations without a file or return-address all go to one entry
+   * in the memory table so the table must not keep growing.
    */
-#if FREED_POINTER_DELAY > 0
   {
-    int		errno_hold = dmalloc_errno;
-    int		size = 10, pnt_c;
+    unsigned long	start_space, end_space;
+    int			iter_c;
     
     if (! silent_b) {
-      loc_printf("  Checking freed pointer delay\n");
+      loc_printf("  Checking allocations without a file\n");
+    }
+    
+    dmalloc_get_stats(NULL, NULL, &start_space, NULL, NULL, NULL, NULL, NULL,
+		      NULL);
+    for (iter_c = 0; iter_c < 20000; iter_c++) {
+      pnt = dmalloc_malloc(NULL, 0, 16, DMALLOC_FUNC_MALLOC,
+			   0 /* no alignment */, 0 /* no xalloc messages */);
+      if (pnt == NULL) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: could not malloc 16 bytes.\n");
+	}
+	final = 0;
+	break;
+      }
+      (void)dmalloc_free(NULL, 0, pnt, DMALLOC_FUNC_FREE);
+    }
+    dmalloc_get_stats(NULL, NULL, &end_space, NULL, NULL, NULL, NULL, NULL,
+		      NULL);
+    
+    /* the table used to double every time it got half full */
+    if (end_space - start_space > 64 * BLOCK_SIZE) {
+      if (! silent_b) {
+	loc_printf("   ERROR: heap grew by %lu bytes for allocations "
+		   "without a file.\n", end_space - start_space);
+      }
+      final = 0;
+    }
+  }
+  
+  /********************/
+  
+  /*
+   * Make sure that the string checks hand back the length they found.
+   */
+  {
+    int			errno_hold = dmalloc_errno;
+    int			size = 20;
+    char		stack_str[] = "stack";
+    dmalloc_range_t	ranges[2];
+    
+    if (! silent_b) {
+      loc_printf("  Checking string lengths from the pointer checks\n");
     }
     
     pnt = malloc(size);
@@ -2803,47 +3440,56 @@ static	int	check_special(void)
       }
       return 0;
     }
-    for (pnt_c = 0; pnt_c < FREED_POINTER_DELAY; pnt_c++) {
-      void	*pnt2 = malloc(size);
-      if (pnt2 == NULL) {
-	if (! silent_b) {
-	  loc_printf("   ERROR: could not malloc %d bytes.\n", size);
-	}
-	return 0;
+    memset(pnt, 'x', size);
+    ((char *)pnt)[size - 1] = '\0';
+    
+    ranges[0].vr_pnt = (char *)pnt + 3;
+    ranges[0].vr_min_size = -1;
+    ranges[1].vr_pnt = stack_str;
+    ranges[1].vr_min_size = -1;
+    if (dmalloc_verify_ranges(__FILE__, __LINE__, "strlen", 0 /* not exact */,
+			      ranges, 2) != MALLOC_VERIFY_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: verifying good strings failed.\n");
       }
-      free(pnt2);
+      final = 0;
     }
-    
-    /* now double free the first one */
-    dmalloc_errno = DMALLOC_ERROR_NONE;
-    if (dmalloc_free(__FILE__, __LINE__, pnt,
-		     DMALLOC_FUNC_FREE) != FREE_NOERROR) {
+    else if (ranges[0].vr_strlen != size - 4 || ranges[1].vr_strlen != -1) {
       if (! silent_b) {
-	loc_printf("   ERROR: 1st of double free should not fail: %s (err %d)\n",
-		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+	loc_printf("   ERROR: string lengths %d and %d should be %d and -1.\n",
+		   ranges[0].vr_strlen, ranges[1].vr_strlen, size - 4);
       }
       final = 0;
     }
     
-    if (dmalloc_free(__FILE__, __LINE__, pnt,
-		     DMALLOC_FUNC_FREE) == FREE_NOERROR) {
+    /* without the \0 the string runs off the end of the allocation */
+    ((char *)pnt)[size - 1] = 'x';
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_verify_ranges(__FILE__, __LINE__, "strlen", 0 /* not exact */,
+			      ranges, 1) != MALLOC_VERIFY_ERROR) {
       if (! silent_b) {
-	loc_printf("   ERROR: 2nd of double free should have failed: %s (err %d)\n",
-		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+	loc_printf("   ERROR: verifying an unterminated string did not fail.\n");
       }
       final = 0;
     }
-    else if (dmalloc_errno != DMALLOC_ERROR_ALREADY_FREE) {
+    
+    /* a pointer past the end of the allocation can't hold a string */
+    ((char *)pnt)[size - 1] = '\0';
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_verify_pnt(__FILE__, __LINE__, "strlen", (char *)pnt + size + 1,
+			   0 /* not exact */, -1 /* strlen */)
+	!= MALLOC_VERIFY_ERROR
+	|| dmalloc_errno != DMALLOC_ERROR_WOULD_OVERWRITE) {
       if (! silent_b) {
-	loc_printf("   ERROR: 2nd of double free should get DMALLOC_ERROR_ALREADY_FREE not: %s (err %d)\n",
-		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+	loc_printf("   ERROR: verifying a string past the allocation did not "
+		   "fail.\n");
       }
       final = 0;
     }
     
+    free(pnt);
     dmalloc_errno = errno_hold;
   }
-#endif
   
   /********************/
   
@@ -2859,7 +3505,7 @@ static	int	check_special(void)
     unsigned int	old_flags = dmalloc_debug_current();
   
     old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
-
+  
     if (! silent_b) {
       loc_printf("  Checking strndup\n");
     }
@@ -2894,7 +3540,7 @@ static	int	check_special(void)
       final = 0;
     }
     free(ret);
-
+  
     /* test size greater than strlen */
     dmalloc_errno = DMALLOC_ERROR_NONE;
     ret = strndup(pnt, size + 1);
@@ -2913,7 +3559,7 @@ static	int	check_special(void)
       final = 0;
     }
     free(ret);
-
+  
     /* test not \0 terminated */
     str = "12345";
     memset(pnt, 1, size);
@@ -3547,9 +4193,175 @@ static	int	check_special(void)
       return 0;
     }
   }
+  
+  /********************/
+  
+  /*
+   * Verify the live statistics page published by export-stats.
+   */
+#if HAVE_MMAP && HAVE_GETPID
+  {
+    const stats_page_t	*page_p;
+    stats_page_t	stats;
+    unsigned int	old_flags = dmalloc_debug_current();
+    
+    if (! silent_b) {
+      loc_printf("  Checking the export-stats page\n");
+    }
+    
+    dmalloc_debug(old_flags | DMALLOC_DEBUG_EXPORT_STATS);
+    
+    pnt = malloc(10);
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not malloc 10 bytes.\n");
+      }
+      return 0;
+    }
+    
+    page_p = _dmalloc_stats_attach(getpid());
+    if (page_p == NULL) {
+      /* the page directory may not exist on this system */
+      if (! silent_b) {
+	loc_printf("   NOTE: could not attach to the stats page, skipping.\n");
+      }
+    }
+    else if ((! _dmalloc_stats_read(page_p, &stats))
+	     || stats.sp_pid != (unsigned long)getpid()
+	     || stats.sp_alloc_cur_pnts == 0
+	     || stats.sp_func_malloc_c == 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: stats page does not match the heap.\n");
+      }
+      return 0;
+    }
+    
+    free(pnt);
+    dmalloc_debug(old_flags);
+  }
+#endif
+  
+  /********************/
+  
+  /*
+   * Verify that dmalloc_write_snapshot records our pointers.
+   */
+  {
+    FILE		*infile;
+    snap_header_t	header;
+    snap_record_t	record;
+    char		file[SNAPSHOT_MAX_FILE];
+    int			found_b = 0;
+    
+    if (! silent_b) {
+      loc_printf("  Checking dmalloc_write_snapshot function\n");
+    }
+    
+    pnt = malloc(SNAPSHOT_MAX_FILE);
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not malloc %d bytes.\n", SNAPSHOT_MAX_FILE);
+      }
+      return 0;
+    }
+    
+    if (dmalloc_write_snapshot("dmalloc_t.snap") != DMALLOC_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not write snapshot.\n");
+      }
+      return 0;
+    }
+    
+    infile = fopen("dmalloc_t.snap", "rb");
+    if (infile == NULL
+	|| fread(&header, sizeof(header), 1, infile) != 1
+	|| header.sh_magic != SNAPSHOT_MAGIC) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not read snapshot header.\n");
+      }
+      return 0;
+    }
+    while (fread(&record, sizeof(record), 1, infile) == 1) {
+      if (record.sr_file_len > 0) {
+	(void)fread(file, record.sr_file_len, 1, infile);
+      }
+      if (record.sr_addr == (PNT_ARITH_TYPE)pnt
+	  && record.sr_user_size == SNAPSHOT_MAX_FILE) {
+	found_b = 1;
+      }
+    }
+    (void)fclose(infile);
+    (void)unlink("dmalloc_t.snap");
+    
+    if (! found_b) {
+      if (! silent_b) {
+	loc_printf("   ERROR: pointer was not found in the snapshot.\n");
+      }
+      return 0;
+    }
+    
+    free(pnt);
+  }
  
   /********************/
   
+#if LOG_PNT_STACK_DEPTH
+  /*
+   * Verify that call stacks are recorded and stored only once.
+   */
+  {
+    const stack_entry_t	*stacks[2];
+    unsigned long	admin_c = 0;
+    unsigned int	old_flags = dmalloc_debug_current();
+    int			stack_c;
+    
+    if (! silent_b) {
+      loc_printf("  Checking the log-stack token\n");
+    }
+    
+    dmalloc_debug(old_flags | DMALLOC_DEBUG_LOG_STACK);
+    
+    pnt = malloc(10);
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not malloc 10 bytes.\n");
+      }
+      return 0;
+    }
+    pnt = realloc(pnt, 20);
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not realloc to 20 bytes.\n");
+      }
+      return 0;
+    }
+    dmalloc_log_stats();
+    free(pnt);
+    
+    /*
+     * The same call stack should give us the same entry.  Without frame
+     * pointers the stacks may be cut off differently so we only
+     * compare them if the addresses match.
+     */
+    for (stack_c = 0; stack_c < 2; stack_c++) {
+      stacks[stack_c] = _dmalloc_stack_get(&admin_c);
+    }
+    if (stacks[0] != NULL && stacks[1] != NULL && stacks[0] != stacks[1]
+	&& stacks[0]->se_depth == stacks[1]->se_depth
+	&& memcmp(stacks[0]->se_addrs, stacks[1]->se_addrs,
+		  sizeof(void *) * stacks[0]->se_depth) == 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: the same stack was stored twice.\n");
+      }
+      return 0;
+    }
+    
+    dmalloc_debug(old_flags);
+  }
+#endif
+  
+  /********************/
+  
   /*
    * Check block rounding by allocator.
    */
@@ -3761,6 +4573,13 @@ static	int	check_special(void)
     final = check_append_buf(buf, buf_p, "-87654", 6, final, "append neg int");
     buf_p = append_null(buf_p, max);
     final = check_append_buf(buf, buf_p, "-87654", 7, final, "append neg int null");
+    
+    /* check the other bases */
+    buf_p = buf;
+    buf_p = append_ulong(buf_p, max, 0xbeef, 16);
+    buf_p = append_long(buf_p, max, 8, 8);
+    buf_p = append_long(buf_p, max, 5, 2);
+    final = check_append_buf(buf, buf_p, "beef10101", 9, final, "append bases");
   }
   
   /********************/
@@ -3854,6 +4673,18 @@ static	int	check_special(void)
     buf_p = append_format(buf, max, "%lx", 1012);
     final = check_append_buf(buf, buf_p, "3f4", 3, final, "%lx");
     
+    buf_p = append_format(buf, max, "%ld", -1234567L);
+    final = check_append_buf(buf, buf_p, "-1234567", 8, final, "%ld neg");
+    
+    buf_p = append_format(buf, max, "%lu", 9876543210UL);
+    final = check_append_buf(buf, buf_p, "9876543210", 10, final, "%lu big");
+    
+    buf_p = append_format(buf, max, "%p", (void *)0xabc123);
+    final = check_append_buf(buf, buf_p, "0xabc123", 8, final, "%p");
+    
+    buf_p = append_format(buf, max, "%.*s:%u", 4, "file.c", 100);
+    final = check_append_buf(buf, buf_p, "file:100", 8, final, "%.*s:%u");
+    
     buf_p = append_format(buf, max, "Hi %s=%d%c", "jim", 10, '!');
     final = check_append_buf(buf, buf_p, "Hi jim=10!", 10, final, "Hi %s=%d%c");
     
@@ -3878,26 +4709,45 @@ static	int	check_special(void)
   {
     char buf[30];
     int len;
-
+  
     len = loc_snprintf(buf, sizeof(buf), "Hi %s=%d%c", "jim", 10, '!');
     final = check_append_buf(buf, buf + len, "Hi jim=10!", 10, final, "Hi %s=%d%c");
-
+  
     len = loc_snprintf(buf, sizeof(buf), "Zip '%-04x' %5.2f = %#o", 10, 3.81, 20);
     final = check_append_buf(buf, buf + len, "Zip 'a   '  3.81 = 024", 22, final,
 			     "Hi %s=%d%c");
   }
-
+  
   /********************/
-
+  
   {
     char buf[60];
     int len;
-
+  
     len = loc_snprintf(buf, sizeof(buf),     "number %#x, string %s, number %d", 0x400, "X", 10);
     final = check_append_buf(buf, buf + len, "number 0x400, string X, number 10", 33, final,
 			     "number string number");
   }
-
+  
+  /********************/
+  
+  {
+    char buf[30];
+    char *max = buf + sizeof(buf);
+    char *buf_p;
+    
+    buf_p = append_json_string(buf, max, "a\"b\\c\n\t\001");
+    final = check_append_buf(buf, buf_p, "\"a\\\"b\\\\c\\n\\t\\u0001\"", 19,
+			     final, "json escapes");
+    
+    buf_p = append_json_string(buf, max, NULL);
+    final = check_append_buf(buf, buf_p, "null", 4, final, "json null");
+    
+    /* a string that doesn't fit is still closed with a quote */
+    buf_p = append_json_string(buf, buf + 8, "abc\001def");
+    final = check_append_buf(buf, buf_p, "\"abc\"", 5, final, "json cut");
+  }
+  
   /********************/
   
   /*
@@ -4239,6 +5089,52 @@ static	void	track_alloc_trxn(const char *file, const unsigned int line,
   }
 }
 
+/*
+ * Time the formatting of a typical transaction log line with the
+ * library's append_format and with the system's snprintf.
+ */
+static	void	do_format_bench(const long iter_n)
+{
+  char		line[256], where[128], disp[64];
+  char		*line_p, *bounds_p = line + sizeof(line);
+  const void	*pnt = &iter_n;
+  long		iter_c;
+  clock_t	start;
+  double	append_secs, snprintf_secs;
+  
+  start = clock();
+  for (iter_c = 0; iter_c < iter_n; iter_c++) {
+    (void)loc_snprintf(where, sizeof(where), "%.*s:%u", 100, __FILE__,
+		       (unsigned int)iter_c);
+    (void)loc_snprintf(disp, sizeof(disp), "%p|s%lu", pnt,
+		       (unsigned long)iter_c);
+    line_p = append_format(line, bounds_p,
+			   "%ld: %lu: *** alloc: at '%s' for %ld bytes, got '%s'",
+			   (long)start, (unsigned long)iter_c, where,
+			   (long)iter_c % 4096, disp);
+    append_null(line_p, bounds_p);
+  }
+  append_secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+  
+  start = clock();
+  for (iter_c = 0; iter_c < iter_n; iter_c++) {
+    (void)snprintf(where, sizeof(where), "%.*s:%u", 100, __FILE__,
+		   (unsigned int)iter_c);
+    (void)snprintf(disp, sizeof(disp), "%p|s%lu", pnt, (unsigned long)iter_c);
+    (void)snprintf(line, sizeof(line),
+		   "%ld: %lu: *** alloc: at '%s' for %ld bytes, got '%s'",
+		   (long)start, (unsigned long)iter_c, where,
+		   (long)iter_c % 4096, disp);
+  }
+  snprintf_secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+  
+  loc_printf("Formatted %ld log lines:\n", iter_n);
+  loc_printf("  append_format: %.3f secs, %ld ns per line\n", append_secs,
+	     (long)(append_secs * 1000000000.0 / iter_n));
+  loc_printf("  snprintf:      %.3f secs, %ld ns per line\n", snprintf_secs,
+	     (long)(snprintf_secs * 1000000000.0 / iter_n));
+}
+
 int	main(int argc, char **argv)
 {
   unsigned int	store_flags;
@@ -4246,6 +5142,11 @@ int	main(int argc, char **argv)
   
   argv_process(arg_list, argc, argv);
   
+  if (format_bench_n > 0) {
+    do_format_bench(format_bench_n);
+    exit(0);
+  }
+  
   if (silent_b && (verbose_b || interactive_b)) {
     silent_b = ARGV_FALSE;
   }
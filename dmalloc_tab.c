@@ -26,9 +26,6 @@
  * Inspired by code from PSM.  Thanks much.
  */
 
-#if HAVE_STDLIB_H
-# include <stdlib.h>				/* for qsort */
-#endif
 #if HAVE_STRING_H
 # include <string.h>
 #endif
@@ -39,6 +36,10 @@
 #include "compat.h"
 #include "dmalloc.h"
 #include "dmalloc_loc.h"
+#include "debug_tok.h"
+#include "error.h"
+#include "heap.h"
+#include "stack.h"
 
 #include "dmalloc_tab.h"
 #include "dmalloc_tab_loc.h"
@@ -142,314 +143,175 @@ static	unsigned int	hash(const unsigned char *key,
 /*
  * static unsigned int which_bucket
  *
- * Determine the bucket with our file/line and hash function.
+ * Determine the bucket with our file/line and hash function.  Entries
+ * are matched on the file pointer and not the string so we hash the
+ * pointer which saves us walking the file name on every transaction.
  *
  * Returns a bucket number.
  *
  * ARGUMENTS:
  *
- * entry_n -> Number of entries in the memory table.
+ * entry_n -> Number of entries in the memory table.  Must be a power
+ * of 2.
  *
  * file -> File name or return address of the allocation. 
  *
  * line -> Line number of the allocation.
+ *
+ * stack_p -> Recorded call stack of the allocation or NULL if none.
  */
 static	unsigned int	which_bucket(const int entry_n, const char *file,
-				     const unsigned int line)
+				     const unsigned int line,
+				     const stack_entry_t *stack_p)
 {
   unsigned int	bucket;
   
-  if (line == 0) {
-    if (file == NULL) {
-      bucket = 0;
-    }
-    else {
-      /* we hash on the address in file -- should be a return-address */
-      bucket = hash((unsigned char *)&file, sizeof(char *), 0);
-    }
-  }
-  else {
-    bucket = hash((unsigned char *)file, strlen(file), 0);
-    bucket = hash((unsigned char *)&line, sizeof(line), bucket);
+  bucket = hash((unsigned char *)&file, sizeof(char *), 0);
+  bucket = hash((unsigned char *)&line, sizeof(line), bucket);
+  if (stack_p != NULL) {
+    bucket = hash((unsigned char *)&stack_p, sizeof(stack_p), bucket);
   }
   
-  bucket %= entry_n;
-  return bucket;
+  return bucket & (entry_n - 1);
 }
 
 /*
- * static int entry_cmp
+ * static unsigned long entry_key
  *
- * Compare two entries in the memory table for quicksort.
+ * Get the value that we order the entries by.
  *
- * Returns -1, 0, or 1 depending if entry1_p is less-than, equal, or
- * greater-than entry2_p.
+ * Returns the value of the entry.
  *
  * ARGUMENTS:
  *
- * entry1_p -> Pointer to the 1st entry.
+ * entry_p -> Pointer to the entry.
  *
- * entry2_p -> Pointer to the 2nd entry.
+ * order -> Which MEM_TABLE_ORDER_ value we are ordering by.
  */
-static	int	entry_cmp(const void *entry1_p, const void *entry2_p)
+static	unsigned long	entry_key(const mem_entry_t *entry_p, const int order)
 {
-  unsigned long		size1, size2;
-  const mem_entry_t	*tab1_p = entry1_p, *tab2_p = entry2_p;
-  
-  /* if the entry is blank then force the size to be 0 */
-  if (tab1_p->me_file == NULL) {
-    size1 = 0;
-  }
-  else {
-    size1 = tab1_p->me_total_size;
-  }
-  
-  /* if the entry is blank then force the size to be 0 */
-  if (tab2_p->me_file == NULL) {
-    size2 = 0;
-  }
-  else {
-    size2 = tab2_p->me_total_size;
-  }
-  
-  /* NOTE: we want the top entries to be ahead so we reverse the sort */
-  if (size1 > size2) {
-    return -1;
-  }
-  else if (size1 == size2) {
-    return 0;
-  }
-  else {
-    return 1;
+  switch (order) {
+  case MEM_TABLE_ORDER_IN_USE_SIZE:
+    return entry_p->me_in_use_size;
+  case MEM_TABLE_ORDER_COUNT:
+    return entry_p->me_total_c;
+  case MEM_TABLE_ORDER_TOTAL_SIZE:
+  default:
+    return entry_p->me_total_size;
   }
 }
 
 /*
- * static void swap_bytes
+ * static void heap_up
  *
- * Swap the values between two items of a specified size.
+ * Move an entry up a min-heap of entries until its parent is smaller.
  *
  * ARGUMENTS:
  *
- * item1_p -> Pointer to the first item.
+ * heap -> Array of entry pointers making up the heap.
  *
- * item2_p -> Pointer to the first item.
+ * pos -> Position of the entry we are moving.
  *
- * ele_size -> Size of the two items.
+ * order -> Which MEM_TABLE_ORDER_ value we are ordering by.
  */
-static	void	swap_bytes(unsigned char *item1_p, unsigned char *item2_p,
-			   int ele_size)
+static	void	heap_up(mem_entry_t **heap, int pos, const int order)
 {
-  unsigned char	char_temp;
+  mem_entry_t	*entry_p = heap[pos];
+  unsigned long	key = entry_key(entry_p, order);
+  int		parent;
   
-  for (; ele_size > 0; ele_size--) {
-    char_temp = *item1_p;
-    *item1_p = *item2_p;
-    *item2_p = char_temp;
-    item1_p++;
-    item2_p++;
+  while (pos > 0) {
+    parent = (pos - 1) / 2;
+    if (entry_key(heap[parent], order) <= key) {
+      break;
+    }
+    heap[pos] = heap[parent];
+    pos = parent;
   }
+  heap[pos] = entry_p;
 }
 
 /*
- * static void insert_sort
+ * static void heap_down
  *
- * Do an insertion sort which is faster for small numbers of items and
- * better if the items are already sorted.
+ * Move an entry down a min-heap of entries until its children are
+ * larger.
  *
  * ARGUMENTS:
  *
- * first_p <-> Start of the list that we are splitting.
+ * heap -> Array of entry pointers making up the heap.
  *
- * last_p <-> Last entry in the list that we are splitting.
+ * heap_n -> Number of entries in the heap.
  *
- * holder_p <-> Location of hold area we can store an entry.
+ * pos -> Position of the entry we are moving.
  *
- * ele_size -> Size of the each element in the list.
+ * order -> Which MEM_TABLE_ORDER_ value we are ordering by.
  */
-static	void	insert_sort(unsigned char *first_p, unsigned char *last_p,
-			    unsigned char *holder_p,
-			    const unsigned int ele_size)
+static	void	heap_down(mem_entry_t **heap, const int heap_n, int pos,
+			  const int order)
 {
-  unsigned char	*inner_p, *outer_p;
+  mem_entry_t	*entry_p = heap[pos];
+  unsigned long	key = entry_key(entry_p, order);
+  int		child;
   
-  for (outer_p = first_p + ele_size; outer_p <= last_p; ) {
-    
-    /* look for the place to insert the entry */
-    for (inner_p = outer_p - ele_size;
-	 inner_p >= first_p && entry_cmp(outer_p, inner_p) < 0;
-	 inner_p -= ele_size) {
+  while (1) {
+    child = pos * 2 + 1;
+    if (child >= heap_n) {
+      break;
     }
-    inner_p += ele_size;
-    
-    /* do we need to insert the entry in? */
-    if (outer_p != inner_p) {
-      /*
-       * Now we shift the entry down into its place in the already
-       * sorted list.
-       */
-      memcpy(holder_p, outer_p, ele_size);
-      memmove(inner_p + ele_size, inner_p, outer_p - inner_p);
-      memcpy(inner_p, holder_p, ele_size);
+    if (child + 1 < heap_n
+	&& entry_key(heap[child + 1], order) < entry_key(heap[child], order)) {
+      child++;
     }
-    
-    outer_p += ele_size;
+    if (entry_key(heap[child], order) >= key) {
+      break;
+    }
+    heap[pos] = heap[child];
+    pos = child;
   }
+  heap[pos] = entry_p;
 }
 
 /*
- * static void split
+ * static mem_entry_t **top_array
  *
- * This sorts an array of longs via the quick sort algorithm (it's pretty quick)
+ * Get the array of entry pointers that we use to select the top
+ * entries.  It is allocated from the heap and kept with the table so
+ * we don't allocate it again each time we log.
  *
- * ARGUMENTS:
+ * Returns the array or NULL on error.
  *
- * first_p -> Start of the list that we are splitting.
+ * ARGUMENTS:
  *
- * last_p -> Last entry in the list that we are splitting.
+ * mem_table -> Memory table we are working on.
  *
- * ele_size -> Size of the each element in the list.
+ * top_n -> Number of pointers we need in the array.
  */
-static	void	split(unsigned char *first_p, unsigned char *last_p,
-		      const unsigned int ele_size)
+static	mem_entry_t	**top_array(mem_table_t *mem_table, const int top_n)
 {
-  unsigned char	*left_p, *right_p, *pivot_p, *left_last_p, *right_first_p;
-  unsigned char	*firsts[MAX_QSORT_SPLITS], *lasts[MAX_QSORT_SPLITS];
-  mem_table_t	pivot;
-  unsigned int	width, split_c = 0, min_qsort_size, size1, size2;
+  mem_entry_t	**top_pp;
+  unsigned int	size;
   
-  min_qsort_size = MAX_QSORT_PARTITION * ele_size;
+  if (top_n <= mem_table->mt_top_n) {
+    return mem_table->mt_top_pp;
+  }
   
-  while (1) {
-    
-    /* find the left, right, and mid point */
-    left_p = first_p;
-    right_p = last_p;
-    /* is there a faster way to find this? */
-    width = (last_p - first_p) / ele_size;
-    pivot_p = first_p + ele_size * (width >> 1);
-    
-    /*
-     * Find which of the left, middle, and right elements is the
-     * median (Knuth vol3 p123).
-     */
-    if (entry_cmp(first_p, pivot_p) > 0) {
-      swap_bytes(first_p, pivot_p, ele_size);
-    }
-    if (entry_cmp(pivot_p, last_p) > 0) {
-      swap_bytes(pivot_p, last_p, ele_size);
-      if (entry_cmp(first_p, pivot_p) > 0) {
-	swap_bytes(first_p, pivot_p, ele_size);
-      }
-    }
-    
-    /*
-     * save our pivot so we don't have to worry about hitting and
-     * swapping it elsewhere while we iterate across the list below.
-     */
-    memcpy(&pivot, pivot_p, ele_size);
-    
-    do {
-      
-      /* shift the left side up until we reach the pivot value */
-      while (entry_cmp(left_p, &pivot) < 0) {
-	left_p += ele_size;
-      }
-      /* shift the right side down until we reach the pivot value */
-      while (entry_cmp(&pivot, right_p) < 0) {
-	right_p -= ele_size;
-      }
-      
-      /* if we met in the middle then we are done */
-      if (left_p == right_p) {
-	left_p += ele_size;
-	right_p -= ele_size;
-	break;
-      }
-      else if (left_p < right_p) {
-	/*
-	 * swap the left and right since they both were on the wrong
-	 * size of the pivot and continue
-	 */
-	swap_bytes(left_p, right_p, ele_size);
-	left_p += ele_size;
-	right_p -= ele_size;
-      }
-    } while (left_p <= right_p);
-    
-    /* Rename variables to make more sense.  This will get optimized out. */
-    right_first_p = left_p;
-    left_last_p = right_p;
-    
-    /* determine the size of the left and right hand parts */
-    size1 = left_last_p - first_p;
-    size2 = last_p - right_first_p;
-    
-    /* is the 1st half small enough to just insert-sort? */
-    if (size1 < min_qsort_size) {
-      
-      /* use the pivot as our temporary space */
-      insert_sort(first_p, left_last_p, (unsigned char *)&pivot, ele_size);
-      
-      /* is the 2nd part small as well? */
-      if (size2 < min_qsort_size) {
-	
-	/* use the pivot as our temporary space */
-	insert_sort(right_first_p, last_p, (unsigned char *)&pivot, ele_size);
-	
-	/* pop a partition off our stack */
-	if (split_c == 0) {
-	  /* we are done */
-	  return;
-	}
-	split_c--;
-	first_p = firsts[split_c];
-	last_p = lasts[split_c];
-      }
-      else {
-	/* we can just handle the right side immediately */
-	first_p = right_first_p;
-	/* last_p = last_p */
-      }
-    }
-    else if (size2 < min_qsort_size) {
-      
-      /* use the pivot as our temporary space */
-      insert_sort(right_first_p, last_p, (unsigned char *)&pivot, ele_size);
-      
-      /* we can just handle the left side immediately */
-      /* first_p = first_p */
-      last_p = left_last_p;
-    }
-    else {
-      /*
-       * neither partition is small, we'll have to push the larger one
-       * of them on the stack
-       */
-      if (split_c >= MAX_QSORT_SPLITS) {
-	/* sanity check here -- we should never get here */
-	abort();
-      }
-      if (size1 > size2) {
-	/* push the left partition on the stack */
-	firsts[split_c] = first_p;
-	lasts[split_c] = left_last_p;
-	split_c++;
-	/* continue handling the right side */
-	first_p = right_first_p;
-	/* last_p = last_p */
-      }
-      else {
-	/* push the right partition on the stack */
-	firsts[split_c] = right_first_p;
-	lasts[split_c] = last_p;
-	split_c++;
-	/* continue handling the left side */
-	/* first_p = first_p */
-	last_p = left_last_p;
-      }
-    }
+  /* round up to the next block */
+  size = sizeof(*top_pp) * top_n;
+  size = ((size + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_SIZE;
+  
+  top_pp = _dmalloc_heap_alloc(size);
+  if (top_pp == HEAP_ALLOC_ERROR) {
+    /* error code set in _dmalloc_heap_alloc */
+    return NULL;
   }
+  if (mem_table->mt_admin_cp != NULL) {
+    *mem_table->mt_admin_cp += size / BLOCK_SIZE;
+  }
+  
+  mem_table->mt_top_pp = top_pp;
+  mem_table->mt_top_n = size / sizeof(*top_pp);
+  return top_pp;
 }
 
 /*
@@ -479,6 +341,43 @@ static	void	log_entry(const mem_entry_t *entry_p,
   }
 }
 
+/*
+ * static void log_entry_json
+ *
+ * Log the information from the memory slot to the logfile as a JSON
+ * record.
+ *
+ * ARGUMENTS:
+ *
+ * entry_p -> Pointer to the memory table entry we are dumping.
+ *
+ * in_use_column_b -> Add the in-use numbers.
+ *
+ * kind -> Kind of entry: "entry", "other", or "total".
+ */
+static	void	log_entry_json(const mem_entry_t *entry_p,
+			       const int in_use_column_b, const char *kind)
+{
+  char	stack[STACK_DESC_SIZE];
+  
+  if (! _dmalloc_json_begin("table")) {
+    return;
+  }
+  _dmalloc_json_string("kind", kind);
+  _dmalloc_json_where("", entry_p->me_file, entry_p->me_line);
+  if (entry_p->me_stack_p != NULL) {
+    (void)_dmalloc_stack_desc(stack, sizeof(stack), entry_p->me_stack_p);
+    _dmalloc_json_string("stack", stack);
+  }
+  _dmalloc_json_ulong("total_size", entry_p->me_total_size);
+  _dmalloc_json_ulong("total_count", entry_p->me_total_c);
+  if (in_use_column_b) {
+    _dmalloc_json_ulong("in_use_size", entry_p->me_in_use_size);
+    _dmalloc_json_ulong("in_use_count", entry_p->me_in_use_c);
+  }
+  _dmalloc_json_end();
+}
+
 /*
  * static void add_entry
  *
@@ -503,26 +402,152 @@ static	void	add_entry(mem_entry_t *total_p, const mem_entry_t *entry_p)
  * void _dmalloc_table_init
  *
  * Clear out the allocation information in our table.  We are going to
- * be loading it with other info.
+ * be loading it with other info.  If the table already has entries
+ * allocated then they are cleared and reused.
  *
  * ARGUMENTS:
  *
  * mem_table -> Memory table we are working on.
  *
- * mem_entries -> Entries to associate with the table.
+ * entry_n -> Number of entries to allocate when the first entry is
+ * inserted.  It is rounded up to a power of 2.
  *
- * entry_n -> Number of entries in the mem_entries array.
+ * admin_cp -> Pointer to the counter of admin blocks which is
+ * increased as we allocate entries from the heap.
  */
-void	_dmalloc_table_init(mem_table_t *mem_table, mem_entry_t *mem_entries,
-			    const int entry_n)
+void	_dmalloc_table_init(mem_table_t *mem_table, const int entry_n,
+			    unsigned long *admin_cp)
 {
+  mem_entry_t	*entries, **top_pp;
+  int		initial_n, alloc_n, top_n;
+  
+  /* hang on to any entries that we have already allocated */
+  entries = mem_table->mt_entries;
+  alloc_n = mem_table->mt_entry_n;
+  top_pp = mem_table->mt_top_pp;
+  top_n = mem_table->mt_top_n;
+  
   /* clear out our memory table */
   memset(mem_table, 0, sizeof(*mem_table));
-  memset(mem_entries, 0, sizeof(*mem_entries) * entry_n);
+  mem_table->mt_top_pp = top_pp;
+  mem_table->mt_top_n = top_n;
+  
+  for (initial_n = MEM_TABLE_MIN_ENTRIES; initial_n < entry_n; initial_n *= 2) {
+  }
+  mem_table->mt_initial_n = initial_n;
+  mem_table->mt_admin_cp = admin_cp;
   
-  mem_table->mt_entries = mem_entries;
-  mem_table->mt_entry_n = entry_n;
-  mem_table->mt_bounds_p = mem_entries + mem_table->mt_entry_n;
+  if (entries != NULL) {
+    memset(entries, 0, sizeof(*entries) * alloc_n);
+    mem_table->mt_entries = entries;
+    mem_table->mt_entry_n = alloc_n;
+    mem_table->mt_bounds_p = entries + alloc_n;
+  }
+}
+
+/*
+ * static mem_entry_t *find_slot
+ *
+ * Find the entry for a file/line in an array of entries or the blank
+ * entry where it should go.  The array must have at least one blank
+ * entry.
+ *
+ * ARGUMENTS:
+ *
+ * entries -> Array of entries that we are searching.
+ *
+ * entry_n -> Number of entries in the array.  Must be a power of 2.
+ *
+ * file -> File name or return address of the allocation.
+ *
+ * line -> Line number of the allocation.
+ *
+ * stack_p -> Recorded call stack of the allocation or NULL if none.
+ */
+static	mem_entry_t	*find_slot(mem_entry_t *entries, const int entry_n,
+				   const char *file, const unsigned int line,
+				   const stack_entry_t *stack_p)
+{
+  unsigned int	bucket;
+  mem_entry_t	*entry_p;
+  
+  bucket = which_bucket(entry_n, file, line, stack_p);
+  
+  while (1) {
+    entry_p = entries + bucket;
+    /* the file can be NULL so we can't use it to mark a blank entry */
+    if ((! entry_p->me_used_b)
+	|| (entry_p->me_file == file && entry_p->me_line == line
+	    && entry_p->me_stack_p == stack_p)) {
+      return entry_p;
+    }
+    bucket = (bucket + 1) & (entry_n - 1);
+  }
+}
+
+/*
+ * static int table_grow
+ *
+ * Allocate a new array of entries from the heap that is twice the
+ * size of the current one and move the entries over.  The heap does
+ * not give back memory so the old array is not reused.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ */
+static	int	table_grow(mem_table_t *mem_table)
+{
+  mem_entry_t	*new_entries, *entry_p, *new_p;
+  unsigned int	size;
+  int		new_n;
+  
+  if (mem_table->mt_entries == NULL) {
+    new_n = mem_table->mt_initial_n;
+  }
+  else {
+    new_n = mem_table->mt_entry_n * 2;
+  }
+  
+  /* round up to the next block */
+  size = sizeof(*new_entries) * new_n;
+  size = ((size + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_SIZE;
+  
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
+    dmalloc_message("growing memory table to %d entries", new_n);
+  }
+  
+  new_entries = _dmalloc_heap_alloc(size);
+  if (new_entries == HEAP_ALLOC_ERROR) {
+    /* error code set in _dmalloc_heap_alloc */
+    return 0;
+  }
+  memset(new_entries, 0, size);
+  if (mem_table->mt_admin_cp != NULL) {
+    *mem_table->mt_admin_cp += size / BLOCK_SIZE;
+  }
+  
+  /* rehash the entries into the new array */
+  if (mem_table->mt_entries != NULL) {
+    for (entry_p = mem_table->mt_entries;
+	 entry_p < mem_table->mt_bounds_p;
+	 entry_p++) {
+      if (! entry_p->me_used_b) {
+	continue;
+      }
+      new_p = find_slot(new_entries, new_n, entry_p->me_file,
+			entry_p->me_line, entry_p->me_stack_p);
+      *new_p = *entry_p;
+    }
+  }
+  
+  mem_table->mt_entries = new_entries;
+  mem_table->mt_entry_n = new_n;
+  mem_table->mt_bounds_p = new_entries + new_n;
+  
+  return 1;
 }
 
 /*
@@ -538,35 +563,20 @@ void	_dmalloc_table_init(mem_table_t *mem_table, mem_entry_t *mem_entries,
  * delete.
  *
  * old_line -> Line number of the allocation to delete.
+ *
+ * old_stack_p -> Recorded call stack of the allocation or NULL if
+ * none.
  */
 static mem_entry_t	*table_find(mem_table_t *mem_table,
 				    const char *old_file,
-				    const unsigned int old_line)
+				    const unsigned int old_line,
+				    const stack_entry_t *old_stack_p)
 {
-  unsigned int	bucket;
-  mem_entry_t	*entry_p, *tab_end_p;
-  
-  bucket = which_bucket(mem_table->mt_entry_n, old_file, old_line);
-  entry_p = mem_table->mt_entries + bucket;
-  
-  /* the end is if we come around to the start again */
-  tab_end_p = entry_p;
-  
-  do {
-    if (entry_p->me_file == old_file && entry_p->me_line == old_line) {
-      return entry_p;
-    }
-    else if (entry_p->me_file == NULL) {
-      /* blank entry */
-      return entry_p;
-    }
-    entry_p++;
-    if (entry_p == mem_table->mt_bounds_p) {
-      entry_p = mem_table->mt_entries;
-    }
-  } while (entry_p != tab_end_p);
-  
-  return &mem_table->mt_other_pointers;
+  if (mem_table->mt_entries == NULL) {
+    return &mem_table->mt_other_pointers;
+  }
+  return find_slot(mem_table->mt_entries, mem_table->mt_entry_n, old_file,
+		   old_line, old_stack_p);
 }
 
 /*
@@ -582,24 +592,41 @@ static mem_entry_t	*table_find(mem_table_t *mem_table,
  *
  * line -> Line number of the allocation.
  *
+ * stack_p -> Recorded call stack of the allocation or NULL if none.
+ *
  * size -> Size in bytes of the allocation.
  */
 void	_dmalloc_table_insert(mem_table_t *mem_table,
 			      const char *file, const unsigned int line,
+			      const struct stack_entry_st *stack_p,
 			      const unsigned long size)
 {
   mem_entry_t	*entry_p;
   
-  entry_p = table_find(mem_table, file, line);
-  if (entry_p->me_file == NULL
-      && mem_table->mt_in_use_c > mem_table->mt_entry_n / 2) {
-    /* do we have too many entries in the table?  then put in other bucket. */
-    entry_p = &mem_table->mt_other_pointers;
-  } else if (entry_p != &mem_table->mt_other_pointers) {
-    /* we found an open slot so update the file/line */
-    entry_p->me_file = file;
-    entry_p->me_line = line;
-    mem_table->mt_in_use_c++;
+  /* keep the table at most half full so the probes stay short */
+  if (mem_table->mt_in_use_c >= mem_table->mt_entry_n / 2
+      && (! mem_table->mt_grow_failed_b)) {
+    /* if we can't grow the table we fall back to the other bucket */
+    if (! table_grow(mem_table)) {
+      mem_table->mt_grow_failed_b = 1;
+    }
+  }
+  
+  entry_p = table_find(mem_table, file, line, stack_p);
+  if ((! entry_p->me_used_b)
+      && entry_p != &mem_table->mt_other_pointers) {
+    if (mem_table->mt_in_use_c >= mem_table->mt_entry_n / 2) {
+      /* the table could not grow and is too full */
+      entry_p = &mem_table->mt_other_pointers;
+    }
+    else {
+      /* we found an open slot so update the file/line */
+      entry_p->me_file = file;
+      entry_p->me_line = line;
+      entry_p->me_stack_p = stack_p;
+      entry_p->me_used_b = 1;
+      mem_table->mt_in_use_c++;
+    }
   }
   
   /* update the info for the entry */
@@ -607,7 +634,6 @@ void	_dmalloc_table_insert(mem_table_t *mem_table,
   entry_p->me_total_c++;
   entry_p->me_in_use_size += size;
   entry_p->me_in_use_c++;
-  entry_p->me_entry_pos_p = entry_p;
 }
 
 /*
@@ -624,16 +650,20 @@ void	_dmalloc_table_insert(mem_table_t *mem_table,
  *
  * old_line -> Line number of the allocation to delete.
  *
+ * old_stack_p -> Recorded call stack of the allocation or NULL if
+ * none.
+ *
  * size -> Size in bytes of the allocation.
  */
 void	_dmalloc_table_delete(mem_table_t *mem_table, const char *old_file,
 			      const unsigned int old_line,
+			      const struct stack_entry_st *old_stack_p,
 			      const DMALLOC_SIZE size)
 {
   mem_entry_t	*entry_p;
   
-  entry_p = table_find(mem_table, old_file, old_line);
-  if (entry_p->me_file == NULL) {
+  entry_p = table_find(mem_table, old_file, old_line, old_stack_p);
+  if (! entry_p->me_used_b) {
     /* if we didn't find it, account for it in the other_pointers?? */
     entry_p = &mem_table->mt_other_pointers;
   }
@@ -647,7 +677,9 @@ void	_dmalloc_table_delete(mem_table_t *mem_table, const char *old_file,
 /*
  * void _dmalloc_table_log_info
  *
- * Log information from the memory table to the log file.
+ * Log information from the memory table to the log file.  The top
+ * entries are selected with a heap of log_n entries so the table is
+ * not sorted or otherwise changed.
  *
  * ARGUMENTS:
  *
@@ -656,14 +688,16 @@ void	_dmalloc_table_delete(mem_table_t *mem_table, const char *old_file,
  * log_n -> Number of entries to log to the file.  Set to 0 to
  * display all entries in the table.
  *
+ * order -> Which MEM_TABLE_ORDER_ value to order the entries by.
+ *
  * in_use_column_b -> Display the in-use numbers in a column.
  */
 void	_dmalloc_table_log_info(mem_table_t *mem_table, const int log_n,
-				const int in_use_column_b)
+				const int order, const int in_use_column_b)
 {
-  mem_entry_t	*entry_p, total;
-  int		entry_c;
-  char		source[64];
+  mem_entry_t	*entry_p, **top_pp, *swap_p, total;
+  int		entry_c, top_n, heap_n, source_len, json_b;
+  char		source[64 + STACK_DESC_SIZE];
   
   /* is the table empty */
   if (mem_table->mt_in_use_c == 0) {
@@ -671,37 +705,92 @@ void	_dmalloc_table_log_info(mem_table_t *mem_table, const int log_n,
     return;
   }
   
-  /* sort the entries by their total-size */
-  split((unsigned char *)mem_table->mt_entries,
-	(unsigned char *)(mem_table->mt_bounds_p - 1),
-	sizeof(*mem_table->mt_entries));
-  
-  /* display the column headers */  
-  if (in_use_column_b) {
-    dmalloc_message(" total-size  count in-use-size  count  source");
+  if (log_n == 0 || log_n > mem_table->mt_in_use_c) {
+    top_n = mem_table->mt_in_use_c;
   }
   else {
-    dmalloc_message(" total-size  count  source");
+    top_n = log_n;
+  }
+  top_pp = top_array(mem_table, top_n);
+  if (top_pp == NULL) {
+    /* we can't order the entries so we just log the totals */
+    top_n = 0;
   }
   
+  /*
+   * Run through the table keeping the top_n largest entries in a
+   * min-heap.  The smallest of them is at the top so it is the one
+   * that is replaced by a larger entry.
+   */
   memset(&total, 0, sizeof(total));
-  
   entry_c = 0;
+  heap_n = 0;
   for (entry_p = mem_table->mt_entries;
        entry_p < mem_table->mt_bounds_p;
        entry_p++) {
-    if (entry_p->me_file != NULL) {
-      entry_c++;
-      /* can we still print the pointer information? */
-      if (log_n == 0 || entry_c < log_n) {
-	(void)_dmalloc_chunk_desc_pnt(source, sizeof(source),
-				      entry_p->me_file, entry_p->me_line);
-	log_entry(entry_p, in_use_column_b, source);
-      }
-      add_entry(&total, entry_p);
+    if (! entry_p->me_used_b) {
+      continue;
+    }
+    entry_c++;
+    add_entry(&total, entry_p);
+    
+    if (heap_n < top_n) {
+      top_pp[heap_n] = entry_p;
+      heap_up(top_pp, heap_n, order);
+      heap_n++;
+    }
+    else if (heap_n > 0
+	     && entry_key(entry_p, order) > entry_key(top_pp[0], order)) {
+      top_pp[0] = entry_p;
+      heap_down(top_pp, heap_n, 0, order);
+    }
+  }
+  
+  /* pop the smallest off to the end to leave the array largest first */
+  for (top_n = heap_n; top_n > 1; ) {
+    top_n--;
+    swap_p = top_pp[0];
+    top_pp[0] = top_pp[top_n];
+    top_pp[top_n] = swap_p;
+    heap_down(top_pp, top_n, 0, order);
+  }
+  
+  json_b = BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_JSON);
+  if (json_b) {
+    for (top_n = 0; top_n < heap_n; top_n++) {
+      log_entry_json(top_pp[top_n], in_use_column_b, "entry");
+    }
+    if (mem_table->mt_other_pointers.me_total_c > 0) {
+      log_entry_json(&mem_table->mt_other_pointers, in_use_column_b,
+		     "other");
+      add_entry(&total, &mem_table->mt_other_pointers);
+    }
+    log_entry_json(&total, in_use_column_b, "total");
+    return;
+  }
+  
+  /* display the column headers */  
+  if (in_use_column_b) {
+    dmalloc_message(" total-size  count in-use-size  count  source");
+  }
+  else {
+    dmalloc_message(" total-size  count  source");
+  }
+  
+  for (top_n = 0; top_n < heap_n; top_n++) {
+    entry_p = top_pp[top_n];
+    (void)_dmalloc_chunk_desc_pnt(source, sizeof(source),
+				  entry_p->me_file, entry_p->me_line);
+    if (entry_p->me_stack_p != NULL) {
+      source_len = strlen(source);
+      source[source_len++] = ' ';
+      (void)_dmalloc_stack_desc(source + source_len,
+				sizeof(source) - source_len,
+				entry_p->me_stack_p);
     }
+    log_entry(entry_p, in_use_column_b, source);
   }
-  if (mem_table->mt_in_use_c >= MEMORY_TABLE_SIZE) {
+  if (mem_table->mt_other_pointers.me_total_c > 0) {
     strncpy(source, "Other pointers", sizeof(source));
     source[sizeof(source) - 1] = '\0';
     log_entry(&mem_table->mt_other_pointers, in_use_column_b, source);
@@ -711,28 +800,4 @@ void	_dmalloc_table_log_info(mem_table_t *mem_table, const int log_n,
   /* dump our total */
   (void)loc_snprintf(source, sizeof(source), "Total of %d", entry_c);
   log_entry(&total, in_use_column_b, source);
-  
-  /*
-   * If we sorted the array, we have to put it back the way it was if
-   * we want to continue and handle memory transactions.  We should be
-   * able to do this in O(N).
-   */
-  for (entry_p = mem_table->mt_entries; entry_p < mem_table->mt_bounds_p;) {
-    mem_entry_t		swap_entry;
-    
-    /*
-     * If we have a blank slot or if the entry is in the right
-     * position then we can move on to the next one
-     */
-    if (entry_p->me_file == NULL
-	|| entry_p->me_entry_pos_p == entry_p) {
-      entry_p++;
-      continue;
-    }
-    
-    /* swap this entry for where it should go and do _not_ increment entry_p */
-    swap_entry = *entry_p->me_entry_pos_p;
-    *entry_p->me_entry_pos_p = *entry_p;
-    *entry_p = swap_entry;
-  }
 }
@@ -22,25 +22,40 @@
 #ifndef __DMALLOC_TAB_H__
 #define __DMALLOC_TAB_H__
 
+/* what we order the entries by when we log the table */
+#define MEM_TABLE_ORDER_TOTAL_SIZE	1	/* total size allocated */
+#define MEM_TABLE_ORDER_IN_USE_SIZE	2	/* size still in use */
+#define MEM_TABLE_ORDER_COUNT		3	/* number of allocations */
+
 /* entry in a memory table */
 typedef struct mem_entry_st {
   const char		*me_file;		/* filename of alloc or ra */
   unsigned int		me_line;		/* line number of alloc */
+  const struct stack_entry_st *me_stack_p;	/* call stack or NULL */
+  int			me_used_b;		/* entry holds a site */
   unsigned long		me_total_size;		/* size bytes alloced */
   unsigned long		me_total_c;		/* total pointers allocated */
   unsigned long		me_in_use_size;		/* size currently alloced */
   unsigned long		me_in_use_c;		/* pointers currently in use */
-  /* we use this so we can easily un-sort the list */
-  struct mem_entry_st	*me_entry_pos_p;	/* pos of entry in table */
 } mem_entry_t;
 
-/* memory table */
+/*
+ * Memory table.  The entries are allocated from the admin heap the
+ * first time something is inserted and the table is doubled whenever
+ * it gets half full so every allocation site keeps its own entry.
+ * The entry count is always a power of 2.
+ */
 typedef struct {
   mem_entry_t		*mt_entries;		/* our entries */
   mem_entry_t		*mt_bounds_p;		/* past the end of entries */
   int			mt_entry_n;		/* number entries in list */
+  int			mt_initial_n;		/* entries to start with */
   int			mt_in_use_c;		/* in use counter */
-  mem_entry_t		mt_other_pointers;	/* other pointer info */
+  int			mt_grow_failed_b;	/* could not get more entries */
+  unsigned long		*mt_admin_cp;		/* admin blocks counter */
+  struct mem_entry_st	**mt_top_pp;		/* used to find the top */
+  int			mt_top_n;		/* size of the top array */
+  mem_entry_t		mt_other_pointers;	/* out of memory info */
 } mem_table_t;
 
 /*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
@@ -49,19 +64,22 @@ typedef struct {
  * void _dmalloc_table_init
  *
  * Clear out the allocation information in our table.  We are going to
- * be loading it with other info.
+ * be loading it with other info.  If the table already has entries
+ * allocated then they are cleared and reused.
  *
  * ARGUMENTS:
  *
  * mem_table -> Memory table we are working on.
  *
- * mem_entries -> Entries to associate with the table.
+ * entry_n -> Number of entries to allocate when the first entry is
+ * inserted.  It is rounded up to a power of 2.
  *
- * entry_n -> Number of entries in the mem_entries array.
+ * admin_cp -> Pointer to the counter of admin blocks which is
+ * increased as we allocate entries from the heap.
  */
 extern
-void	_dmalloc_table_init(mem_table_t *mem_table, mem_entry_t *mem_entries,
-			    const int entry_n);
+void	_dmalloc_table_init(mem_table_t *mem_table, const int entry_n,
+			    unsigned long *admin_cp);
 
 /*
  * void _dmalloc_table_insert
@@ -76,11 +94,14 @@ void	_dmalloc_table_init(mem_table_t *mem_table, mem_entry_t *mem_entries,
  *
  * line -> Line number of the allocation.
  *
+ * stack_p -> Recorded call stack of the allocation or NULL if none.
+ *
  * size -> Size in bytes of the allocation.
  */
 extern
 void	_dmalloc_table_insert(mem_table_t *mem_table,
 			      const char *file, const unsigned int line,
+			      const struct stack_entry_st *stack_p,
 			      const unsigned long size);
 
 /*
@@ -97,17 +118,23 @@ void	_dmalloc_table_insert(mem_table_t *mem_table,
  *
  * old_line -> Line number of the allocation to delete.
  *
+ * old_stack_p -> Recorded call stack of the allocation or NULL if
+ * none.
+ *
  * size -> Size in bytes of the allocation.
  */
 extern
 void	_dmalloc_table_delete(mem_table_t *mem_table, const char *old_file,
 			      const unsigned int old_line,
+			      const struct stack_entry_st *old_stack_p,
 			      const DMALLOC_SIZE size);
 
 /*
  * void _dmalloc_table_log_info
  *
- * Log information from the memory table to the log file.
+ * Log information from the memory table to the log file.  The top
+ * entries are selected with a heap of log_n entries so the table is
+ * not sorted or otherwise changed.
  *
  * ARGUMENTS:
  *
@@ -116,11 +143,13 @@ void	_dmalloc_table_delete(mem_table_t *mem_table, const char *old_file,
  * log_n -> Number of entries to log to the file.  Set to 0 to
  * display all entries in the table.
  *
+ * order -> Which MEM_TABLE_ORDER_ value to order the entries by.
+ *
  * in_use_column_b -> Display the in-use numbers in a column.
  */
 extern
 void	_dmalloc_table_log_info(mem_table_t *mem_table, const int log_n,
-				const int in_use_column_b);
+				const int order, const int in_use_column_b);
 
 /*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
 
@@ -31,6 +31,8 @@
  * and ideas for C++ users would be much appreciated.
  */
  
+#include <new>
+
 extern "C" {
 #include <stdlib.h>
 
@@ -40,6 +42,13 @@ extern "C" {
 #include "return.h"
 }
 
+/* the nothrow and sized operators are declared noexcept since C++11 */
+#if __cplusplus >= 201103L
+#define DMALLOC_NOEXCEPT	noexcept
+#else
+#define DMALLOC_NOEXCEPT	throw()
+#endif
+
 /*
  * An overload function for the C++ new.
  */
@@ -85,3 +94,205 @@ operator delete[](void *pnt)
   GET_RET_ADDR(file);
   dmalloc_free(file, 0, pnt, DMALLOC_FUNC_DELETE_ARRAY);
 }
+
+/*
+ * An overload function for the C++ nothrow new.
+ */
+void *
+operator new(size_t size, const std::nothrow_t &) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  return dmalloc_malloc(file, 0, size, DMALLOC_FUNC_NEW,
+			0 /* no alignment */, 0 /* no xalloc messages */);
+}
+
+/*
+ * An overload function for the C++ nothrow new[].
+ */
+void *
+operator new[](size_t size, const std::nothrow_t &) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  return dmalloc_malloc(file, 0, size, DMALLOC_FUNC_NEW_ARRAY,
+			0 /* no alignment */, 0 /* no xalloc messages */);
+}
+
+/*
+ * An overload function for the C++ nothrow delete.
+ */
+void
+operator delete(void *pnt, const std::nothrow_t &) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free(file, 0, pnt, DMALLOC_FUNC_DELETE);
+}
+
+/*
+ * An overload function for the C++ nothrow delete[].
+ */
+void
+operator delete[](void *pnt, const std::nothrow_t &) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free(file, 0, pnt, DMALLOC_FUNC_DELETE_ARRAY);
+}
+
+#if __cpp_sized_deallocation
+
+/*
+ * An overload function for the C++14 sized delete.  The size must
+ * match the size that was allocated.
+ */
+void
+operator delete(void *pnt, size_t size) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free_sized(file, 0, pnt, size, DMALLOC_FUNC_DELETE);
+}
+
+/*
+ * An overload function for the C++14 sized delete[].  The size must
+ * match the size that was allocated.
+ */
+void
+operator delete[](void *pnt, size_t size) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free_sized(file, 0, pnt, size, DMALLOC_FUNC_DELETE_ARRAY);
+}
+
+#endif /* __cpp_sized_deallocation */
+
+#if __cpp_aligned_new
+
+/*
+ * An overload function for the C++17 new of over-aligned types.
+ */
+void *
+operator new(size_t size, std::align_val_t align)
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  return dmalloc_malloc(file, 0, size, DMALLOC_FUNC_NEW,
+			static_cast<size_t>(align), 0 /* no xalloc messages */);
+}
+
+/*
+ * An overload function for the C++17 new[] of over-aligned types.
+ */
+void *
+operator new[](size_t size, std::align_val_t align)
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  return dmalloc_malloc(file, 0, size, DMALLOC_FUNC_NEW_ARRAY,
+			static_cast<size_t>(align), 0 /* no xalloc messages */);
+}
+
+/*
+ * An overload function for the C++17 nothrow new of over-aligned
+ * types.
+ */
+void *
+operator new(size_t size, std::align_val_t align,
+	     const std::nothrow_t &) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  return dmalloc_malloc(file, 0, size, DMALLOC_FUNC_NEW,
+			static_cast<size_t>(align), 0 /* no xalloc messages */);
+}
+
+/*
+ * An overload function for the C++17 nothrow new[] of over-aligned
+ * types.
+ */
+void *
+operator new[](size_t size, std::align_val_t align,
+	       const std::nothrow_t &) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  return dmalloc_malloc(file, 0, size, DMALLOC_FUNC_NEW_ARRAY,
+			static_cast<size_t>(align), 0 /* no xalloc messages */);
+}
+
+/*
+ * An overload function for the C++17 delete of over-aligned types.
+ */
+void
+operator delete(void *pnt, std::align_val_t) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free(file, 0, pnt, DMALLOC_FUNC_DELETE);
+}
+
+/*
+ * An overload function for the C++17 delete[] of over-aligned types.
+ */
+void
+operator delete[](void *pnt, std::align_val_t) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free(file, 0, pnt, DMALLOC_FUNC_DELETE_ARRAY);
+}
+
+/*
+ * An overload function for the C++17 nothrow delete of over-aligned
+ * types.
+ */
+void
+operator delete(void *pnt, std::align_val_t,
+		const std::nothrow_t &) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free(file, 0, pnt, DMALLOC_FUNC_DELETE);
+}
+
+/*
+ * An overload function for the C++17 nothrow delete[] of over-aligned
+ * types.
+ */
+void
+operator delete[](void *pnt, std::align_val_t,
+		  const std::nothrow_t &) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free(file, 0, pnt, DMALLOC_FUNC_DELETE_ARRAY);
+}
+
+/*
+ * An overload function for the C++17 sized delete of over-aligned
+ * types.  The size must match the size that was allocated.
+ */
+void
+operator delete(void *pnt, size_t size, std::align_val_t) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free_sized(file, 0, pnt, size, DMALLOC_FUNC_DELETE);
+}
+
+/*
+ * An overload function for the C++17 sized delete[] of over-aligned
+ * types.  The size must match the size that was allocated.
+ */
+void
+operator delete[](void *pnt, size_t size, std::align_val_t) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free_sized(file, 0, pnt, size, DMALLOC_FUNC_DELETE_ARRAY);
+}
+
+#endif /* __cpp_aligned_new */
@@ -35,9 +35,15 @@
 #if HAVE_STDLIB_H
 # include <stdlib.h>				/* for abort */
 #endif
+#if HAVE_STRING_H
+# include <string.h>				/* for memcpy */
+#endif
 #if HAVE_UNISTD_H
 # include <unistd.h>				/* for _exit */
 #endif
+#if HAVE_SYS_MMAN_H
+# include <sys/mman.h>				/* for mmap stuff */
+#endif
 
 #include "conf.h"				/* up here for _INCLUDE */
 
@@ -125,10 +131,29 @@ int		_dmalloc_lock_on = 0;
 /* global flag which indicates when we are aborting */
 int		_dmalloc_aborting_b = 0;
 
+/* set to 1 once a fork handler will tell us about forks */
+int		_dmalloc_atfork_b = 0;
+
 /* local variables */
 static	int	outfile_fd = -1;		/* output file descriptor */
 /* the following are here to reduce stack overhead */
 static	char	message_str[1024];		/* message string buffer */
+static	char	json_str[2048];			/* JSON record buffer */
+static	char	*json_p = json_str;		/* end of the JSON record */
+#if HAVE_TIME && (LOG_TIME_NUMBER || LOG_CTIME_STRING)
+static	long	prefix_time = -1;		/* second of cached prefix */
+static	char	prefix_str[64];			/* cached time prefix */
+#endif
+#if HAVE_MMAP
+static	int	log_map_b = 0;			/* logfile is mapped */
+static	char	*log_map_p = NULL;		/* mapping of the logfile */
+static	unsigned long	log_map_size = 0;	/* size of the mapping */
+static	unsigned long	log_map_offset = 0;	/* where next message goes */
+static	unsigned long	log_sync_offset = 0;	/* offset of the last msync */
+#endif
+#if HAVE_GETPID && (LOG_REOPEN || LOG_PID)
+static	long	log_pid = -1;			/* pid we are logging for */
+#endif
 
 /*
  * void _dmalloc_open_log
@@ -226,6 +251,143 @@ static	void	build_logfile_path(char *buf, const int buf_len)
   append_null(buf_p, bounds_p);
 }
 
+#if HAVE_MMAP
+/*
+ * static int map_log
+ *
+ * Map the logfile into memory so the messages can be copied into it.
+ * The file is grown by at least LOG_MMAP_GROW bytes at a time.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * need_size -> Number of bytes that we need past the current offset.
+ */
+static	int	map_log(const unsigned long need_size)
+{
+  unsigned long	new_size;
+  void		*mem;
+  
+  new_size = log_map_size + LOG_MMAP_GROW;
+  if (new_size < log_map_offset + need_size) {
+    new_size = log_map_offset + need_size + LOG_MMAP_GROW;
+  }
+  
+  if (log_map_p != NULL) {
+    (void)munmap(log_map_p, log_map_size);
+    log_map_p = NULL;
+  }
+  
+  if (ftruncate(outfile_fd, new_size) != 0) {
+    return 0;
+  }
+  mem = mmap(0L, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, outfile_fd,
+	     0 /* no offset */);
+  if (mem == MAP_FAILED) {
+    return 0;
+  }
+  
+  log_map_p = mem;
+  log_map_size = new_size;
+  return 1;
+}
+
+/*
+ * static void unmap_log
+ *
+ * Flush the mapped logfile and cut the file back to the end of the
+ * messages.
+ */
+static	void	unmap_log(void)
+{
+  if (log_map_p == NULL) {
+    return;
+  }
+  
+  (void)msync(log_map_p, log_map_size, MS_SYNC);
+  (void)munmap(log_map_p, log_map_size);
+  (void)ftruncate(outfile_fd, log_map_offset);
+  log_map_p = NULL;
+  log_map_size = 0;
+}
+
+/*
+ * static void forget_log
+ *
+ * Let go of our parent's mapped logfile in a forked child without
+ * touching the file.  The child only keeps logging if there is a %p
+ * in the logfile name otherwise it would truncate its parent's file
+ * when it opened it again.
+ */
+static	void	forget_log(void)
+{
+  char	*log_p;
+  
+  if (log_map_p != NULL) {
+    (void)munmap(log_map_p, log_map_size);
+    log_map_p = NULL;
+  }
+  log_map_size = 0;
+  log_map_b = 0;
+  (void)close(outfile_fd);
+  outfile_fd = -1;
+  
+  for (log_p = dmalloc_logpath; *log_p != '\0'; log_p++) {
+    if (*log_p == '%' && *(log_p + 1) == 'p') {
+      return;
+    }
+  }
+  dmalloc_logpath = NULL;
+}
+#endif
+
+/*
+ * static void write_log
+ *
+ * Write a message to the logfile.  If the logfile is mapped then the
+ * message is copied into the map and the new part of the map is
+ * msync'd every LOG_MMAP_SYNC bytes.
+ *
+ * ARGUMENTS:
+ *
+ * buf -> Message to write.
+ *
+ * len -> Length of the message.
+ */
+static	void	write_log(const char *buf, const int len)
+{
+#if HAVE_MMAP
+  if (log_map_b) {
+    unsigned long	sync_start;
+    
+    if (log_map_offset + len > log_map_size && (! map_log(len))) {
+      /* go back to writing at the end of the messages */
+      log_map_b = 0;
+      log_map_size = 0;
+      (void)ftruncate(outfile_fd, log_map_offset);
+      (void)lseek(outfile_fd, log_map_offset, SEEK_SET);
+      (void)write(outfile_fd, buf, len);
+      return;
+    }
+    
+    memcpy(log_map_p + log_map_offset, buf, len);
+    log_map_offset += len;
+    
+    if (log_map_offset - log_sync_offset >= LOG_MMAP_SYNC) {
+      /* msync needs a page aligned start */
+      sync_start = log_sync_offset - log_sync_offset % BLOCK_SIZE;
+      (void)msync(log_map_p + sync_start, log_map_offset - sync_start,
+		  MS_ASYNC);
+      log_sync_offset = log_map_offset;
+    }
+    return;
+  }
+#endif
+  
+  (void)write(outfile_fd, buf, len);
+}
+
 /*
  * void _dmalloc_open_log
  *
@@ -243,8 +405,13 @@ void	_dmalloc_open_log(void)
   
   build_logfile_path(log_path, sizeof(log_path));
   
-  /* open our logfile */
-  outfile_fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  /* open our logfile, mapping it needs read access as well */
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_MMAP)) {
+    outfile_fd = open(log_path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+  }
+  else {
+    outfile_fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  }
   if (outfile_fd < 0) {
     /* NOTE: we can't use dmalloc_message of course so do it the hardway */
     loc_dprintf(STDERR,
@@ -255,6 +422,22 @@ void	_dmalloc_open_log(void)
     return;
   }
   
+#if HAVE_MMAP
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_MMAP)) {
+    log_map_offset = 0;
+    log_sync_offset = 0;
+    if (map_log(0)) {
+      log_map_b = 1;
+    }
+    else {
+      loc_dprintf(STDERR,
+		  "debug-malloc library: could not map '%s', writing it\r\n",
+		  log_path);
+      (void)ftruncate(outfile_fd, 0);
+    }
+  }
+#endif
+  
   /*
    * NOTE: this makes it go recursive here, but it will never enter
    * this section of code.
@@ -267,8 +450,7 @@ void	_dmalloc_open_log(void)
 		  _dmalloc_check_interval, _dmalloc_address,
 		  _dmalloc_address_seen_n, _dmalloc_memory_limit);
 #if LOCK_THREADS
-  dmalloc_message("threads enabled, lock-on = %d, lock-init = %d",
-		  _dmalloc_lock_on, THREAD_INIT_LOCK);
+  dmalloc_message("threads enabled");
 #endif
     
 #if LOG_PNT_TIMEVAL
@@ -321,11 +503,32 @@ void	_dmalloc_reopen_log(void)
 		     dmalloc_logpath);
   }
   
+#if HAVE_MMAP
+  unmap_log();
+  log_map_b = 0;
+#endif
   (void)close(outfile_fd);
   outfile_fd = -1;
   /* we don't call open here, we'll let the next message do it */
 }
 
+/*
+ * void _dmalloc_sync_log
+ *
+ * Make sure that all of the messages are in the logfile.  If the
+ * logfile is mapped then the map is flushed and the file is cut back
+ * to the end of the messages.  The map is grown again if more messages
+ * are written.
+ */
+void	_dmalloc_sync_log(void)
+{
+#if HAVE_MMAP
+  /* the next message will map the file again */
+  unmap_log();
+  log_sync_offset = log_map_offset;
+#endif
+}
+
 #if LOG_PNT_TIMEVAL
 /*
  * char *_dmalloc_ptimeval
@@ -420,6 +623,224 @@ char	*_dmalloc_ptime(const TIME_TYPE *time_p, char *buf, const int buf_size,
 }
 #endif
 
+#if HAVE_GETPID && (LOG_REOPEN || LOG_PID)
+/*
+ * static void check_pid
+ *
+ * Look up our pid and if it has changed since the last time, because
+ * we are a forked child, let go of the parent's mapped logfile and
+ * reopen the logfile if there is a %p in its name.
+ */
+static	void	check_pid(void)
+{
+  /* we make the pid long in case it's big and we hope it will promote */
+  long	new_pid;
+  
+  new_pid = getpid();
+  if (new_pid == log_pid) {
+    return;
+  }
+  
+#if HAVE_MMAP
+  /* a forked child can't write into its parent's map */
+  if (log_map_b && log_pid >= 0) {
+    forget_log();
+  }
+#endif
+  
+  /* NOTE: we need to do this _before_ the reopen otherwise we recurse */
+  log_pid = new_pid;
+  
+#if LOG_REOPEN
+  /* if the new pid doesn't match the old one then reopen it */
+  if (dmalloc_logpath != NULL) {
+    char	*log_p;
+    
+    /* this only works if there is a %p in the logpath */
+    for (log_p = dmalloc_logpath; *log_p != '\0'; log_p++) {
+      if (*log_p == '%' && *(log_p + 1) == 'p') {
+	_dmalloc_reopen_log();
+	break;
+      }
+    }
+  }
+#endif
+}
+#endif
+
+/*
+ * void _dmalloc_log_forked
+ *
+ * Child fork handler which looks up the new pid and, if needed,
+ * reopens the logfile once so the messages don't have to check for a
+ * fork.  This is called with the library quiesced and only the
+ * forking thread left in the child.
+ */
+void	_dmalloc_log_forked(void)
+{
+#if HAVE_GETPID && (LOG_REOPEN || LOG_PID)
+  /* nothing to do if we have not logged anything yet */
+  if (log_pid >= 0) {
+    check_pid();
+  }
+#endif
+}
+
+#if HAVE_TIME
+/*
+ * static long log_time
+ *
+ * Returns the current time in seconds for the log messages.
+ */
+static	long	log_time(void)
+{
+#if LOG_CLOCK_COARSE && defined(CLOCK_REALTIME_COARSE)
+  struct timespec	now_spec;
+  
+  /* the coarse clock does not need to go into the kernel */
+  if (clock_gettime(CLOCK_REALTIME_COARSE, &now_spec) == 0) {
+    return now_spec.tv_sec;
+  }
+#endif
+  return time(NULL);
+}
+#endif
+
+#if HAVE_TIME && (LOG_TIME_NUMBER || LOG_CTIME_STRING)
+/*
+ * static char *append_time_prefix
+ *
+ * Add the time at the front of a log message.  The formatted time is
+ * cached and only rebuilt when the second changes which saves the
+ * formatting, and the ctime call, for the messages in between.
+ *
+ * Returns a pointer to the end of the characters added.
+ *
+ * ARGUMENTS:
+ *
+ * dest -> Buffer we are adding the time to.
+ *
+ * limit -> Limit of the buffer.
+ */
+static	char	*append_time_prefix(char *dest, char *limit)
+{
+  char	*prefix_p, *bounds_p;
+  long	now;
+  
+  now = log_time();
+  if (now != prefix_time) {
+    prefix_p = prefix_str;
+    bounds_p = prefix_str + sizeof(prefix_str);
+#if LOG_TIME_NUMBER
+    prefix_p = append_format(prefix_p, bounds_p, "%ld: ", now);
+#endif
+#if HAVE_CTIME && LOG_CTIME_STRING
+    {
+      TIME_TYPE	ctime_now = now;
+      prefix_p = append_format(prefix_p, bounds_p, "%.24s: ",
+			       ctime(&ctime_now));
+    }
+#endif
+    append_null(prefix_p, bounds_p);
+    prefix_time = now;
+  }
+  
+  return append_string(dest, limit, prefix_str);
+}
+#endif
+
+/*
+ * static int prepare_log
+ *
+ * Get ready to write a line to the log.  This notices a change of pid,
+ * possibly reopening the logfile, and opens the logfile if needed.
+ *
+ * Returns 1 if the line should be written or 0 if there is no logfile
+ * and we aren't printing messages.
+ */
+static	int	prepare_log(void)
+{
+  /* no logpath and no print then no workie */
+  if (dmalloc_logpath == NULL
+      && ! BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_PRINT_MESSAGES)) {
+    return 0;
+  }
+  
+#if HAVE_GETPID && (LOG_REOPEN || LOG_PID)
+  /*
+   * Once the fork handler is registered, it looks up the pid in the
+   * child so we only need to do it for the first message.  Without it
+   * we have to check for a fork for every message.
+   */
+  if (log_pid < 0 || (! _dmalloc_atfork_b)) {
+    check_pid();
+  }
+#endif
+  
+  /* do we need to open the logfile? */
+  if (dmalloc_logpath != NULL && outfile_fd < 0) {
+    _dmalloc_open_log();
+  }
+  
+  return 1;
+}
+
+/*
+ * static void output_line
+ *
+ * Write a finished line to the logfile and to stderr if we are
+ * printing messages.
+ *
+ * ARGUMENTS:
+ *
+ * buf -> Line to write which ends in a newline.
+ *
+ * len -> Length of the line.
+ */
+static	void	output_line(const char *buf, const int len)
+{
+  /* do we need to write the message to the logfile */
+  if (dmalloc_logpath != NULL) {
+    write_log(buf, len);
+  }
+  
+  /* do we need to print the message? */
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_PRINT_MESSAGES)) {
+    (void)write(STDERR, buf, len);
+  }
+}
+
+/*
+ * static void json_start
+ *
+ * Start a new JSON record in the record buffer with the common time,
+ * iteration, pid, and type fields.
+ *
+ * ARGUMENTS:
+ *
+ * type -> Type of the record.
+ */
+static	void	json_start(const char *type)
+{
+  char	*bounds_p = json_str + sizeof(json_str);
+  
+  json_p = json_str;
+  *json_p++ = '{';
+#if HAVE_TIME
+  json_p = append_string(json_p, bounds_p, "\"time\":");
+  json_p = append_long(json_p, bounds_p, log_time(), 10);
+  *json_p++ = ',';
+#endif
+  json_p = append_string(json_p, bounds_p, "\"iter\":");
+  json_p = append_ulong(json_p, bounds_p, _dmalloc_iter_c, 10);
+#if LOG_PID && HAVE_GETPID
+  json_p = append_string(json_p, bounds_p, ",\"pid\":");
+  json_p = append_long(json_p, bounds_p, log_pid, 10);
+#endif
+  json_p = append_string(json_p, bounds_p, ",\"type\":");
+  json_p = append_json_string(json_p, bounds_p, type);
+}
+
 /*
  * void _dmalloc_vmessage
  *
@@ -443,80 +864,37 @@ void	_dmalloc_vmessage(const char *format, va_list args)
   str_p = message_str;
   bounds_p = str_p + sizeof(message_str);
   
-  /* no logpath and no print then no workie */
-  if (dmalloc_logpath == NULL
-      && ! BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_PRINT_MESSAGES)) {
+  if (! prepare_log()) {
     return;
   }
   
-#if HAVE_GETPID && LOG_REOPEN
-  if (dmalloc_logpath != NULL) {
-    char	*log_p;
-    
-    /*
-     * This static pid will be checked to make sure it doesn't change.
-     * We make it long in case it's big and we hope it will promote if
-     * not.
-     */
-    static long		current_pid = -1;
-    long		new_pid;
-    
-    new_pid = getpid();
-    if (new_pid != current_pid) {
-      /* NOTE: we need to do this _before_ the reopen otherwise we recurse */
-      current_pid = new_pid;
-      
-      /* if the new pid doesn't match the old one then reopen it */
-      if (current_pid >= 0) {
-	
-	/* this only works if there is a %p in the logpath */
-	for (log_p = dmalloc_logpath; *log_p != '\0'; log_p++) {
-	  if (*log_p == '%' && *(log_p + 1) == 'p') {
-	    _dmalloc_reopen_log();
-	    break;
-	  }
-	}
-      }
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_JSON)) {
+    /* free-form messages are wrapped so every line is a JSON record */
+    str_p = append_vformat(str_p, bounds_p - 1, format, args);
+    if (str_p == message_str) {
+      return;
     }
-  }
-#endif
-  
-  /* do we need to open the logfile? */
-  if (dmalloc_logpath != NULL && outfile_fd < 0) {
-    _dmalloc_open_log();
+    if (*(str_p - 1) == '\n') {
+      str_p--;
+    }
+    *str_p = '\0';
+    json_start("message");
+    _dmalloc_json_string("message", message_str);
+    _dmalloc_json_end();
+    return;
   }
   
-#if HAVE_TIME
-#if LOG_TIME_NUMBER
-  {
-    long	now;
-    now = time(NULL);
-    str_p = append_format(str_p, bounds_p, "%ld: ", now);
-  }
-#endif /* LOG_TIME_NUMBER */
-#if HAVE_CTIME
-#if LOG_CTIME_STRING
-  {
-    TIME_TYPE	now;
-    now = time(NULL);
-    str_p = append_format(str_p, bounds_p, "%.24s: ", ctime(&now));
-  }
-#endif /* LOG_CTIME_STRING */
-#endif /* HAVE_CTIME */
-#endif /* HAVE_TIME */
+#if HAVE_TIME && (LOG_TIME_NUMBER || LOG_CTIME_STRING)
+  str_p = append_time_prefix(str_p, bounds_p);
+#endif
   
 #if LOG_ITERATION
   /* add the iteration number */
   str_p = append_format(str_p, bounds_p, "%lu: ", _dmalloc_iter_c);
 #endif
 #if LOG_PID && HAVE_GETPID
-  {
-    /* we make it long in case it's big and we hope it will promote if not */
-    long	our_pid = getpid();
-    
-    /* add the pid to the log file */
-    str_p = append_format(str_p, bounds_p, "p%ld: ", our_pid);
-  }
+  /* add the pid to the log file */
+  str_p = append_format(str_p, bounds_p, "p%ld: ", log_pid);
 #endif
   
   /*
@@ -541,15 +919,209 @@ void	_dmalloc_vmessage(const char *format, va_list args)
   }
   len = str_p - message_str;
   
-  /* do we need to write the message to the logfile */
-  if (dmalloc_logpath != NULL) {
-    (void)write(outfile_fd, message_str, len);
+  output_line(message_str, len);
+}
+
+/*
+ * static void json_field
+ *
+ * Add the separator and the name of a field to the JSON record.
+ *
+ * ARGUMENTS:
+ *
+ * name -> Name of the field.
+ */
+static	void	json_field(const char *name)
+{
+  char	*bounds_p = json_str + sizeof(json_str);
+  
+  if (json_p < bounds_p) {
+    *json_p++ = ',';
+  }
+  json_p = append_json_string(json_p, bounds_p, name);
+  if (json_p < bounds_p) {
+    *json_p++ = ':';
+  }
+}
+
+/*
+ * static void json_finish_field
+ *
+ * Drop a field which did not fit into the JSON record so the record
+ * stays well formed.  We always leave room for the closing brace and
+ * the newline.
+ *
+ * ARGUMENTS:
+ *
+ * field_p -> Where the field started in the record.
+ */
+static	void	json_finish_field(char *field_p)
+{
+  if (json_p >= json_str + sizeof(json_str) - 2) {
+    json_p = field_p;
   }
+}
+
+/*
+ * int _dmalloc_json_begin
+ *
+ * Start a structured record in the log.  The fields are added with
+ * the _dmalloc_json_* routines and the record is written as one line
+ * by _dmalloc_json_end.  Everything is built directly in a static
+ * buffer with the append routines so no memory is allocated.
+ *
+ * Returns 1 if the record will be written or 0 if there is no logfile
+ * and we aren't printing messages.
+ *
+ * ARGUMENTS:
+ *
+ * type -> Type of the record which is written as the type field.
+ */
+int	_dmalloc_json_begin(const char *type)
+{
+  if (! prepare_log()) {
+    return 0;
+  }
+  json_start(type);
+  return 1;
+}
+
+/*
+ * void _dmalloc_json_string
+ *
+ * Add a string field to the current structured record.
+ *
+ * ARGUMENTS:
+ *
+ * name -> Name of the field.
+ *
+ * value -> Value of the field which will be escaped.  NULL is written
+ * as null.
+ */
+void	_dmalloc_json_string(const char *name, const char *value)
+{
+  char	*field_p = json_p;
   
-  /* do we need to print the message? */
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_PRINT_MESSAGES)) {
-    (void)write(STDERR, message_str, len);
+  json_field(name);
+  json_p = append_json_string(json_p, json_str + sizeof(json_str), value);
+  json_finish_field(field_p);
+}
+
+/*
+ * void _dmalloc_json_ulong
+ *
+ * Add an unsigned number field to the current structured record.
+ *
+ * ARGUMENTS:
+ *
+ * name -> Name of the field.
+ *
+ * value -> Value of the field.
+ */
+void	_dmalloc_json_ulong(const char *name, const unsigned long value)
+{
+  char	*field_p = json_p;
+  
+  json_field(name);
+  json_p = append_ulong(json_p, json_str + sizeof(json_str), value, 10);
+  json_finish_field(field_p);
+}
+
+/*
+ * void _dmalloc_json_long
+ *
+ * Add a signed number field to the current structured record.
+ *
+ * ARGUMENTS:
+ *
+ * name -> Name of the field.
+ *
+ * value -> Value of the field.
+ */
+void	_dmalloc_json_long(const char *name, const long value)
+{
+  char	*field_p = json_p;
+  
+  json_field(name);
+  json_p = append_long(json_p, json_str + sizeof(json_str), value, 10);
+  json_finish_field(field_p);
+}
+
+/*
+ * void _dmalloc_json_pnt
+ *
+ * Add a pointer field to the current structured record.  JSON has no
+ * hexadecimal numbers so the pointer is written as a "0x..." string.
+ *
+ * ARGUMENTS:
+ *
+ * name -> Name of the field.
+ *
+ * pnt -> Pointer value of the field.
+ */
+void	_dmalloc_json_pnt(const char *name, const void *pnt)
+{
+  char	*field_p = json_p, *bounds_p = json_str + sizeof(json_str);
+  
+  json_field(name);
+  json_p = append_string(json_p, bounds_p, "\"0x");
+  json_p = append_pointer(json_p, bounds_p, (PNT_ARITH_TYPE)pnt, 16);
+  if (json_p < bounds_p) {
+    *json_p++ = '"';
   }
+  json_finish_field(field_p);
+}
+
+/*
+ * void _dmalloc_json_where
+ *
+ * Add the location of an allocation or a call to the current
+ * structured record.  A file and line-number are written as the
+ * <prefix>file and <prefix>line fields and a return-address as the
+ * <prefix>ra field.  Nothing is added if the location is unknown.
+ *
+ * ARGUMENTS:
+ *
+ * prefix -> Prefix of the field names which can be "".
+ *
+ * file -> File name, return address, or NULL.
+ *
+ * line -> Line number or 0.
+ */
+void	_dmalloc_json_where(const char *prefix, const char *file,
+			    const unsigned int line)
+{
+  char	name[64] = { '\0' }, *name_p, *bounds_p = name + sizeof(name);
+  
+  /* leave room for the field name after the prefix */
+  name_p = append_string(name, bounds_p - 8, prefix);
+  
+  if (line == DMALLOC_DEFAULT_LINE) {
+    if (file != DMALLOC_DEFAULT_FILE) {
+      append_null(append_string(name_p, bounds_p, "ra"), bounds_p);
+      _dmalloc_json_pnt(name, file);
+    }
+    return;
+  }
+  
+  append_null(append_string(name_p, bounds_p, "file"), bounds_p);
+  _dmalloc_json_string(name, file);
+  append_null(append_string(name_p, bounds_p, "line"), bounds_p);
+  _dmalloc_json_ulong(name, line);
+}
+
+/*
+ * void _dmalloc_json_end
+ *
+ * Close the current structured record and write it to the log as one
+ * line.
+ */
+void	_dmalloc_json_end(void)
+{
+  *json_p++ = '}';
+  *json_p++ = '\n';
+  output_line(json_str, json_p - json_str);
+  json_p = json_str;
 }
 
 /*
@@ -626,8 +1198,18 @@ void	dmalloc_error(const char *func)
     }
     
     /* print the malloc error message */
-    dmalloc_message("ERROR: %s: %s (err %d)",
-		    func, dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+    if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_JSON)) {
+      if (_dmalloc_json_begin("error")) {
+	_dmalloc_json_string("func", func);
+	_dmalloc_json_long("errno", dmalloc_errno);
+	_dmalloc_json_string("error", dmalloc_strerror(dmalloc_errno));
+	_dmalloc_json_end();
+      }
+    }
+    else {
+      dmalloc_message("ERROR: %s: %s (err %d)",
+		      func, dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+    }
   }
   
   /* do I need to abort? */
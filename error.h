@@ -84,6 +84,10 @@ int		_dmalloc_lock_on;
 extern
 int		_dmalloc_aborting_b;
 
+/* set to 1 once a fork handler will tell us about forks */
+extern
+int		_dmalloc_atfork_b;
+
 /*
  * void _dmalloc_open_log
  *
@@ -102,6 +106,17 @@ void	_dmalloc_open_log(void);
 extern
 void	_dmalloc_reopen_log(void);
 
+/*
+ * void _dmalloc_sync_log
+ *
+ * Make sure that all of the messages are in the logfile.  If the
+ * logfile is mapped then the map is flushed and the file is cut back
+ * to the end of the messages.  The map is grown again if more messages
+ * are written.
+ */
+extern
+void	_dmalloc_sync_log(void);
+
 #if LOG_PNT_TIMEVAL
 /*
  * char *_dmalloc_ptimeval
@@ -148,6 +163,17 @@ char	*_dmalloc_ptime(const TIME_TYPE *time_p, char *buf, const int buf_size,
 			const int elapsed_b);
 #endif /* if LOG_PNT_TIMEVAL == 0 && HAVE_TIME */
 
+/*
+ * void _dmalloc_log_forked
+ *
+ * Child fork handler which looks up the new pid and, if needed,
+ * reopens the logfile once so the messages don't have to check for a
+ * fork.  This is called with the library quiesced and only the
+ * forking thread left in the child.
+ */
+extern
+void	_dmalloc_log_forked(void);
+
 /*
  * void _dmalloc_vmessage
  *
@@ -166,6 +192,111 @@ char	*_dmalloc_ptime(const TIME_TYPE *time_p, char *buf, const int buf_size,
 extern
 void	_dmalloc_vmessage(const char *format, va_list args);
 
+/*
+ * int _dmalloc_json_begin
+ *
+ * Start a structured record in the log.  The fields are added with
+ * the _dmalloc_json_* routines and the record is written as one line
+ * by _dmalloc_json_end.  Everything is built directly in a static
+ * buffer with the append routines so no memory is allocated.
+ *
+ * Returns 1 if the record will be written or 0 if there is no logfile
+ * and we aren't printing messages.
+ *
+ * ARGUMENTS:
+ *
+ * type -> Type of the record which is written as the type field.
+ */
+extern
+int	_dmalloc_json_begin(const char *type);
+
+/*
+ * void _dmalloc_json_string
+ *
+ * Add a string field to the current structured record.
+ *
+ * ARGUMENTS:
+ *
+ * name -> Name of the field.
+ *
+ * value -> Value of the field which will be escaped.  NULL is written
+ * as null.
+ */
+extern
+void	_dmalloc_json_string(const char *name, const char *value);
+
+/*
+ * void _dmalloc_json_ulong
+ *
+ * Add an unsigned number field to the current structured record.
+ *
+ * ARGUMENTS:
+ *
+ * name -> Name of the field.
+ *
+ * value -> Value of the field.
+ */
+extern
+void	_dmalloc_json_ulong(const char *name, const unsigned long value);
+
+/*
+ * void _dmalloc_json_long
+ *
+ * Add a signed number field to the current structured record.
+ *
+ * ARGUMENTS:
+ *
+ * name -> Name of the field.
+ *
+ * value -> Value of the field.
+ */
+extern
+void	_dmalloc_json_long(const char *name, const long value);
+
+/*
+ * void _dmalloc_json_pnt
+ *
+ * Add a pointer field to the current structured record.  JSON has no
+ * hexadecimal numbers so the pointer is written as a "0x..." string.
+ *
+ * ARGUMENTS:
+ *
+ * name -> Name of the field.
+ *
+ * pnt -> Pointer value of the field.
+ */
+extern
+void	_dmalloc_json_pnt(const char *name, const void *pnt);
+
+/*
+ * void _dmalloc_json_where
+ *
+ * Add the location of an allocation or a call to the current
+ * structured record.  A file and line-number are written as the
+ * <prefix>file and <prefix>line fields and a return-address as the
+ * <prefix>ra field.  Nothing is added if the location is unknown.
+ *
+ * ARGUMENTS:
+ *
+ * prefix -> Prefix of the field names which can be "".
+ *
+ * file -> File name, return address, or NULL.
+ *
+ * line -> Line number or 0.
+ */
+extern
+void	_dmalloc_json_where(const char *prefix, const char *file,
+			    const unsigned int line);
+
+/*
+ * void _dmalloc_json_end
+ *
+ * Close the current structured record and write it to the log as one
+ * line.
+ */
+extern
+void	_dmalloc_json_end(void);
+
 /*
  * void _dmalloc_die
  *
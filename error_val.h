@@ -61,7 +61,9 @@
 /* free errors */
 #define DMALLOC_ERROR_NOT_ON_BLOCK	60	/* not on block boundary */
 #define DMALLOC_ERROR_ALREADY_FREE	61	/* already in free list */
-/* 62-66 unused */
+#define DMALLOC_ERROR_WRONG_SIZE	62	/* freed with the wrong size */
+#define DMALLOC_ERROR_BAD_REGION	63	/* unknown allocation region */
+/* 64-66 unused */
 #define DMALLOC_ERROR_FREE_OVERWRITTEN	67	/* free space overwritten */
 
 /* administrative errors */
@@ -111,6 +113,8 @@ __attribute__ ((unused))
   /* free errors */
   { DMALLOC_ERROR_NOT_ON_BLOCK,		"pointer is not on block boundary" },
   { DMALLOC_ERROR_ALREADY_FREE,		"tried to free previously freed pointer" },
+  { DMALLOC_ERROR_WRONG_SIZE,		"pointer freed with a different size than allocated" },
+  { DMALLOC_ERROR_BAD_REGION,		"invalid or unknown allocation region" },
   { DMALLOC_ERROR_FREE_OVERWRITTEN,	"free space has been overwritten" },
   
   /* administrative errors */
@@ -0,0 +1,327 @@
+/*
+ * Library lock routines for the threaded library
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via http://dmalloc.com/
+ */
+
+/*
+ * This file contains the slow paths of the lock which protects the
+ * library in threaded programs.  The lock is built directly on the
+ * compiler's atomic operations and, under Linux, on the futex system
+ * call so it never calls back into the thread library which might
+ * want to allocate memory.  See "Futexes Are Tricky" by Ulrich
+ * Drepper for the design.  Since the library only holds the lock for
+ * a short time, a waiting thread spins with an exponential backoff
+ * before it goes to sleep.  Threads which only look at the heap can
+ * share the lock as readers.
+ */
+
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for syscall, sysconf */
+#endif
+
+#ifdef __linux__
+# include <linux/futex.h>
+# include <sys/syscall.h>
+#endif
+
+#define DMALLOC_DISABLE
+
+#include "conf.h"
+
+#ifdef TIMEVAL_INCLUDE
+# include TIMEVAL_INCLUDE
+#endif
+
+#include "dmalloc.h"
+
+#include "debug_tok.h"
+#include "dmalloc_loc.h"
+#include "error.h"
+#include "lock.h"
+
+#ifndef __GNUC__
+#error The thread lock needs the __sync atomic builtins of gcc or clang
+#endif
+
+#if defined(SYS_futex) && defined(FUTEX_WAIT_PRIVATE)
+/* sleep in the kernel while the word still has the value */
+#define LOCK_SLEEP(word_p, val)	(void)syscall(SYS_futex, (word_p), \
+					      FUTEX_WAIT_PRIVATE, (val), \
+					      NULL, NULL, 0)
+/* wake up one of the threads sleeping on the word */
+#define LOCK_WAKE(word_p)	(void)syscall(SYS_futex, (word_p), \
+					      FUTEX_WAKE_PRIVATE, 1, NULL, \
+					      NULL, 0)
+#else
+/* without futexes we give up the processor and try again */
+#include <sched.h>
+#define LOCK_SLEEP(word_p, val)	(void)sched_yield()
+#define LOCK_WAKE(word_p)
+#endif
+
+/* let the other hyper-thread run while we spin */
+#if defined(__i386__) || defined(__x86_64__)
+#define LOCK_PAUSE()		__asm__ __volatile__ ("pause")
+#else
+#define LOCK_PAUSE()		__asm__ __volatile__ ("" : : : "memory")
+#endif
+
+/* how many times to spin, which is 0 with only one processor */
+static	int	spin_limit = -1;
+
+/*
+ * static void set_spin_limit
+ *
+ * Figure out how many times we spin before sleeping.  Spinning is a
+ * waste if the holder can't run while we do it.
+ */
+static	void	set_spin_limit(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+  if (sysconf(_SC_NPROCESSORS_ONLN) > 1) {
+    spin_limit = LOCK_SPIN_LIMIT;
+  }
+  else {
+    spin_limit = 0;
+  }
+#else
+  spin_limit = LOCK_SPIN_LIMIT;
+#endif
+}
+
+/*
+ * static void backoff_pause
+ *
+ * Pause between looks at the lock and double the next pause.
+ *
+ * ARGUMENTS:
+ *
+ * backoff_p <-> Number of pauses which is doubled up to
+ * LOCK_BACKOFF_MAX.
+ */
+static	void	backoff_pause(int *backoff_p)
+{
+  int	pause_c;
+  
+  for (pause_c = 0; pause_c < *backoff_p; pause_c++) {
+    LOCK_PAUSE();
+  }
+  if (*backoff_p < LOCK_BACKOFF_MAX) {
+    *backoff_p *= 2;
+  }
+}
+
+/*
+ * void _dmalloc_lock_wait
+ *
+ * Slow path of LOCK_ACQUIRE.  Spin for a bit waiting for the lock to
+ * be released and then go to sleep until it is.  Then take it.
+ *
+ * ARGUMENTS:
+ *
+ * lock_p -> Lock we are waiting for.
+ */
+void	_dmalloc_lock_wait(dmalloc_lock_t *lock_p)
+{
+  TIMEVAL_TYPE	start, now;
+  unsigned long	sleep_c = 0;
+  int		spin_c, backoff = 1, locked_b = 0;
+  
+  GET_TIMEVAL(start);
+  
+  if (spin_limit < 0) {
+    set_spin_limit();
+  }
+  
+  /* only try the atomic when the lock looks free to keep the line shared */
+  for (spin_c = 0; spin_c < spin_limit; spin_c++) {
+    if (lock_p->dl_state == LOCK_STATE_FREE
+	&& __sync_val_compare_and_swap(&lock_p->dl_state, LOCK_STATE_FREE,
+				       LOCK_STATE_LOCKED)
+	== LOCK_STATE_FREE) {
+      locked_b = 1;
+      break;
+    }
+    backoff_pause(&backoff);
+  }
+  
+  /*
+   * Mark the lock as having waiters so the holder will wake us.  We
+   * own the lock if it was released before we marked it.  Since we
+   * don't know if others are still waiting, we keep the waiters
+   * state when we get the lock this way.
+   */
+  if (! locked_b) {
+    while (__sync_lock_test_and_set(&lock_p->dl_state, LOCK_STATE_WAITERS)
+	   != LOCK_STATE_FREE) {
+      LOCK_SLEEP(&lock_p->dl_state, LOCK_STATE_WAITERS);
+      sleep_c++;
+    }
+  }
+  
+  /*
+   * The exchange above may only be an acquire barrier.  LOCK_ACQUIRE
+   * needs our store to the state to be seen before it looks at the
+   * readers.
+   */
+  __sync_synchronize();
+  
+  /* we have the lock now so we can update the counters */
+  GET_TIMEVAL(now);
+  lock_p->dl_contend_c++;
+  lock_p->dl_sleep_c += sleep_c;
+  lock_p->dl_wait_usecs += (now.tv_sec - start.tv_sec) * 1000000
+    + (now.tv_usec - start.tv_usec);
+}
+
+/*
+ * void _dmalloc_lock_wake
+ *
+ * Slow path of LOCK_RELEASE.  Release the lock and wake up one of the
+ * threads which are waiting for it.
+ *
+ * ARGUMENTS:
+ *
+ * lock_p -> Lock we are releasing.
+ */
+void	_dmalloc_lock_wake(dmalloc_lock_t *lock_p)
+{
+  /* the release already took the state from waiters down to locked */
+  __sync_lock_release(&lock_p->dl_state);
+  LOCK_WAKE(&lock_p->dl_state);
+}
+
+/*
+ * void _dmalloc_lock_drain
+ *
+ * Called by LOCK_ACQUIRE once it has the lock but there are still
+ * readers in the library.  New readers can't get in so we spin for a
+ * bit and then sleep until the last one leaves.
+ *
+ * ARGUMENTS:
+ *
+ * lock_p -> Lock which we hold.
+ */
+void	_dmalloc_lock_drain(dmalloc_lock_t *lock_p)
+{
+  TIMEVAL_TYPE	start, now;
+  int		readers, spin_c, backoff = 1;
+  
+  GET_TIMEVAL(start);
+  
+  if (spin_limit < 0) {
+    set_spin_limit();
+  }
+  
+  for (spin_c = 0; spin_c < spin_limit; spin_c++) {
+    if (lock_p->dl_readers == 0) {
+      break;
+    }
+    backoff_pause(&backoff);
+  }
+  
+  /* the futex call returns right away if the count has changed */
+  while ((readers = lock_p->dl_readers) != 0) {
+    LOCK_SLEEP(&lock_p->dl_readers, readers);
+  }
+  
+  GET_TIMEVAL(now);
+  lock_p->dl_drain_c++;
+  lock_p->dl_wait_usecs += (now.tv_sec - start.tv_sec) * 1000000
+    + (now.tv_usec - start.tv_usec);
+}
+
+/*
+ * int _dmalloc_lock_read_try
+ *
+ * Slow path of LOCK_READ_TRY.  Count ourselves as a reader and then
+ * make sure that nobody took the lock before we were counted.
+ *
+ * Returns 1 if we are in as a reader or 0 if someone has the lock.
+ *
+ * ARGUMENTS:
+ *
+ * lock_p -> Lock we are sharing.
+ */
+int	_dmalloc_lock_read_try(dmalloc_lock_t *lock_p)
+{
+  /*
+   * The add and the compare-and-swap in LOCK_ACQUIRE are both full
+   * barriers so either we see its state or it sees our count.
+   */
+  (void)__sync_add_and_fetch(&lock_p->dl_readers, 1);
+  if (lock_p->dl_state == LOCK_STATE_FREE) {
+    return 1;
+  }
+  
+  /* someone got the lock first so we back out */
+  LOCK_READ_RELEASE(lock_p);
+  return 0;
+}
+
+/*
+ * void _dmalloc_lock_readers_gone
+ *
+ * Slow path of LOCK_READ_RELEASE.  We were the last reader and
+ * someone who has the lock is waiting for us to leave.
+ *
+ * ARGUMENTS:
+ *
+ * lock_p -> Lock we were sharing.
+ */
+void	_dmalloc_lock_readers_gone(dmalloc_lock_t *lock_p)
+{
+  LOCK_WAKE(&lock_p->dl_readers);
+}
+
+/*
+ * void _dmalloc_lock_log_stats
+ *
+ * Log the contention counters of a lock.  This should be called with
+ * the lock held.
+ *
+ * ARGUMENTS:
+ *
+ * lock_p -> Lock whose counters we are logging.
+ */
+void	_dmalloc_lock_log_stats(const dmalloc_lock_t *lock_p)
+{
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_JSON)) {
+    if (! _dmalloc_json_begin("lock")) {
+      return;
+    }
+    _dmalloc_json_ulong("acquired", lock_p->dl_acquire_c);
+    _dmalloc_json_ulong("contended", lock_p->dl_contend_c);
+    _dmalloc_json_ulong("reader_waits", lock_p->dl_drain_c);
+    _dmalloc_json_ulong("slept", lock_p->dl_sleep_c);
+    _dmalloc_json_ulong("wait_usecs", lock_p->dl_wait_usecs);
+    _dmalloc_json_end();
+    return;
+  }
+  
+  dmalloc_message("lock acquired %lu times, contended %lu (%lu%%)",
+		  lock_p->dl_acquire_c, lock_p->dl_contend_c,
+		  (lock_p->dl_acquire_c == 0 ? 0 :
+		   (lock_p->dl_contend_c * 100) / lock_p->dl_acquire_c));
+  dmalloc_message("lock waited for readers %lu times", lock_p->dl_drain_c);
+  dmalloc_message("lock slept %lu times, waited %lu.%06lu secs",
+		  lock_p->dl_sleep_c,
+		  lock_p->dl_wait_usecs / 1000000,
+		  lock_p->dl_wait_usecs % 1000000);
+}
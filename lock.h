@@ -0,0 +1,187 @@
+/*
+ * Defines for the library lock used by the threaded library.
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via http://dmalloc.com/
+ */
+
+#ifndef __LOCK_H__
+#define __LOCK_H__
+
+/*
+ * The lock is a single word which is 0 when unlocked, 1 when locked,
+ * and 2 when locked and other threads may be waiting for it.  It is
+ * statically initialized and never calls into the thread library so
+ * it can be used from the very first allocation.  Threads which only
+ * look at the heap can share the lock and are counted in dl_readers.
+ * The other counters are only changed while holding the lock.
+ */
+typedef struct {
+  volatile int		dl_state;		/* LOCK_STATE_* value */
+  volatile int		dl_readers;		/* threads sharing the lock */
+  unsigned long		dl_acquire_c;		/* times lock was taken */
+  unsigned long		dl_contend_c;		/* times we had to wait */
+  unsigned long		dl_sleep_c;		/* times we slept for it */
+  unsigned long		dl_drain_c;		/* times readers held us */
+  unsigned long		dl_wait_usecs;		/* total time waiting */
+} dmalloc_lock_t;
+
+#define LOCK_STATE_FREE		0		/* nobody has the lock */
+#define LOCK_STATE_LOCKED	1		/* locked with no waiters */
+#define LOCK_STATE_WAITERS	2		/* locked and maybe waiters */
+
+/* static initializer for a lock */
+#define LOCK_INITIALIZER	{ LOCK_STATE_FREE, 0, 0, 0, 0, 0, 0 }
+
+/*
+ * Take and release the lock.  When nobody else has the lock this
+ * costs a single atomic operation.  Otherwise we go to the slow path
+ * which spins for a bit and then waits in the kernel for the holder to
+ * release it.  Once we have the lock, no new readers can get in but
+ * we may need to wait for the ones already in to leave.
+ */
+#define LOCK_ACQUIRE(lock_p) \
+	do { \
+	  if (__sync_val_compare_and_swap(&(lock_p)->dl_state, \
+					  LOCK_STATE_FREE, \
+					  LOCK_STATE_LOCKED) \
+	      != LOCK_STATE_FREE) { \
+	    _dmalloc_lock_wait(lock_p); \
+	  } \
+	  if ((lock_p)->dl_readers != 0) { \
+	    _dmalloc_lock_drain(lock_p); \
+	  } \
+	  (lock_p)->dl_acquire_c++; \
+	} while(0)
+#define LOCK_RELEASE(lock_p) \
+	do { \
+	  if (__sync_fetch_and_sub(&(lock_p)->dl_state, 1) \
+	      != LOCK_STATE_LOCKED) { \
+	    _dmalloc_lock_wake(lock_p); \
+	  } \
+	} while(0)
+
+/*
+ * Share the lock with other threads which only look at the heap.  A
+ * reader only gets in while nobody has the lock.  LOCK_READ_TRY
+ * returns 0 otherwise in which case the caller should take the lock
+ * with LOCK_ACQUIRE instead of spinning on it.
+ */
+#define LOCK_READ_TRY(lock_p) \
+	((lock_p)->dl_state == LOCK_STATE_FREE \
+	 && _dmalloc_lock_read_try(lock_p))
+#define LOCK_READ_RELEASE(lock_p) \
+	do { \
+	  if (__sync_sub_and_fetch(&(lock_p)->dl_readers, 1) == 0 \
+	      && (lock_p)->dl_state != LOCK_STATE_FREE) { \
+	    _dmalloc_lock_readers_gone(lock_p); \
+	  } \
+	} while(0)
+
+/* reset the lock such as in the child after a fork */
+#define LOCK_RESET(lock_p) \
+	do { \
+	  (lock_p)->dl_state = LOCK_STATE_FREE; \
+	  (lock_p)->dl_readers = 0; \
+	} while(0)
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * void _dmalloc_lock_wait
+ *
+ * Slow path of LOCK_ACQUIRE.  Spin for a bit waiting for the lock to
+ * be released and then go to sleep until it is.  Then take it.
+ *
+ * ARGUMENTS:
+ *
+ * lock_p -> Lock we are waiting for.
+ */
+extern
+void	_dmalloc_lock_wait(dmalloc_lock_t *lock_p);
+
+/*
+ * void _dmalloc_lock_wake
+ *
+ * Slow path of LOCK_RELEASE.  Release the lock and wake up one of the
+ * threads which are waiting for it.
+ *
+ * ARGUMENTS:
+ *
+ * lock_p -> Lock we are releasing.
+ */
+extern
+void	_dmalloc_lock_wake(dmalloc_lock_t *lock_p);
+
+/*
+ * void _dmalloc_lock_drain
+ *
+ * Called by LOCK_ACQUIRE once it has the lock but there are still
+ * readers in the library.  New readers can't get in so we spin for a
+ * bit and then sleep until the last one leaves.
+ *
+ * ARGUMENTS:
+ *
+ * lock_p -> Lock which we hold.
+ */
+extern
+void	_dmalloc_lock_drain(dmalloc_lock_t *lock_p);
+
+/*
+ * int _dmalloc_lock_read_try
+ *
+ * Slow path of LOCK_READ_TRY.  Count ourselves as a reader and then
+ * make sure that nobody took the lock before we were counted.
+ *
+ * Returns 1 if we are in as a reader or 0 if someone has the lock.
+ *
+ * ARGUMENTS:
+ *
+ * lock_p -> Lock we are sharing.
+ */
+extern
+int	_dmalloc_lock_read_try(dmalloc_lock_t *lock_p);
+
+/*
+ * void _dmalloc_lock_readers_gone
+ *
+ * Slow path of LOCK_READ_RELEASE.  We were the last reader and
+ * someone who has the lock is waiting for us to leave.
+ *
+ * ARGUMENTS:
+ *
+ * lock_p -> Lock we were sharing.
+ */
+extern
+void	_dmalloc_lock_readers_gone(dmalloc_lock_t *lock_p);
+
+/*
+ * void _dmalloc_lock_log_stats
+ *
+ * Log the contention counters of a lock.  This should be called with
+ * the lock held.
+ *
+ * ARGUMENTS:
+ *
+ * lock_p -> Lock whose counters we are logging.
+ */
+extern
+void	_dmalloc_lock_log_stats(const dmalloc_lock_t *lock_p);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __LOCK_H__ */
@@ -103,7 +103,17 @@
 
 /*************************************/
 
-/* for x86-64 machines with GCC */
+/*
+ * For x86-64 machines with GCC.  Reading the return address off of
+ * the frame pointer breaks when the frame pointer is omitted so we
+ * use the builtin which knows where the compiler left it.
+ */
+#if __x86_64__ && __GNUC__ > 2
+
+#define GET_RET_ADDR(file)	file = (char *)__builtin_return_address(0)
+
+#endif /* __x86_64__ */
+
 /* this doesn't seem to work for: __x86_64__ && __GNUC__ > 1 */
 #if 0
 
@@ -0,0 +1,62 @@
+/*
+ * Defines for the binary heap snapshot files.
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via http://dmalloc.com/
+ */
+
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+/*
+ * A snapshot file is a snap_header_t followed by a snap_record_t for
+ * each pointer in use up to the end of the file.  Each record is
+ * followed directly by sr_file_len bytes of the allocating file name
+ * which is not \0 terminated.  The file is written in the native byte
+ * order and sizes of the machine and is meant to be read back by the
+ * dmalloc utility on the same architecture.
+ */
+
+/* magic number and layout version at the top of the file */
+#define SNAPSHOT_MAGIC		0x0dea5a9aL
+#define SNAPSHOT_VERSION	1
+
+/* the longest file name we store with a record */
+#define SNAPSHOT_MAX_FILE	255
+
+/* header at the front of the snapshot file */
+typedef struct {
+  unsigned long		sh_magic;		/* SNAPSHOT_MAGIC */
+  unsigned long		sh_version;		/* SNAPSHOT_VERSION */
+  unsigned long		sh_record_size;		/* sizeof(snap_record_t) */
+  unsigned long		sh_pid;			/* process which wrote it */
+  unsigned long		sh_iter_c;		/* iteration when written */
+} snap_header_t;
+
+/* one of these is written for each pointer in use */
+typedef struct {
+  unsigned long		sr_addr;		/* user address */
+  unsigned long		sr_ret_addr;		/* return-address if no file */
+  unsigned long		sr_use_iter;		/* when last ``used'' */
+  unsigned int		sr_user_size;		/* size requested by user */
+  unsigned int		sr_total_size;		/* total size of the block */
+  unsigned short	sr_line;		/* line where allocated */
+  unsigned char		sr_flags;		/* the slot's flags */
+  unsigned char		sr_file_len;		/* file name bytes following */
+} snap_record_t;
+
+#endif /* ! __SNAPSHOT_H__ */
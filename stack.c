@@ -0,0 +1,380 @@
+/*
+ * Call stack recording routines
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via http://dmalloc.com/
+ */
+
+
+/*
+ * This file contains the routines which record the call stack of an
+ * allocation by following the frame pointers, starting at the user's
+ * call into the library, and which store each distinct stack once in
+ * a hash table.  The address of a stored stack is used as its id so
+ * the memory table can tell apart allocations which are made from the
+ * same location through different callers.
+ */
+
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+
+#define DMALLOC_DISABLE
+
+#include "conf.h"
+#include "dmalloc.h"
+
+#include "append.h"
+#include "compat.h"
+#include "dmalloc_loc.h"
+#include "debug_tok.h"
+#include "error.h"
+#include "heap.h"
+#include "stack.h"
+
+#if LOG_PNT_STACK_DEPTH
+
+/* hash table of stored stacks */
+static	stack_entry_t	**stack_buckets = NULL;	/* the buckets */
+static	unsigned int	stack_bucket_n = 0;	/* number of buckets */
+static	unsigned int	stack_entry_c = 0;	/* number of stacks stored */
+
+/* the part of our last admin block that is not used yet */
+static	char		*stack_free_p = NULL;	/* start of free space */
+static	char		*stack_bounds_p = NULL;	/* end of free space */
+
+/* where the user called into the library, see _dmalloc_stack_set_caller */
+static	const void	*stack_caller = NULL;
+
+/*
+ * static int unwind
+ *
+ * Follow the frame pointers up the stack and record the
+ * return-addresses.  We stop if a frame pointer does not look right
+ * which happens at the top of the stack or when the code was compiled
+ * without frame pointers.
+ *
+ * If we know the caller of the library then the frames below it are
+ * our own and are skipped.  If we never get to the caller then some
+ * frame in the library lost its frame pointer and we record only the
+ * caller itself which is better than a stack of library addresses.
+ *
+ * Returns the number of addresses recorded.
+ *
+ * ARGUMENTS:
+ *
+ * addrs <- Array which will be set to the return-addresses.
+ *
+ * max_n -> Maximum number of addresses to record.
+ *
+ * caller -> Return-address of the library's caller or NULL if none.
+ */
+static	int	unwind(void **addrs, const int max_n, const void *caller)
+{
+#ifdef __GNUC__
+  void	**frame_p, **next_p;
+  int	addr_c = 0, skip_c = 0, found_b;
+  
+  found_b = (caller == NULL);
+  frame_p = (void **)__builtin_frame_address(0);
+  while (addr_c < max_n) {
+    if (frame_p[1] == NULL) {
+      break;
+    }
+    if (! found_b) {
+      if (frame_p[1] == caller) {
+	found_b = 1;
+      }
+      else if (++skip_c > STACK_SKIP_MAX) {
+	break;
+      }
+    }
+    if (found_b) {
+      addrs[addr_c++] = frame_p[1];
+    }
+    
+    /* the stack grows down so the next frame must be above this one */
+    next_p = (void **)frame_p[0];
+    if (next_p <= frame_p
+	|| (char *)next_p - (char *)frame_p > STACK_FRAME_MAX
+	|| (PNT_ARITH_TYPE)next_p % STACK_FRAME_ALIGN != 0) {
+      break;
+    }
+    frame_p = next_p;
+  }
+  
+  if (! found_b) {
+    addrs[0] = (void *)caller;
+    addr_c = 1;
+  }
+  
+  return addr_c;
+#else
+  if (caller == NULL) {
+    return 0;
+  }
+  addrs[0] = (void *)caller;
+  return 1;
+#endif
+}
+
+/*
+ * static unsigned int hash_addrs
+ *
+ * Hash an array of return-addresses.
+ *
+ * Returns the hash value.
+ *
+ * ARGUMENTS:
+ *
+ * addrs -> Array of the return-addresses.
+ *
+ * addr_n -> Number of addresses in the array.
+ */
+static	unsigned int	hash_addrs(void * const *addrs, const int addr_n)
+{
+  PNT_ARITH_TYPE	hash = 0;
+  int			addr_c;
+  
+  for (addr_c = 0; addr_c < addr_n; addr_c++) {
+    hash = (hash ^ (PNT_ARITH_TYPE)addrs[addr_c]) * 0x9e3779b1;
+    hash ^= hash >> 15;
+  }
+  
+  return (unsigned int)hash;
+}
+
+/*
+ * static int grow_buckets
+ *
+ * Double the number of buckets in the hash table and move the stored
+ * stacks over.  The old buckets are not reused since the heap does not
+ * give back memory.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * admin_cp -> Pointer to the counter of admin blocks which is
+ * increased as we allocate from the heap.
+ */
+static	int	grow_buckets(unsigned long *admin_cp)
+{
+  stack_entry_t	**new_buckets, *entry_p, *next_p;
+  unsigned int	new_n, size, bucket_c, bucket;
+  
+  if (stack_bucket_n == 0) {
+    new_n = STACK_MIN_BUCKETS;
+  }
+  else {
+    new_n = stack_bucket_n * 2;
+  }
+  
+  /* round up to the next block */
+  size = sizeof(*new_buckets) * new_n;
+  size = ((size + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_SIZE;
+  
+  new_buckets = _dmalloc_heap_alloc(size);
+  if (new_buckets == HEAP_ALLOC_ERROR) {
+    /* error code set in _dmalloc_heap_alloc */
+    return 0;
+  }
+  memset(new_buckets, 0, size);
+  *admin_cp += size / BLOCK_SIZE;
+  
+  for (bucket_c = 0; bucket_c < stack_bucket_n; bucket_c++) {
+    for (entry_p = stack_buckets[bucket_c];
+	 entry_p != NULL;
+	 entry_p = next_p) {
+      next_p = entry_p->se_next_p;
+      bucket = entry_p->se_hash & (new_n - 1);
+      entry_p->se_next_p = new_buckets[bucket];
+      new_buckets[bucket] = entry_p;
+    }
+  }
+  
+  stack_buckets = new_buckets;
+  stack_bucket_n = new_n;
+  return 1;
+}
+
+/*
+ * static stack_entry_t *alloc_entry
+ *
+ * Carve a new stack entry out of our admin blocks.
+ *
+ * Returns the entry on success or NULL on failure.
+ *
+ * ARGUMENTS:
+ *
+ * addr_n -> Number of return-addresses to store in the entry.
+ *
+ * admin_cp -> Pointer to the counter of admin blocks which is
+ * increased as we allocate from the heap.
+ */
+static	stack_entry_t	*alloc_entry(const int addr_n,
+				     unsigned long *admin_cp)
+{
+  stack_entry_t	*entry_p;
+  unsigned int	size;
+  
+  size = sizeof(stack_entry_t) + sizeof(void *) * (addr_n - 1);
+  /* keep the entries aligned */
+  size = ((size + sizeof(void *) - 1) / sizeof(void *)) * sizeof(void *);
+  
+  if (stack_free_p == NULL || stack_free_p + size > stack_bounds_p) {
+    stack_free_p = _dmalloc_heap_alloc(BLOCK_SIZE);
+    if (stack_free_p == HEAP_ALLOC_ERROR) {
+      /* error code set in _dmalloc_heap_alloc */
+      stack_free_p = NULL;
+      return NULL;
+    }
+    stack_bounds_p = stack_free_p + BLOCK_SIZE;
+    (*admin_cp)++;
+  }
+  
+  entry_p = (stack_entry_t *)stack_free_p;
+  stack_free_p += size;
+  return entry_p;
+}
+
+#endif /* LOG_PNT_STACK_DEPTH */
+
+/*
+ * void _dmalloc_stack_set_caller
+ *
+ * Remember the return-address in the user's code that called into
+ * the library so the next recorded stack starts there and not in our
+ * own frames.
+ *
+ * ARGUMENTS:
+ *
+ * caller -> Return-address of the library's caller or NULL to record
+ * the whole stack.
+ */
+void	_dmalloc_stack_set_caller(const void *caller)
+{
+#if LOG_PNT_STACK_DEPTH
+  stack_caller = caller;
+#endif
+}
+
+/*
+ * const stack_entry_t *_dmalloc_stack_get
+ *
+ * Record the call stack of the caller and find or store it in the
+ * stack table.
+ *
+ * Returns the stored stack which stays valid for the life of the
+ * program or NULL if the stack could not be recorded.
+ *
+ * ARGUMENTS:
+ *
+ * admin_cp -> Pointer to the counter of admin blocks which is
+ * increased as we allocate from the heap.
+ */
+const stack_entry_t	*_dmalloc_stack_get(unsigned long *admin_cp)
+{
+#if LOG_PNT_STACK_DEPTH
+  void		*addrs[LOG_PNT_STACK_DEPTH];
+  stack_entry_t	*entry_p;
+  unsigned int	hash;
+  int		addr_n;
+  
+  addr_n = unwind(addrs, LOG_PNT_STACK_DEPTH, stack_caller);
+  if (addr_n == 0) {
+    return NULL;
+  }
+  hash = hash_addrs(addrs, addr_n);
+  
+  /* have we seen this stack before? */
+  if (stack_bucket_n > 0) {
+    for (entry_p = stack_buckets[hash & (stack_bucket_n - 1)];
+	 entry_p != NULL;
+	 entry_p = entry_p->se_next_p) {
+      if (entry_p->se_hash == hash
+	  && entry_p->se_depth == (unsigned int)addr_n
+	  && memcmp(entry_p->se_addrs, addrs, sizeof(void *) * addr_n) == 0) {
+	return entry_p;
+      }
+    }
+  }
+  
+  /* keep the chains short */
+  if (stack_entry_c >= stack_bucket_n) {
+    if (! grow_buckets(admin_cp)) {
+      if (stack_bucket_n == 0) {
+	return NULL;
+      }
+    }
+  }
+  
+  entry_p = alloc_entry(addr_n, admin_cp);
+  if (entry_p == NULL) {
+    return NULL;
+  }
+  entry_p->se_hash = hash;
+  entry_p->se_depth = addr_n;
+  memcpy(entry_p->se_addrs, addrs, sizeof(void *) * addr_n);
+  
+  entry_p->se_next_p = stack_buckets[hash & (stack_bucket_n - 1)];
+  stack_buckets[hash & (stack_bucket_n - 1)] = entry_p;
+  stack_entry_c++;
+  
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
+    dmalloc_message("recorded new call stack %p of depth %d",
+		    entry_p, addr_n);
+  }
+  
+  return entry_p;
+#else
+  return NULL;
+#endif
+}
+
+/*
+ * char *_dmalloc_stack_desc
+ *
+ * Write into a buffer a description of a stored call stack.
+ *
+ * Returns a pointer to the buffer.
+ *
+ * ARGUMENTS:
+ *
+ * buf -> Buffer to be passed back to caller.
+ *
+ * buf_size -> Size of the buffer.
+ *
+ * stack_p -> Stored stack we are describing.
+ */
+char	*_dmalloc_stack_desc(char *buf, const int buf_size,
+			     const stack_entry_t *stack_p)
+{
+  char		*buf_p, *bounds_p;
+  unsigned int	addr_c;
+  
+  buf_p = buf;
+  bounds_p = buf + buf_size;
+  
+  buf_p = append_string(buf_p, bounds_p, "stack");
+  for (addr_c = 0; addr_c < stack_p->se_depth; addr_c++) {
+    buf_p = append_format(buf_p, bounds_p, " %p", stack_p->se_addrs[addr_c]);
+  }
+  append_null(buf_p, bounds_p);
+  
+  return buf;
+}
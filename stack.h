@@ -0,0 +1,113 @@
+/*
+ * Defines for the call stack table.
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via http://dmalloc.com/
+ */
+
+
+#ifndef __STACK_H__
+#define __STACK_H__
+
+/*
+ * A call stack recorded with an allocation.  The stacks are kept in
+ * a hash table so each distinct stack is only stored once and its
+ * address can be used as the stack-id.
+ */
+typedef struct stack_entry_st {
+  struct stack_entry_st	*se_next_p;		/* next in the hash bucket */
+  unsigned int		se_hash;		/* hash of the addresses */
+  unsigned int		se_depth;		/* number of addresses */
+  /* this will extend past the end of the structure for se_depth */
+  void			*se_addrs[1];		/* the return-addresses */
+} stack_entry_t;
+
+/* smallest number of buckets in the stack hash table, power of 2 */
+#define STACK_MIN_BUCKETS	1024
+
+/*
+ * Most frames of our own that we walk past looking for the caller of
+ * the library before we give up and record the caller by itself.
+ */
+#define STACK_SKIP_MAX		16
+
+/* frame pointers are kept aligned to this by the calling convention */
+#if defined(__x86_64__)
+#define STACK_FRAME_ALIGN	(sizeof(void *) * 2)
+#else
+#define STACK_FRAME_ALIGN	sizeof(void *)
+#endif
+
+/* size of the buffer needed to describe a stack */
+#define STACK_DESC_SIZE		(LOG_PNT_STACK_DEPTH * 24 + 16)
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * void _dmalloc_stack_set_caller
+ *
+ * Remember the return-address in the user's code that called into
+ * the library so the next recorded stack starts there and not in our
+ * own frames.
+ *
+ * ARGUMENTS:
+ *
+ * caller -> Return-address of the library's caller or NULL to record
+ * the whole stack.
+ */
+extern
+void	_dmalloc_stack_set_caller(const void *caller);
+
+/*
+ * const stack_entry_t *_dmalloc_stack_get
+ *
+ * Record the call stack of the caller and find or store it in the
+ * stack table.
+ *
+ * Returns the stored stack which stays valid for the life of the
+ * program or NULL if the stack could not be recorded.
+ *
+ * ARGUMENTS:
+ *
+ * admin_cp -> Pointer to the counter of admin blocks which is
+ * increased as we allocate from the heap.
+ */
+extern
+const stack_entry_t	*_dmalloc_stack_get(unsigned long *admin_cp);
+
+/*
+ * char *_dmalloc_stack_desc
+ *
+ * Write into a buffer a description of a stored call stack.
+ *
+ * Returns a pointer to the buffer.
+ *
+ * ARGUMENTS:
+ *
+ * buf -> Buffer to be passed back to caller.
+ *
+ * buf_size -> Size of the buffer.
+ *
+ * stack_p -> Stored stack we are describing.
+ */
+extern
+char	*_dmalloc_stack_desc(char *buf, const int buf_size,
+			     const stack_entry_t *stack_p);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __STACK_H__ */
@@ -0,0 +1,242 @@
+/*
+ * Live statistics page routines
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via http://dmalloc.com/
+ */
+
+/*
+ * This file contains the routines which publish the heap statistics
+ * into a named shared-memory page and which let the dmalloc utility
+ * attach to the page of another process.  Monitoring programs can
+ * sample the page without asking the process to log anything.
+ */
+
+#include <fcntl.h>				/* for O_RDWR, etc. */
+
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for getpid, ftruncate */
+#endif
+#if HAVE_SYS_TYPES_H
+# include <sys/types.h>
+#endif
+#if HAVE_SYS_MMAN_H
+# include <sys/mman.h>				/* for mmap stuff */
+#endif
+
+#define DMALLOC_DISABLE
+
+#include "conf.h"
+#include "dmalloc.h"
+
+#include "append.h"
+#include "compat.h"
+#include "dmalloc_loc.h"
+#include "stats.h"
+
+/* path of the page we published, so we can remove it later */
+static	char	stats_path[128] = { '\0' };
+
+/*
+ * static void build_path
+ *
+ * Build the path of the statistics page of a process.
+ *
+ * ARGUMENTS:
+ *
+ * buf <- Buffer which will be set to the path.
+ *
+ * buf_size -> Size of the buffer.
+ *
+ * pid -> Process-id whose page we want.
+ */
+static	void	build_path(char *buf, const int buf_size, const int pid)
+{
+  (void)loc_snprintf(buf, buf_size, STATS_EXPORT_PATH, pid);
+}
+
+/*
+ * stats_page_t *_dmalloc_stats_create
+ *
+ * Create and map the shared statistics page for this process.
+ *
+ * Returns the mapped page or NULL on error.
+ */
+stats_page_t	*_dmalloc_stats_create(void)
+{
+#if HAVE_MMAP && HAVE_GETPID
+  stats_page_t	*page_p;
+  void		*mem;
+  int		fd;
+  
+  build_path(stats_path, sizeof(stats_path), getpid());
+  
+  fd = open(stats_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    stats_path[0] = '\0';
+    return NULL;
+  }
+  if (ftruncate(fd, sizeof(stats_page_t)) != 0) {
+    (void)close(fd);
+    (void)unlink(stats_path);
+    stats_path[0] = '\0';
+    return NULL;
+  }
+  
+  mem = mmap(0L, sizeof(stats_page_t), PROT_READ | PROT_WRITE, MAP_SHARED,
+	     fd, 0 /* no offset */);
+  /* the mapping keeps the page alive after the close */
+  (void)close(fd);
+  if (mem == MAP_FAILED) {
+    (void)unlink(stats_path);
+    stats_path[0] = '\0';
+    return NULL;
+  }
+  
+  page_p = (stats_page_t *)mem;
+  page_p->sp_pid = getpid();
+  page_p->sp_version = STATS_PAGE_VERSION;
+  page_p->sp_seq = 0;
+  /* the magic goes last so readers never see a half-initialized page */
+  STATS_BARRIER();
+  page_p->sp_magic = STATS_PAGE_MAGIC;
+  
+  return page_p;
+#else
+  return NULL;
+#endif
+}
+
+/*
+ * void _dmalloc_stats_remove
+ *
+ * Remove the name of the shared statistics page so it does not
+ * outlive the process.  The mapping itself stays valid.
+ */
+void	_dmalloc_stats_remove(void)
+{
+  if (stats_path[0] != '\0') {
+    (void)unlink(stats_path);
+    stats_path[0] = '\0';
+  }
+}
+
+/*
+ * void _dmalloc_stats_forget
+ *
+ * Let go of the statistics page in a forked child.  The page and its
+ * name belong to the parent so we unmap it without removing it and
+ * the child publishes its own page the next time.
+ *
+ * ARGUMENTS:
+ *
+ * page_p -> Page which we had mapped or NULL if none.
+ */
+void	_dmalloc_stats_forget(stats_page_t *page_p)
+{
+#if HAVE_MMAP
+  if (page_p != NULL) {
+    (void)munmap((void *)page_p, sizeof(stats_page_t));
+  }
+#endif
+  stats_path[0] = '\0';
+}
+
+/*
+ * const stats_page_t *_dmalloc_stats_attach
+ *
+ * Attach read-only to the statistics page published by another
+ * process.
+ *
+ * Returns the mapped page or NULL on error.
+ *
+ * ARGUMENTS:
+ *
+ * pid -> Process-id of the process publishing the page.
+ */
+const stats_page_t	*_dmalloc_stats_attach(const int pid)
+{
+#if HAVE_MMAP
+  const stats_page_t	*page_p;
+  char			path[128];
+  void			*mem;
+  int			fd;
+  
+  build_path(path, sizeof(path), pid);
+  
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  
+  mem = mmap(0L, sizeof(stats_page_t), PROT_READ, MAP_SHARED, fd,
+	     0 /* no offset */);
+  (void)close(fd);
+  if (mem == MAP_FAILED) {
+    return NULL;
+  }
+  
+  page_p = (const stats_page_t *)mem;
+  if (page_p->sp_magic != STATS_PAGE_MAGIC
+      || page_p->sp_version != STATS_PAGE_VERSION) {
+    (void)munmap(mem, sizeof(stats_page_t));
+    return NULL;
+  }
+  
+  return page_p;
+#else
+  return NULL;
+#endif
+}
+
+/*
+ * int _dmalloc_stats_read
+ *
+ * Take a consistent copy of a statistics page.
+ *
+ * Returns 1 on success or 0 if the writer kept changing the page.
+ *
+ * ARGUMENTS:
+ *
+ * page_p -> Attached statistics page.
+ *
+ * copy_p <- Pointer to a stats_page_t which will be set to the copy.
+ */
+int	_dmalloc_stats_read(const stats_page_t *page_p, stats_page_t *copy_p)
+{
+  unsigned long	seq;
+  int		try_c;
+  
+  for (try_c = 0; try_c < STATS_READ_RETRIES; try_c++) {
+    seq = page_p->sp_seq;
+    if (seq % 2 == 1) {
+      /* the writer is in the middle of an update */
+      continue;
+    }
+    STATS_BARRIER();
+    memcpy(copy_p, (const void *)page_p, sizeof(*copy_p));
+    STATS_BARRIER();
+    if (page_p->sp_seq == seq) {
+      return 1;
+    }
+  }
+  
+  return 0;
+}
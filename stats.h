@@ -0,0 +1,168 @@
+/*
+ * Defines for the live statistics page.
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via http://dmalloc.com/
+ */
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+/* magic number and layout version at the top of the page */
+#define STATS_PAGE_MAGIC	0x0dea110cL
+#define STATS_PAGE_VERSION	1
+
+/* number of times a reader retries a torn copy before giving up */
+#define STATS_READ_RETRIES	1000
+
+/*
+ * Memory barrier used around the sequence counter.  The writer is
+ * always serialized by the library so we only need to order the
+ * stores against the readers in other processes.
+ */
+#ifdef __GNUC__
+#define STATS_BARRIER()		__sync_synchronize()
+#else
+#define STATS_BARRIER()
+#endif
+
+/*
+ * Layout of the shared statistics page.  The library is the only
+ * writer and bumps sp_seq to odd before it updates the fields and
+ * back to even afterwards.  Readers copy the page and retry if the
+ * sequence was odd or changed underneath them.
+ */
+typedef struct {
+  unsigned long		sp_magic;		/* STATS_PAGE_MAGIC */
+  unsigned long		sp_version;		/* STATS_PAGE_VERSION */
+  unsigned long		sp_pid;			/* process publishing */
+  volatile unsigned long sp_seq;		/* odd while being updated */
+
+  unsigned long		sp_iter_c;		/* library iteration count */
+
+  /* memory stats */
+  unsigned long		sp_alloc_current;	/* current memory usage */
+  unsigned long		sp_alloc_maximum;	/* maximum memory usage */
+  unsigned long		sp_alloc_total;		/* total memory allocated */
+  unsigned long		sp_alloc_one_max;	/* maximum at once */
+  unsigned long		sp_free_space_bytes;	/* free bytes in the heap */
+
+  /* pointer stats */
+  unsigned long		sp_alloc_cur_pnts;	/* current pointers */
+  unsigned long		sp_alloc_max_pnts;	/* maximum pointers */
+  unsigned long		sp_alloc_tot_pnts;	/* total pointers */
+
+  /* admin counts */
+  unsigned long		sp_heap_check_c;	/* count of heap-checks */
+  unsigned long		sp_user_block_c;	/* count of blocks */
+  unsigned long		sp_admin_block_c;	/* count of admin blocks */
+
+  /* alloc counts */
+  unsigned long		sp_func_malloc_c;	/* count the mallocs */
+  unsigned long		sp_func_calloc_c;	/* count the callocs */
+  unsigned long		sp_func_realloc_c;	/* count the reallocs */
+  unsigned long		sp_func_recalloc_c;	/* count the recallocs */
+  unsigned long		sp_func_memalign_c;	/* count the memaligns */
+  unsigned long		sp_func_valloc_c;	/* count the vallocs */
+  unsigned long		sp_func_new_c;		/* count the news */
+  unsigned long		sp_func_free_c;		/* count the frees */
+  unsigned long		sp_func_delete_c;	/* count the deletes */
+} stats_page_t;
+
+/*
+ * Bracket the updates of the page fields.
+ */
+#define STATS_WRITE_BEGIN(page_p) \
+	do { \
+	  (page_p)->sp_seq++; \
+	  STATS_BARRIER(); \
+	} while(0)
+#define STATS_WRITE_END(page_p) \
+	do { \
+	  STATS_BARRIER(); \
+	  (page_p)->sp_seq++; \
+	} while(0)
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * stats_page_t *_dmalloc_stats_create
+ *
+ * Create and map the shared statistics page for this process.
+ *
+ * Returns the mapped page or NULL on error.
+ */
+extern
+stats_page_t	*_dmalloc_stats_create(void);
+
+/*
+ * void _dmalloc_stats_remove
+ *
+ * Remove the name of the shared statistics page so it does not
+ * outlive the process.  The mapping itself stays valid.
+ */
+extern
+void	_dmalloc_stats_remove(void);
+
+/*
+ * void _dmalloc_stats_forget
+ *
+ * Let go of the statistics page in a forked child.  The page and its
+ * name belong to the parent so we unmap it without removing it and
+ * the child publishes its own page the next time.
+ *
+ * ARGUMENTS:
+ *
+ * page_p -> Page which we had mapped or NULL if none.
+ */
+extern
+void	_dmalloc_stats_forget(stats_page_t *page_p);
+
+/*
+ * const stats_page_t *_dmalloc_stats_attach
+ *
+ * Attach read-only to the statistics page published by another
+ * process.
+ *
+ * Returns the mapped page or NULL on error.
+ *
+ * ARGUMENTS:
+ *
+ * pid -> Process-id of the process publishing the page.
+ */
+extern
+const stats_page_t	*_dmalloc_stats_attach(const int pid);
+
+/*
+ * int _dmalloc_stats_read
+ *
+ * Take a consistent copy of a statistics page.
+ *
+ * Returns 1 on success or 0 if the writer kept changing the page.
+ *
+ * ARGUMENTS:
+ *
+ * page_p -> Attached statistics page.
+ *
+ * copy_p <- Pointer to a stats_page_t which will be set to the copy.
+ */
+extern
+int	_dmalloc_stats_read(const stats_page_t *page_p, stats_page_t *copy_p);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __STATS_H__ */
@@ -37,6 +37,8 @@
 #if HAVE_UNISTD_H
 # include <unistd.h>				/* for _exit */
 #endif
+#include <errno.h>				/* for EINVAL, ENOMEM */
+#include <fcntl.h>				/* for O_WRONLY, etc. */
 
 /*
  * cygwin includes
@@ -93,7 +95,10 @@
 #include "error.h"
 #include "error_val.h"
 #include "heap.h"
+#include "lock.h"
 #include "dmalloc_loc.h"
+#include "stack.h"
+#include "stats.h"
 #include "user_malloc.h"
 #include "return.h"
 
@@ -117,9 +122,8 @@ char		*dmalloc_logpath = NULL;
 
 /* local variables */
 static	int		enabled_b = 0;		/* have we started yet? */
-static	int		in_alloc_b = 0;		/* can't be here twice */
+static	THREAD_LOCAL int in_alloc_b = 0;	/* can't be here twice */
 static	int		do_shutdown_b = 0;	/* execute shutdown soon */
-static	int		memalign_warn_b = 0;	/* memalign warning printed?*/
 static	dmalloc_track_t	tracking_func = NULL;	/* memory trxn tracking func */
 
 /* debug variables */
@@ -127,118 +131,155 @@ static	char		*start_file = NULL;	/* file to start at */
 static	int		start_line = 0;		/* line to start */
 static	unsigned long	start_iter = 0;		/* start after X iterations */
 static	unsigned long	start_size = 0;		/* start after X bytes */
-static	int		thread_lock_c = 0;	/* lock counter */
+static	int		start_check_b = 0;	/* start/interval settings on */
 
-/****************************** thread locking *******************************/
+/* static arena for the allocations made while we are starting up */
+static	char		bootstrap_arena[BOOTSTRAP_ARENA_SIZE];
+static	unsigned long	bootstrap_used = 0;	/* bytes of the arena used */
+static	int		starting_b = 0;		/* in the middle of startup */
 
-#if LOCK_THREADS
-#ifdef THREAD_MUTEX_T
-/*
- * Define a global variable we use as a lock counter.
- *
- * NOTE: we do not use the PTHREAD_MUTEX_INITIALIZER since this
- * basically delays the pthread_mutex_init call to when
- * pthread_mutex_lock is called for the first time (at least on
- * freebsd).  Since we don't want to go recursive into the pthread
- * library when we go to lock our mutex variable, we want to force the
- * initialization to happen beforehand with a call to
- * pthread_mute_init.
- */
-static THREAD_MUTEX_T dmalloc_mutex;
-#else
-#error We need to have THREAD_MUTEX_T defined by the configure script
-#endif
-#endif
+/* is the pointer from the bootstrap arena? */
+#define IS_BOOTSTRAP(pnt)	((char *)(pnt) >= bootstrap_arena \
+				 && (char *)(pnt) < bootstrap_arena \
+				 + sizeof(bootstrap_arena))
+
+/* do any of the start or interval settings need to be processed? */
+#define START_CHECK_NEEDED()	(start_file != NULL || start_iter > 0 \
+				 || start_size > 0 \
+				 || _dmalloc_check_interval > 0)
+
+/****************************** thread locking *******************************/
 
 /*
  * THREADS LOCKING:
  *
  * Because we need to protect for multiple threads making calls into
- * the dmalloc library at the same time, we need to initialize and use
- * a thread mutex variable.  The problem is that most thread libraries
- * uses malloc itself and do not like to go recursive.
- *
- * There are two places where we may have this problem.  One is when
- * we try to use our mutex-lock variable when pthreads is starting up
- * in a shaky state.  The thread library allocates some space, the
- * dmalloc library needs to lock its mutex variable so calls back into
- * the pthread library before it is ready for a call, and a core dump
- * is probably the result.
- *
- * We hopefully solve this by having the dmalloc library not lock
- * during the first couple of memory transactions.  The number is
- * controlled by lock-on dmalloc program environmental setting (set
- * with ``dmalloc -o X'').  You will have to play with the value.  Too
- * many will cause two threads to march into the dmalloc code at the
- * same time generating a DMALLOC_ERROR_IN_TWICE error.  Too few and
- * you will get a core dump in the pthreads initialization code.
- *
- * The second place where we might go recursive is when we go to
- * actually initialize our mutex-lock before we can use it.  The
- * THREAD_INIT_LOCK variable (in settings.h) defines that the
- * initialization happens 2 memory transactions before the library
- * begins to use the mutex (lock-on - 2).  It we waited to initialize
- * the variable right before we used it, the pthread library might
- * want to allocate some memory for the variable causing a recursive
- * call and probably a seg-fault -- at least in OSF.  If people need
- * to have this variable also be runtime configurable or would like to
- * present an alternative default, please let me know.
+ * the dmalloc library at the same time, we need to lock around the
+ * library.  The problem is that most thread libraries use malloc
+ * themselves and do not like to go recursive.  If we used a thread
+ * library mutex then we might call back into the thread library while
+ * it is starting up in a shaky state or it might allocate memory to
+ * initialize the mutex.
+ *
+ * So we use our own lock (see lock.c) which is statically initialized
+ * and is built on atomic operations and the futex system call.  It
+ * never calls into the thread library so it can be used from the very
+ * first allocation.  The lock-on setting which used to delay the
+ * locking is no longer needed and is ignored.
  */
 
 #if LOCK_THREADS
+static	dmalloc_lock_t	dmalloc_lock = LOCK_INITIALIZER;
+static	int		fork_locked_b = 0;	/* fork_prepare took lock */
+
 /*
- * mutex lock the malloc library
+ * lock the malloc library
  */
 static	void	lock_thread(void)
 {
-  /* we only lock if the lock-on counter has reached 0 */
-  if (thread_lock_c == 0) {
-#if HAVE_PTHREAD_MUTEX_LOCK
-    pthread_mutex_lock(&dmalloc_mutex);
-#endif
-  }
+  LOCK_ACQUIRE(&dmalloc_lock);
 }
 
 /*
- * mutex unlock the malloc library
+ * unlock the malloc library
  */
 static	void	unlock_thread(void)
 {
-  /* if the lock-on counter has not reached 0 then count it down */
-  if (thread_lock_c > 0) {
-    thread_lock_c--;
-    /*
-     * As we approach the time when we start mutex locking the
-     * library, we need to init the mutex variable.  This sets how
-     * many times before we start locking should we init the variable
-     * taking in account that the init itself might generate a call
-     * into the library.  Ugh.
-     */
-    if (thread_lock_c == THREAD_INIT_LOCK) {
-#if HAVE_PTHREAD_MUTEX_INIT
-      /*
-       * NOTE: we do not use the PTHREAD_MUTEX_INITIALIZER since this
-       * basically delays the pthread_mutex_init call to when
-       * pthread_mutex_lock is called for the first time (at least on
-       * freebsd).  Since we don't want to go recursive into the
-       * pthread library when we go to lock our mutex variable, we
-       * want to force the initialization to happen beforehand with a
-       * call to pthread_mute_init.
-       */
-      pthread_mutex_init(&dmalloc_mutex, THREAD_LOCK_INIT_VAL);
+  LOCK_RELEASE(&dmalloc_lock);
+}
 #endif
-    }
+
+#if LOCK_THREADS
+/*
+ * Before a fork, take the library lock so no other thread is in the
+ * middle of changing the heap or writing to the log when the child
+ * gets its copy of them.  If we are forking from inside the library,
+ * such as for the error-dump token, we already hold the lock.
+ */
+static	void	fork_prepare(void)
+{
+  if (in_alloc_b) {
+    fork_locked_b = 0;
   }
-  else if (thread_lock_c == 0) {
-#if HAVE_PTHREAD_MUTEX_UNLOCK
-    pthread_mutex_unlock(&dmalloc_mutex);
-#endif
+  else {
+    lock_thread();
+    fork_locked_b = 1;
+  }
+}
+
+/*
+ * After a fork in the parent, let the other threads back in.
+ */
+static	void	fork_parent(void)
+{
+  if (fork_locked_b) {
+    unlock_thread();
   }
 }
+
+/*
+ * After a fork in the child, only the forking thread is left.  We
+ * start with a fresh lock, let go of the parent's statistics page,
+ * and look up the new process-id once, reopening the log if needed.
+ */
+static	void	fork_child(void)
+{
+  LOCK_RESET(&dmalloc_lock);
+  if (! fork_locked_b) {
+    /* we forked from inside the library which will let go of it */
+    lock_thread();
+  }
+  _dmalloc_chunk_forked();
+  _dmalloc_log_forked();
+}
 #endif
 
 /****************************** local utilities ******************************/
 
+/*
+ * static void *bootstrap_alloc
+ *
+ * Hand out memory from the static bootstrap arena.  This is used when
+ * the library is asked for memory while it is still starting up and
+ * the heap is not ready.  The size of the block is stored in front of
+ * it so it can be copied out by realloc.
+ *
+ * Returns the block or NULL if the arena is used up.
+ *
+ * ARGUMENTS:
+ *
+ * size -> Number of bytes requested.
+ *
+ * alignment -> Alignment of the block or 0 for the default.
+ */
+static	void	*bootstrap_alloc(const DMALLOC_SIZE size,
+				 const DMALLOC_SIZE alignment)
+{
+  unsigned long	addr, align;
+  
+  if (alignment > ALLOCATION_ALIGNMENT) {
+    align = alignment;
+  }
+  else {
+    align = ALLOCATION_ALIGNMENT;
+  }
+  
+  /* leave room for the size in front of the block */
+  addr = (unsigned long)bootstrap_arena + bootstrap_used + sizeof(size);
+  if (addr % align != 0) {
+    addr += align - addr % align;
+  }
+  if (addr + size > (unsigned long)bootstrap_arena + sizeof(bootstrap_arena)) {
+    dmalloc_errno = DMALLOC_ERROR_ALLOC_FAILED;
+    return NULL;
+  }
+  
+  *((DMALLOC_SIZE *)addr - 1) = size;
+  bootstrap_used = addr + size - (unsigned long)bootstrap_arena;
+  
+  return (void *)addr;
+}
+
 /*
  * check out a pointer to see if we were looking for it.  this should
  * be re-entrant and it may not return.
@@ -289,13 +330,15 @@ static	void	process_environ(const char *option_str)
 			   &_dmalloc_check_interval, &_dmalloc_lock_on,
 			   &dmalloc_logpath, &start_file, &start_line,
 			   &start_iter, &start_size, &_dmalloc_memory_limit);
-  thread_lock_c = _dmalloc_lock_on;
   
   /* if we set the start stuff, then check-heap comes on later */
   if (start_iter > 0 || start_size > 0) {
     BIT_CLEAR(_dmalloc_flags, DMALLOC_DEBUG_CHECK_HEAP);
   }
   
+  /* figure out once whether dmalloc_in needs to look at the settings */
+  start_check_b = START_CHECK_NEEDED();
+  
   /* indicate that we should reopen the logfile if we need to */
   if (previous_logpath == 0L || dmalloc_logpath == 0L
       || strcmp(previous_logpath, dmalloc_logpath) != 0) {
@@ -347,6 +390,8 @@ static	int	dmalloc_startup(const char *debug_str)
   if (! some_up_b) {
     /* set this up here so if an error occurs below, it will not try again */
     some_up_b = 1;
+    /* until the heap is ready, allocations come from the bootstrap arena */
+    starting_b = 1;
     
 #if LOG_PNT_TIMEVAL
     GET_TIMEVAL(_dmalloc_start);
@@ -380,21 +425,19 @@ static	int	dmalloc_startup(const char *debug_str)
     
     /* startup heap code */
     if (! _dmalloc_heap_startup()) {
+      starting_b = 0;
       return 0;
     }
     
     /* startup the chunk lower-level code */
     if (! _dmalloc_chunk_startup()) {
+      starting_b = 0;
       return 0;
     }
+    
+    starting_b = 0;
   }
   
-#if LOCK_THREADS
-  if (thread_lock_c > 0) {
-    return 1;
-  }
-#endif
-  
   /*
    * We have initialized all of our code.
    *
@@ -420,6 +463,13 @@ static	int	dmalloc_startup(const char *debug_str)
 #endif /* ! HAVE_ATEXIT */
 #endif /* AUTO_SHUTDOWN */
   
+#if LOCK_THREADS
+  /* quiesce the library for forks so the log doesn't need to check */
+  if (pthread_atfork(fork_prepare, fork_parent, fork_child) == 0) {
+    _dmalloc_atfork_b = 1;
+  }
+#endif
+  
 #if SIGNAL_OKAY
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CATCH_SIGNALS)) {
 #ifdef SIGNAL1
@@ -447,58 +497,21 @@ static	int	dmalloc_startup(const char *debug_str)
 }
 
 /*
- * static int dmalloc_in
- *
- * Call to the alloc routines has been made.  Do some initialization,
- * locking, and check some debug variables.
+ * static void check_start
  *
- * Returns 1 on success or 0 on failure.
+ * Process the start file/line, start iteration, start size, and
+ * check interval settings which turn on the checking of the heap.
+ * Once the start settings have fired and there is no interval, the
+ * settings are turned off so dmalloc_in can skip this call.
  *
  * ARGUMENTS:
  *
  * file -> File-name or return-address of the caller.
  *
  * line -> Line-number of the caller.
- *
- * check_heap_b -> Set to 1 if it is okay to check the heap.  If set
- * to 0 then the caller will check it itself or it is a non-invasive
- * call.
  */
-static	int	dmalloc_in(const char *file, const int line,
-			   const int check_heap_b)
+static	void	check_start(const char *file, const int line)
 {
-  if (_dmalloc_aborting_b) {
-    return 0;
-  }
-  
-  /*
-   * NOTE: we need to do this outside of lock to get env vars
-   * otherwise our _dmalloc_lock_on variable won't be initialized and
-   * the THREAD_LOCK will flip.
-   */
-  if (! enabled_b) {
-    if (! dmalloc_startup(NULL /* no options string */)) {
-      return 0;
-    }
-  }
-  
-#if LOCK_THREADS
-  lock_thread();
-#endif
-  
-  if (in_alloc_b) {
-    dmalloc_errno = DMALLOC_ERROR_IN_TWICE;
-    dmalloc_error("dmalloc_in");
-    /* NOTE: dmalloc_error may die already */
-    _dmalloc_die(0);
-    /*NOTREACHED*/
-  }
-  
-  in_alloc_b = 1;
-  
-  /* increment our interval */
-  _dmalloc_iter_c++;
-  
   /* check start file/line specifications */
   if ((! BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_HEAP))
       && start_file != NULL
@@ -541,6 +554,67 @@ static	int	dmalloc_in(const char *file, const int line,
     }
   }
   
+  /* turn ourselves off once the start settings have all fired */
+  start_check_b = START_CHECK_NEEDED();
+}
+
+/*
+ * static int dmalloc_in
+ *
+ * Call to the alloc routines has been made.  Do some initialization,
+ * locking, and check some debug variables.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * check_heap_b -> Set to 1 if it is okay to check the heap.  If set
+ * to 0 then the caller will check it itself or it is a non-invasive
+ * call.
+ */
+static	int	dmalloc_in(const char *file, const int line,
+			   const int check_heap_b)
+{
+  /* one test for the common case of running and not aborting */
+  if (_dmalloc_aborting_b || (! enabled_b)) {
+    if (_dmalloc_aborting_b) {
+      return 0;
+    }
+    /*
+     * NOTE: we need to do this outside of the lock because atexit
+     * and friends may allocate memory at the end of the startup.
+     */
+    if (! dmalloc_startup(NULL /* no options string */)) {
+      return 0;
+    }
+  }
+  
+#if LOCK_THREADS
+  lock_thread();
+#endif
+  
+  if (in_alloc_b) {
+    dmalloc_errno = DMALLOC_ERROR_IN_TWICE;
+    dmalloc_error("dmalloc_in");
+    /* NOTE: dmalloc_error may die already */
+    _dmalloc_die(0);
+    /*NOTREACHED*/
+  }
+  
+  in_alloc_b = 1;
+  
+  /* increment our interval */
+  _dmalloc_iter_c++;
+  
+  /* most configurations have none of the start or interval settings */
+  if (start_check_b) {
+    check_start(file, line);
+  }
+  
   /* after all that, do we need to check the heap? */
   if (check_heap_b && BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_HEAP)) {
     (void)_dmalloc_chunk_heap_check();
@@ -554,6 +628,15 @@ static	int	dmalloc_in(const char *file, const int line,
  */
 static	void	dmalloc_out(void)
 {
+  /* publish the stats before we let go of the lock */
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_EXPORT_STATS)) {
+    _dmalloc_chunk_export_stats();
+  }
+  /* the caller is only good for the call that set it */
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_STACK)) {
+    _dmalloc_stack_set_caller(NULL);
+  }
+  
   in_alloc_b = 0;
   
 #if LOCK_THREADS
@@ -565,8 +648,115 @@ static	void	dmalloc_out(void)
   }
 }
 
+/*
+ * static int dmalloc_in_read
+ *
+ * Try to come into the library to look at the heap while sharing the
+ * lock with other threads doing the same.  This only works in the
+ * common case where we are running with no start settings, logging of
+ * transactions, or heap check to do.
+ *
+ * Returns 1 if we are in as a reader and must call dmalloc_out_read
+ * or 0 if the caller should come in with dmalloc_in instead.
+ *
+ * ARGUMENTS:
+ *
+ * check_heap_b -> Set to 1 if the caller would have checked the heap
+ * in dmalloc_in.
+ */
+static	int	dmalloc_in_read(const int check_heap_b)
+{
+#if LOCK_THREADS
+  if (_dmalloc_aborting_b || (! enabled_b) || in_alloc_b || start_check_b
+      || do_shutdown_b
+      || BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)
+      || (check_heap_b
+	  && BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_HEAP))) {
+    return 0;
+  }
+  
+  if (! LOCK_READ_TRY(&dmalloc_lock)) {
+    return 0;
+  }
+  
+  in_alloc_b = 1;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/*
+ * static void dmalloc_out_read
+ *
+ * Going out of the library after looking at the heap.
+ *
+ * ARGUMENTS:
+ *
+ * done_b -> Set to 1 if the call is finished in which case we count
+ * the iteration like dmalloc_in would.  Set to 0 if the call will be
+ * made again with dmalloc_in which will count it.
+ */
+static	void	dmalloc_out_read(const int done_b)
+{
+  if (done_b) {
+#if LOCK_THREADS
+    /* other readers may be counting with us but never a writer */
+    (void)__sync_add_and_fetch(&_dmalloc_iter_c, 1);
+#else
+    _dmalloc_iter_c++;
+#endif
+  }
+  
+  in_alloc_b = 0;
+  
+#if LOCK_THREADS
+  LOCK_READ_RELEASE(&dmalloc_lock);
+#endif
+}
+
+/*
+ * static void set_stack_caller
+ *
+ * Tell the stack code where the user called into the library so a
+ * recorded stack does not start in our own frames.  Calls from the
+ * wrappers already pass the user's return-address as the file.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * ret_addr -> Return-address of the library entry point.
+ */
+static	void	set_stack_caller(const char *file, const int line,
+				 const char *ret_addr)
+{
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_STACK)) {
+    if (line == DMALLOC_DEFAULT_LINE && file != DMALLOC_DEFAULT_FILE) {
+      _dmalloc_stack_set_caller(file);
+    }
+    else {
+      _dmalloc_stack_set_caller(ret_addr);
+    }
+  }
+}
+
 /***************************** exported routines *****************************/
 
+/*
+ * int _dmalloc_in_library
+ *
+ * Returns 1 if this thread is already inside of the library.  Wrappers
+ * which can be called from our own code use this so they do not try
+ * to come in twice.
+ */
+int	_dmalloc_in_library(void)
+{
+  return in_alloc_b;
+}
+
 /*
  * void dmalloc_shutdown
  *
@@ -621,6 +811,9 @@ void	dmalloc_shutdown(void)
   /* dump some statistics to the logfile */
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_STATS)) {
     _dmalloc_chunk_log_stats();
+#if LOCK_THREADS
+    _dmalloc_lock_log_stats(&dmalloc_lock);
+#endif
   }
   
   /* report on non-freed pointers */
@@ -634,6 +827,12 @@ void	dmalloc_shutdown(void)
 		       );
   }
   
+  /* the process is going away so don't leave the stats page behind */
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_EXPORT_STATS)) {
+    _dmalloc_chunk_export_stats();
+  }
+  _dmalloc_stats_remove();
+  
 #if LOG_PNT_TIMEVAL
   {
     TIMEVAL_TYPE	now;
@@ -656,6 +855,9 @@ void	dmalloc_shutdown(void)
 #endif
 #endif
   
+  /* make sure the messages are all in the logfile */
+  _dmalloc_sync_log();
+  
   in_alloc_b = 0;
   
 #if LOCK_THREADS
@@ -711,6 +913,9 @@ DMALLOC_PNT	dmalloc_malloc(const char *file, const int line,
 {
   void		*new_p;
   DMALLOC_SIZE	align;
+  const char	*ret_addr;
+  
+  GET_RET_ADDR(ret_addr);
   
 #if DMALLOC_SIZE_UNSIGNED == 0
   if (size < 0) {
@@ -723,12 +928,32 @@ DMALLOC_PNT	dmalloc_malloc(const char *file, const int line,
   }
 #endif
   
+#if LARGEST_ALIGNMENT
+  if (alignment > LARGEST_ALIGNMENT) {
+    dmalloc_errno = DMALLOC_ERROR_BAD_SIZE;
+    dmalloc_error("malloc");
+    if (tracking_func != NULL) {
+      tracking_func(file, line, func_id, size, alignment, NULL, NULL);
+    }
+    return MALLOC_ERROR;
+  }
+#endif
+  
+  /* recursive calls from our startup get memory from the arena */
+  if (starting_b) {
+    if (func_id == DMALLOC_FUNC_VALLOC && alignment == 0) {
+      return bootstrap_alloc(size, BLOCK_SIZE);
+    }
+    return bootstrap_alloc(size, alignment);
+  }
+  
   if (! dmalloc_in(file, line, 1)) {
     if (tracking_func != NULL) {
       tracking_func(file, line, func_id, size, alignment, NULL, NULL);
     }
     return MALLOC_ERROR;
   }
+  set_stack_caller(file, line, ret_addr);
   
   if (alignment == 0) {
     if (func_id == DMALLOC_FUNC_VALLOC) {
@@ -738,25 +963,18 @@ DMALLOC_PNT	dmalloc_malloc(const char *file, const int line,
       align = 0;
     }
   }
-  else if (alignment >= BLOCK_SIZE) {
-    align = BLOCK_SIZE;
+  else if (alignment <= ALLOCATION_ALIGNMENT) {
+    /* every chunk is already aligned this well */
+    align = 0;
   }
   else {
-    /*
-     * NOTE: Currently, there is no support in the library for
-     * memalign on less than block boundaries.  It will be non-trivial
-     * to support valloc with fence-post checking and the lack of the
-     * flag width for dblock allocations.
-     */
-    if (! memalign_warn_b) {
-      dmalloc_message("WARNING: memalign called without library support");
-      memalign_warn_b = 1;
+    /* round odd alignments up to the next power of two */
+    for (align = ALLOCATION_ALIGNMENT; align < alignment; align *= 2) {
     }
-    align = 0;
-    /* align = alignment */
   }
   
-  new_p = _dmalloc_chunk_malloc(file, line, size, func_id, align);
+  new_p = _dmalloc_chunk_malloc(file, line, size, func_id, align,
+				0 /* no region */);
   
   check_pnt(file, line, new_p, "malloc");
   
@@ -808,6 +1026,9 @@ DMALLOC_PNT	dmalloc_realloc(const char *file, const int line,
 				const int func_id, const int xalloc_b)
 {
   void		*new_p;
+  const char	*ret_addr;
+  
+  GET_RET_ADDR(ret_addr);
   
 #if DMALLOC_SIZE_UNSIGNED == 0
   if (new_size < 0) {
@@ -820,12 +1041,35 @@ DMALLOC_PNT	dmalloc_realloc(const char *file, const int line,
   }
 #endif
   
+  /*
+   * Arena blocks are never resized in place.  We copy them out into a
+   * new block which comes from the arena if we are still starting up
+   * or otherwise from the heap.
+   */
+  if (starting_b || (old_pnt != NULL && IS_BOOTSTRAP(old_pnt))) {
+    DMALLOC_SIZE	old_size;
+    
+    if (starting_b) {
+      new_p = bootstrap_alloc(new_size, 0 /* no alignment */);
+    }
+    else {
+      new_p = dmalloc_malloc(file, line, new_size, DMALLOC_FUNC_MALLOC,
+			     0 /* no alignment */, xalloc_b);
+    }
+    if (new_p != NULL && old_pnt != NULL) {
+      old_size = *((DMALLOC_SIZE *)old_pnt - 1);
+      memcpy(new_p, old_pnt, (old_size < new_size ? old_size : new_size));
+    }
+    return new_p;
+  }
+  
   if (! dmalloc_in(file, line, 1)) {
     if (tracking_func != NULL) {
       tracking_func(file, line, func_id, new_size, 0, old_pnt, NULL);
     }
     return REALLOC_ERROR;
   }
+  set_stack_caller(file, line, ret_addr);
   
   check_pnt(file, line, old_pnt, "realloc-in");
   
@@ -839,7 +1083,8 @@ DMALLOC_PNT	dmalloc_realloc(const char *file, const int line,
     else {
       new_func_id = DMALLOC_FUNC_MALLOC;
     }
-    new_p = _dmalloc_chunk_malloc(file, line, new_size, new_func_id, 0);
+    new_p = _dmalloc_chunk_malloc(file, line, new_size, new_func_id,
+				  0 /* no align */, 0 /* no region */);
   }
   else
 #endif
@@ -850,7 +1095,8 @@ DMALLOC_PNT	dmalloc_realloc(const char *file, const int line,
        * Froehlich for patiently pointing that the realloc in just
        * about every Unix has this functionality.
        */
-      (void)_dmalloc_chunk_free(file, line, old_pnt, func_id);
+      (void)_dmalloc_chunk_free(file, line, old_pnt, func_id,
+				0 /* no size */, 0);
       new_p = NULL;
     }
     else
@@ -864,30 +1110,371 @@ DMALLOC_PNT	dmalloc_realloc(const char *file, const int line,
   dmalloc_out();
   
   if (tracking_func != NULL) {
-    tracking_func(file, line, func_id, new_size, 0, old_pnt, new_p);
-  }
-  
-  if (xalloc_b && new_p == NULL) {
-    char	desc[128];
-    loc_dprintf(STDERR,
-		"Out of memory while reallocating %d bytes from '%s'\n",
-		new_size, _dmalloc_chunk_desc_pnt(desc, sizeof(desc),
-						  file, line));
-    _exit(1);
+    tracking_func(file, line, func_id, new_size, 0, old_pnt, new_p);
+  }
+  
+  if (xalloc_b && new_p == NULL) {
+    char	desc[128];
+    loc_dprintf(STDERR,
+		"Out of memory while reallocating %d bytes from '%s'\n",
+		new_size, _dmalloc_chunk_desc_pnt(desc, sizeof(desc),
+						  file, line));
+    _exit(1);
+  }
+  
+  return new_p;
+}
+
+/*
+ * int dmalloc_free
+ *
+ * Release a pointer back into the heap.
+ *
+ * Returns FREE_NOERROR on success or FREE_ERROR on failure.
+ *
+ * Note: many operating systems define free to return (void) so this
+ * return value may be filtered.  Dumb.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * pnt -> Existing pointer we are freeing.
+ *
+ * func_id -> Function-id to identify the type of call.  See
+ * dmalloc.h.
+ */
+int	dmalloc_free(const char *file, const int line, DMALLOC_PNT pnt,
+		     const int func_id)
+{
+  int		ret;
+  
+  /* arena blocks are never given back */
+  if (pnt != NULL && IS_BOOTSTRAP(pnt)) {
+    return FREE_NOERROR;
+  }
+  
+  if (! dmalloc_in(file, line, 1)) {
+    if (tracking_func != NULL) {
+      tracking_func(file, line, func_id, 0, 0, pnt, NULL);
+    }
+    return FREE_ERROR;
+  }
+  
+  check_pnt(file, line, pnt, "free");
+  
+  ret = _dmalloc_chunk_free(file, line, pnt, func_id, 0 /* no size */, 0);
+  
+  dmalloc_out();
+  
+  if (tracking_func != NULL) {
+    tracking_func(file, line, DMALLOC_FUNC_FREE, 0, 0, pnt, NULL);
+  }
+  
+  return ret;
+}
+
+/*
+ * int dmalloc_free_sized
+ *
+ * Release a pointer back into the heap when the caller knows its
+ * size such as with the C++ sized delete operators.  An error is
+ * generated if the size does not match the size allocated or, if the
+ * pointer was grown in place, if it is larger than the usable size.
+ *
+ * Returns FREE_NOERROR on success or FREE_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * pnt -> Existing pointer we are freeing.
+ *
+ * size -> Size of the pointer as the caller knows it.
+ *
+ * func_id -> Function-id to identify the type of call.  See
+ * dmalloc.h.
+ */
+int	dmalloc_free_sized(const char *file, const int line, DMALLOC_PNT pnt,
+			   const DMALLOC_SIZE size, const int func_id)
+{
+  int		ret;
+  
+  /* arena blocks are never given back */
+  if (pnt != NULL && IS_BOOTSTRAP(pnt)) {
+    return FREE_NOERROR;
+  }
+  
+  if (! dmalloc_in(file, line, 1)) {
+    if (tracking_func != NULL) {
+      tracking_func(file, line, func_id, size, 0, pnt, NULL);
+    }
+    return FREE_ERROR;
+  }
+  
+  check_pnt(file, line, pnt, "free");
+  
+  ret = _dmalloc_chunk_free(file, line, pnt, func_id, 1 /* have size */,
+			    size);
+  
+  dmalloc_out();
+  
+  if (tracking_func != NULL) {
+    tracking_func(file, line, func_id, size, 0, pnt, NULL);
+  }
+  
+  return ret;
+}
+
+/*
+ * int dmalloc_malloc_batch
+ *
+ * Allocate a number of memory blocks of the same size while only
+ * entering the library once.  This saves the locking, heap checking,
+ * and other per-call overhead of a malloc for each of them.  Each
+ * block still gets its own fence-posts and blanking.
+ *
+ * Returns DMALLOC_NOERROR on success or DMALLOC_ERROR on failure in
+ * which case none of the blocks are allocated.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * pnt_n -> Number of blocks to allocate.
+ *
+ * size -> Number of bytes requested for each block.
+ *
+ * pnts <- Array of pnt_n pointers which will be set to the new blocks
+ * or to NULL on failure.
+ */
+int	dmalloc_malloc_batch(const char *file, const int line,
+			     const int pnt_n, const DMALLOC_SIZE size,
+			     DMALLOC_PNT *pnts)
+{
+  int		pnt_c, loop_c, ret = DMALLOC_NOERROR;
+  const char	*ret_addr;
+  
+  GET_RET_ADDR(ret_addr);
+  
+  if (! dmalloc_in(file, line, 1)) {
+    for (pnt_c = 0; pnt_c < pnt_n; pnt_c++) {
+      pnts[pnt_c] = NULL;
+    }
+    return DMALLOC_ERROR;
+  }
+  set_stack_caller(file, line, ret_addr);
+  
+  for (pnt_c = 0; pnt_c < pnt_n; pnt_c++) {
+    pnts[pnt_c] = _dmalloc_chunk_malloc(file, line, size, DMALLOC_FUNC_MALLOC,
+					0 /* no alignment */,
+					0 /* no region */);
+    if (pnts[pnt_c] == MALLOC_ERROR) {
+      break;
+    }
+    check_pnt(file, line, pnts[pnt_c], "malloc");
+  }
+  
+  /* if we could not get all of them then give back the ones we got */
+  if (pnt_c < pnt_n) {
+    ret = DMALLOC_ERROR;
+    for (loop_c = 0; loop_c < pnt_c; loop_c++) {
+      (void)_dmalloc_chunk_free(file, line, pnts[loop_c], DMALLOC_FUNC_FREE,
+				0 /* no size */, 0);
+    }
+    for (loop_c = 0; loop_c < pnt_n; loop_c++) {
+      pnts[loop_c] = NULL;
+    }
+  }
+  
+  dmalloc_out();
+  
+  if (tracking_func != NULL) {
+    for (loop_c = 0; loop_c < pnt_n; loop_c++) {
+      tracking_func(file, line, DMALLOC_FUNC_MALLOC, size, 0, NULL,
+		    pnts[loop_c]);
+    }
+  }
+  
+  return ret;
+}
+
+/*
+ * int dmalloc_free_batch
+ *
+ * Release a number of pointers back into the heap while only
+ * entering the library once.  All of the pointers are freed even if
+ * some of them generate errors.
+ *
+ * Returns FREE_NOERROR on success or FREE_ERROR if any of the frees
+ * failed.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * pnt_n -> Number of pointers to free.
+ *
+ * pnts -> Array of pnt_n pointers we are freeing.
+ */
+int	dmalloc_free_batch(const char *file, const int line, const int pnt_n,
+			   DMALLOC_PNT *pnts)
+{
+  int	pnt_c, ret = FREE_NOERROR;
+  
+  if (! dmalloc_in(file, line, 1)) {
+    if (tracking_func != NULL) {
+      for (pnt_c = 0; pnt_c < pnt_n; pnt_c++) {
+	tracking_func(file, line, DMALLOC_FUNC_FREE, 0, 0, pnts[pnt_c], NULL);
+      }
+    }
+    return FREE_ERROR;
+  }
+  
+  for (pnt_c = 0; pnt_c < pnt_n; pnt_c++) {
+    check_pnt(file, line, pnts[pnt_c], "free");
+    if (_dmalloc_chunk_free(file, line, pnts[pnt_c], DMALLOC_FUNC_FREE,
+			    0 /* no size */, 0) != FREE_NOERROR) {
+      ret = FREE_ERROR;
+    }
+  }
+  
+  dmalloc_out();
+  
+  if (tracking_func != NULL) {
+    for (pnt_c = 0; pnt_c < pnt_n; pnt_c++) {
+      tracking_func(file, line, DMALLOC_FUNC_FREE, 0, 0, pnts[pnt_c], NULL);
+    }
+  }
+  
+  return ret;
+}
+
+/*
+ * int dmalloc_region_create
+ *
+ * Create a new allocation region.  Pointers allocated into a region
+ * with dmalloc_region_alloc can be freed individually or all at once
+ * with dmalloc_region_destroy.
+ *
+ * Returns the region-id on success or 0 on failure.
+ */
+int	dmalloc_region_create(void)
+{
+  int	region;
+  
+  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 0)) {
+    return 0;
+  }
+  
+  region = _dmalloc_chunk_region_create();
+  
+  dmalloc_out();
+  
+  return region;
+}
+
+/*
+ * DMALLOC_PNT dmalloc_region_alloc
+ *
+ * Allocate and return a memory block of a certain size in a region.
+ *
+ * Returns a valid pointer on success or NULL on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * region -> Region-id returned by dmalloc_region_create.
+ *
+ * size -> Number of bytes requested.
+ */
+DMALLOC_PNT	dmalloc_region_alloc(const char *file, const int line,
+				     const int region, const DMALLOC_SIZE size)
+{
+  void		*new_p;
+  const char	*ret_addr;
+  
+  GET_RET_ADDR(ret_addr);
+  
+  if (! dmalloc_in(file, line, 1)) {
+    if (tracking_func != NULL) {
+      tracking_func(file, line, DMALLOC_FUNC_MALLOC, size, 0, NULL, NULL);
+    }
+    return MALLOC_ERROR;
+  }
+  set_stack_caller(file, line, ret_addr);
+  
+  new_p = _dmalloc_chunk_malloc(file, line, size, DMALLOC_FUNC_MALLOC,
+				0 /* no align */, region);
+  
+  check_pnt(file, line, new_p, "malloc");
+  
+  dmalloc_out();
+  
+  if (tracking_func != NULL) {
+    tracking_func(file, line, DMALLOC_FUNC_MALLOC, size, 0, NULL, new_p);
   }
   
   return new_p;
 }
 
 /*
- * int dmalloc_free
+ * int dmalloc_region_destroy
  *
- * Release a pointer back into the heap.
+ * Check and free all of the pointers still allocated in a region in
+ * one pass over the heap and release the region-id.
  *
- * Returns FREE_NOERROR on success or FREE_ERROR on failure.
+ * Returns DMALLOC_NOERROR on success or DMALLOC_ERROR if the region is
+ * unknown or if any of its pointers failed their checks.
  *
- * Note: many operating systems define free to return (void) so this
- * return value may be filtered.  Dumb.
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * region -> Region-id returned by dmalloc_region_create.
+ */
+int	dmalloc_region_destroy(const char *file, const int line,
+			       const int region)
+{
+  int	ret;
+  
+  if (! dmalloc_in(file, line, 1)) {
+    return DMALLOC_ERROR;
+  }
+  
+  ret = _dmalloc_chunk_region_destroy(file, line, region);
+  
+  dmalloc_out();
+  
+  if (ret) {
+    return DMALLOC_NOERROR;
+  }
+  else {
+    return DMALLOC_ERROR;
+  }
+}
+
+/*
+ * int dmalloc_posix_memalign
+ *
+ * Allocate a memory block aligned to a power-of-two boundary in the
+ * manner of posix_memalign(3).
+ *
+ * Returns 0 on success, EINVAL if the alignment is not a power of two
+ * multiple of the pointer size, or ENOMEM if the allocation failed.
  *
  * ARGUMENTS:
  *
@@ -895,34 +1482,106 @@ DMALLOC_PNT	dmalloc_realloc(const char *file, const int line,
  *
  * line -> Line-number of the caller.
  *
- * pnt -> Existing pointer we are freeing.
+ * memptr <- Pointer to a DMALLOC_PNT which, on success, will be set to
+ * the new block.
  *
- * func_id -> Function-id to identify the type of call.  See
- * dmalloc.h.
+ * alignment -> Value to which the allocation must be aligned.
+ *
+ * size -> Number of bytes requested.
  */
-int	dmalloc_free(const char *file, const int line, DMALLOC_PNT pnt,
-		     const int func_id)
+int	dmalloc_posix_memalign(const char *file, const int line,
+			       DMALLOC_PNT *memptr,
+			       const DMALLOC_SIZE alignment,
+			       const DMALLOC_SIZE size)
 {
-  int		ret;
+  DMALLOC_PNT	pnt;
   
-  if (! dmalloc_in(file, line, 1)) {
-    if (tracking_func != NULL) {
-      tracking_func(file, line, func_id, 0, 0, pnt, NULL);
-    }
-    return FREE_ERROR;
+  if (alignment == 0
+      || alignment % sizeof(void *) != 0
+      || (alignment & (alignment - 1)) != 0) {
+    return EINVAL;
   }
   
-  check_pnt(file, line, pnt, "free");
+  pnt = dmalloc_malloc(file, line, size, DMALLOC_FUNC_MEMALIGN, alignment,
+		       0 /* no xalloc messages */);
+  if (pnt == MALLOC_ERROR) {
+    return ENOMEM;
+  }
+  
+  *memptr = pnt;
+  return 0;
+}
+
+/*
+ * DMALLOC_PNT dmalloc_aligned_alloc
+ *
+ * Allocate a memory block aligned to a power-of-two boundary in the
+ * manner of the C11 aligned_alloc(3).
+ *
+ * Returns a valid pointer on success or NULL on failure in which case
+ * errno is set to EINVAL if the alignment is not a power of two.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * alignment -> Value to which the allocation must be aligned.
+ *
+ * size -> Number of bytes requested.
+ */
+DMALLOC_PNT	dmalloc_aligned_alloc(const char *file, const int line,
+				      const DMALLOC_SIZE alignment,
+				      const DMALLOC_SIZE size)
+{
+  if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+    errno = EINVAL;
+    return MALLOC_ERROR;
+  }
   
-  ret = _dmalloc_chunk_free(file, line, pnt, func_id);
+  return dmalloc_malloc(file, line, size, DMALLOC_FUNC_MEMALIGN, alignment,
+			0 /* no xalloc messages */);
+}
+
+/*
+ * int dmalloc_try_expand
+ *
+ * Try to grow an allocation in place into the slack at the end of
+ * its chunk so containers can grow without a realloc copy.  The
+ * pointer never moves.
+ *
+ * Returns 1 if the pointer can now hold new_size bytes or 0 if it
+ * could not be grown in place.
+ *
+ * ARGUMENTS:
+ *
+ * pnt -> Existing pointer we are expanding.
+ *
+ * new_size -> Number of bytes the pointer needs to hold.
+ */
+int	dmalloc_try_expand(DMALLOC_PNT pnt, const DMALLOC_SIZE new_size)
+{
+  char		*file;
+  unsigned long	size;
   
-  dmalloc_out();
+  GET_RET_ADDR(file);
   
-  if (tracking_func != NULL) {
-    tracking_func(file, line, DMALLOC_FUNC_FREE, 0, 0, pnt, NULL);
+  if (pnt == NULL) {
+    return 0;
+  }
+  if (! dmalloc_in(file, DMALLOC_DEFAULT_LINE, 1)) {
+    return 0;
   }
   
-  return ret;
+  check_pnt(file, DMALLOC_DEFAULT_LINE, pnt, "try_expand");
+  
+  size = _dmalloc_chunk_expand(file, DMALLOC_DEFAULT_LINE, pnt, new_size,
+			       0 /* just new-size */);
+  
+  dmalloc_out();
+  
+  return (size > 0);
 }
 
 /*
@@ -1097,8 +1756,7 @@ DMALLOC_PNT	recalloc(DMALLOC_PNT old_pnt, DMALLOC_SIZE new_size)
  * ARGUMENTS:
  *
  * alignment -> Value to which the allocation must be aligned.  This
- * should probably be a multiple of 2 with a maximum value equivalent
- * to the block-size which is often 1k or 4k.
+ * is rounded up to the next power of two.
  *
  * size -> Number of bytes requested.
  */
@@ -1136,6 +1794,100 @@ DMALLOC_PNT	valloc(DMALLOC_SIZE size)
 			BLOCK_SIZE, 0 /* no xalloc messages */);
 }
 
+/*
+ * int posix_memalign
+ *
+ * Overloading the posix_memalign(3) function.  Allocate a memory
+ * block of a certain size which has been aligned to a power-of-two
+ * boundary.
+ *
+ * Returns 0 on success, EINVAL if the alignment is not a power of two
+ * multiple of the pointer size, or ENOMEM if the allocation failed.
+ *
+ * ARGUMENTS:
+ *
+ * memptr <- Pointer to a DMALLOC_PNT which, on success, will be set to
+ * the new block.
+ *
+ * alignment -> Value to which the allocation must be aligned.
+ *
+ * size -> Number of bytes requested.
+ */
+#undef posix_memalign
+int	posix_memalign(DMALLOC_PNT *memptr, DMALLOC_SIZE alignment,
+		       DMALLOC_SIZE size)
+{
+  char	*file;
+  
+  GET_RET_ADDR(file);
+  return dmalloc_posix_memalign(file, DMALLOC_DEFAULT_LINE, memptr, alignment,
+				size);
+}
+
+/*
+ * DMALLOC_PNT aligned_alloc
+ *
+ * Overloading the C11 aligned_alloc(3) function.  Allocate and return
+ * a memory block of a certain size which has been aligned to a
+ * power-of-two boundary.
+ *
+ * Returns a valid pointer on success or NULL on failure.
+ *
+ * ARGUMENTS:
+ *
+ * alignment -> Value to which the allocation must be aligned.  This
+ * must be a power of two.
+ *
+ * size -> Number of bytes requested.
+ */
+#undef aligned_alloc
+DMALLOC_PNT	aligned_alloc(DMALLOC_SIZE alignment, DMALLOC_SIZE size)
+{
+  char	*file;
+  
+  GET_RET_ADDR(file);
+  return dmalloc_aligned_alloc(file, DMALLOC_DEFAULT_LINE, alignment, size);
+}
+
+/*
+ * DMALLOC_SIZE malloc_usable_size
+ *
+ * Overloading the malloc_usable_size(3) function.  Return the number
+ * of bytes that can be used in an allocation.  Any slack at the end of
+ * the chunk is claimed for the pointer and the top fence-post moved
+ * above it so the caller can write all of the returned bytes.
+ *
+ * Returns the usable size of the pointer or 0 on error.
+ *
+ * ARGUMENTS:
+ *
+ * pnt -> Existing pointer we are examining.
+ */
+#undef malloc_usable_size
+DMALLOC_SIZE	malloc_usable_size(DMALLOC_PNT pnt)
+{
+  char		*file;
+  DMALLOC_SIZE	size;
+  
+  GET_RET_ADDR(file);
+  
+  if (pnt == NULL) {
+    return 0;
+  }
+  if (! dmalloc_in(file, DMALLOC_DEFAULT_LINE, 1)) {
+    return 0;
+  }
+  
+  check_pnt(file, DMALLOC_DEFAULT_LINE, pnt, "malloc_usable_size");
+  
+  size = _dmalloc_chunk_expand(file, DMALLOC_DEFAULT_LINE, pnt,
+			       0 /* no min-size */, 1 /* claim the slack */);
+  
+  dmalloc_out();
+  
+  return size;
+}
+
 #ifndef DMALLOC_STRDUP_MACRO
 /*
  * DMALLOC_PNT strdup
@@ -1152,21 +1904,31 @@ DMALLOC_PNT	valloc(DMALLOC_SIZE size)
 #undef strdup
 char	*strdup(const char *string)
 {
-  int	len;
-  char	*buf, *file;
+  dmalloc_range_t	range;
+  int			len = -1;
+  char			*buf, *file;
   
   GET_RET_ADDR(file);
   
   /* check the arguments */
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if (! dmalloc_verify_pnt(file, 0 /* no line */, "strdup", string,
-			     0 /* not exact */, -1)) {
+    range.vr_pnt = string;
+    range.vr_min_size = -1;
+    if (! dmalloc_verify_ranges(file, 0 /* no line */, "strdup",
+				0 /* not exact */, &range, 1)) {
       dmalloc_message("bad pointer argument found in strdup");
     }
+    else {
+      /* the check gives us the length if the string is in the heap */
+      len = range.vr_strlen;
+    }
   }
   
+  if (len < 0) {
+    len = strlen(string);
+  }
   /* len + \0 */
-  len = strlen(string) + 1;
+  len++;
   
   buf = dmalloc_malloc(file, DMALLOC_DEFAULT_LINE, len, DMALLOC_FUNC_STRDUP,
 		       0 /* no alignment */, 0 /* no xalloc messages */);
@@ -1311,6 +2073,18 @@ int	dmalloc_verify(const DMALLOC_PNT pnt)
 {
   int	ret;
   
+  /* a good pointer can be checked while sharing the lock */
+  if (pnt != NULL && dmalloc_in_read(0)) {
+    ret = _dmalloc_chunk_pnt_peek(pnt, 1 /* exact pointer */,
+				  0 /* no strlen */, 0 /* no min size */,
+				  NULL);
+    dmalloc_out_read(ret);
+    if (ret) {
+      return MALLOC_VERIFY_NOERROR;
+    }
+    /* check it again with the lock to report the error */
+  }
+  
   if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 0)) {
     return MALLOC_VERIFY_NOERROR;
   }
@@ -1323,7 +2097,7 @@ int	dmalloc_verify(const DMALLOC_PNT pnt)
   else {
     ret = _dmalloc_chunk_pnt_check("dmalloc_verify", pnt,
 				   1 /* exact pointer */, 0 /* no strlen */,
-				   0 /* no min size */);
+				   0 /* no min size */, NULL);
   }
   
   dmalloc_out();
@@ -1392,12 +2166,23 @@ int	dmalloc_verify_pnt_strsize(const char *file, const int line,
 {
   int	ret;
   
+  /* a good pointer can be checked while sharing the lock */
+  if (dmalloc_in_read(0)) {
+    ret = _dmalloc_chunk_pnt_peek(pnt, exact_b, strlen_b, min_size, NULL);
+    dmalloc_out_read(ret);
+    if (ret) {
+      return MALLOC_VERIFY_NOERROR;
+    }
+    /* check it again with the lock to report the error */
+  }
+  
   if (! dmalloc_in(file, line, 0)) {
     return MALLOC_VERIFY_NOERROR;
   }
   
   /* call the pnt checking chunk code */
-  ret = _dmalloc_chunk_pnt_check(func, pnt, exact_b, strlen_b, min_size);
+  ret = _dmalloc_chunk_pnt_check(func, pnt, exact_b, strlen_b, min_size,
+				 NULL);
   dmalloc_out();
   
   if (ret) {
@@ -1452,6 +2237,94 @@ int	dmalloc_verify_pnt(const char *file, const int line, const char *func,
   }
 }
 
+/*
+ * int dmalloc_verify_ranges
+ *
+ * Verify a number of pointers with a single entry into the library.
+ * This is used by the arg_check.c functions which check a source and
+ * a destination so we only lock and do the start checks once.
+ *
+ * Returns MALLOC_VERIFY_NOERROR on success or MALLOC_VERIFY_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.  You can use
+ * __FILE__ for this argument or 0L for none.
+ *
+ * line -> Line-number of the caller.  You can use __LINE__ for this
+ * argument or 0 for none.
+ *
+ * func -> Function string which is checking the pointers.  0L if none.
+ *
+ * exact_b -> Set to 1 if the pointers were definitely handed back
+ * from a memory allocation.  See dmalloc_verify_pnt.
+ *
+ * ranges <-> Array of pointers and the sizes they need to hold.  The
+ * vr_strlen fields are set by the checks.
+ *
+ * range_n -> Number of entries in the ranges array.
+ */
+int	dmalloc_verify_ranges(const char *file, const int line,
+			      const char *func, const int exact_b,
+			      dmalloc_range_t *ranges, const int range_n)
+{
+  dmalloc_range_t	*range_p, *bounds_p;
+  int			ret = 1;
+  
+  bounds_p = ranges + range_n;
+  for (range_p = ranges; range_p < bounds_p; range_p++) {
+    range_p->vr_strlen = -1;
+  }
+  
+  /* good pointers can be checked while sharing the lock */
+  if (dmalloc_in_read(0)) {
+    for (range_p = ranges; range_p < bounds_p && ret; range_p++) {
+      if (range_p->vr_min_size < 0) {
+	ret = _dmalloc_chunk_pnt_peek(range_p->vr_pnt, exact_b,
+				      1 /* strlen */, 0 /* no min-size */,
+				      &range_p->vr_strlen);
+      }
+      else {
+	ret = _dmalloc_chunk_pnt_peek(range_p->vr_pnt, exact_b,
+				      0 /* no strlen */, range_p->vr_min_size,
+				      NULL);
+      }
+    }
+    dmalloc_out_read(ret);
+    if (ret) {
+      return MALLOC_VERIFY_NOERROR;
+    }
+    /* check them again with the lock to report the error */
+    ret = 1;
+  }
+  
+  if (! dmalloc_in(file, line, 0)) {
+    return MALLOC_VERIFY_NOERROR;
+  }
+  
+  /* stop at the first bad pointer since the error has been logged */
+  for (range_p = ranges; range_p < bounds_p && ret; range_p++) {
+    if (range_p->vr_min_size < 0) {
+      ret = _dmalloc_chunk_pnt_check(func, range_p->vr_pnt, exact_b,
+				     1 /* strlen */, 0 /* no min-size */,
+				     &range_p->vr_strlen);
+    }
+    else {
+      ret = _dmalloc_chunk_pnt_check(func, range_p->vr_pnt, exact_b,
+				     0 /* no strlen */, range_p->vr_min_size,
+				     NULL);
+    }
+  }
+  dmalloc_out();
+  
+  if (ret) {
+    return MALLOC_VERIFY_NOERROR;
+  }
+  else {
+    return MALLOC_VERIFY_ERROR;
+  }
+}
+
 /*
  * unsigned int dmalloc_debug
  *
@@ -1606,17 +2479,32 @@ int	dmalloc_examine(const DMALLOC_PNT pnt, DMALLOC_SIZE *user_size_p,
    * type internally but may use some size_t externally.
    */
   
-  /* need to check the heap here since we are geting info from it below */
-  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 1)) {
-    return DMALLOC_ERROR;
+  /* a good pointer can be looked at while sharing the lock */
+  ret = 0;
+  if (dmalloc_in_read(1)) {
+    if (_dmalloc_chunk_pnt_peek(pnt, 1 /* exact pointer */, 0 /* no strlen */,
+				0 /* no min size */, NULL)) {
+      /* NOTE: this won't log anything since we know the pointer is good */
+      ret = _dmalloc_chunk_read_info(pnt, "dmalloc_examine", &user_size_map,
+				     &tot_size_map, file_p, line_p, ret_attr_p,
+				     &loc_seen_p, used_mark_p, NULL, NULL);
+    }
+    dmalloc_out_read(ret);
   }
   
-  /* NOTE: we do not need the alloc-size info */
-  ret = _dmalloc_chunk_read_info(pnt, "dmalloc_examine", &user_size_map,
-				 &tot_size_map, file_p, line_p, ret_attr_p,
-				 &loc_seen_p, used_mark_p, NULL, NULL);
-  
-  dmalloc_out();
+  if (! ret) {
+    /* need to check the heap here since we are geting info from it below */
+    if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 1)) {
+      return DMALLOC_ERROR;
+    }
+    
+    /* NOTE: we do not need the alloc-size info */
+    ret = _dmalloc_chunk_read_info(pnt, "dmalloc_examine", &user_size_map,
+				   &tot_size_map, file_p, line_p, ret_attr_p,
+				   &loc_seen_p, used_mark_p, NULL, NULL);
+    
+    dmalloc_out();
+  }
   
   if (ret) {
     SET_POINTER(user_size_p, user_size_map);
@@ -1748,6 +2636,9 @@ void	dmalloc_log_stats(void)
   }
   
   _dmalloc_chunk_log_stats();
+#if LOCK_THREADS
+  _dmalloc_lock_log_stats(&dmalloc_lock);
+#endif
   
   dmalloc_out();
 }
@@ -1812,6 +2703,50 @@ void	dmalloc_log_changed(const unsigned long mark, const int not_freed_b,
   dmalloc_out();
 }
 
+/*
+ * int dmalloc_write_snapshot
+ *
+ * Write a binary snapshot of the pointers currently in use to a file.
+ * The dmalloc utility's --snapshot option can summarize a snapshot by
+ * allocation location or compare two of them to find the leaks.
+ *
+ * Returns [DMALLOC_NOERROR or DMALLOC_ERROR].
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the snapshot file to write.
+ */
+int	dmalloc_write_snapshot(const char *path)
+{
+  int	fd, ret;
+  
+  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 0)) {
+    return DMALLOC_ERROR;
+  }
+  
+  fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    dmalloc_message("could not open snapshot file '%s'", path);
+    dmalloc_out();
+    return DMALLOC_ERROR;
+  }
+  
+  ret = _dmalloc_chunk_write_snapshot(fd);
+  (void)close(fd);
+  if (! ret) {
+    dmalloc_message("could not write snapshot file '%s'", path);
+  }
+  
+  dmalloc_out();
+  
+  if (ret) {
+    return DMALLOC_NOERROR;
+  }
+  else {
+    return DMALLOC_ERROR;
+  }
+}
+
 /*
  * void dmalloc_vmessage
  *
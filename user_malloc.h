@@ -15,6 +15,16 @@ int		dmalloc_errno;
 extern
 char		*dmalloc_logpath;
 
+/*
+ * int _dmalloc_in_library
+ *
+ * Returns 1 if this thread is already inside of the library.  Wrappers
+ * which can be called from our own code use this so they do not try
+ * to come in twice.
+ */
+extern
+int	_dmalloc_in_library(void);
+
 /*
  * void dmalloc_shutdown
  *
@@ -120,6 +130,211 @@ extern
 int	dmalloc_free(const char *file, const int line, DMALLOC_PNT pnt,
 		     const int func_id);
 
+/*
+ * int dmalloc_free_sized
+ *
+ * Release a pointer back into the heap when the caller knows its
+ * size such as with the C++ sized delete operators.  An error is
+ * generated if the size does not match the size allocated or, if the
+ * pointer was grown in place, if it is larger than the usable size.
+ *
+ * Returns FREE_NOERROR on success or FREE_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * pnt -> Existing pointer we are freeing.
+ *
+ * size -> Size of the pointer as the caller knows it.
+ *
+ * func_id -> Function-id to identify the type of call.  See
+ * dmalloc.h.
+ */
+extern
+int	dmalloc_free_sized(const char *file, const int line, DMALLOC_PNT pnt,
+			   const DMALLOC_SIZE size, const int func_id);
+
+/*
+ * int dmalloc_malloc_batch
+ *
+ * Allocate a number of memory blocks of the same size while only
+ * entering the library once.  This saves the locking, heap checking,
+ * and other per-call overhead of a malloc for each of them.  Each
+ * block still gets its own fence-posts and blanking.
+ *
+ * Returns DMALLOC_NOERROR on success or DMALLOC_ERROR on failure in
+ * which case none of the blocks are allocated.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * pnt_n -> Number of blocks to allocate.
+ *
+ * size -> Number of bytes requested for each block.
+ *
+ * pnts <- Array of pnt_n pointers which will be set to the new blocks
+ * or to NULL on failure.
+ */
+extern
+int	dmalloc_malloc_batch(const char *file, const int line,
+			     const int pnt_n, const DMALLOC_SIZE size,
+			     DMALLOC_PNT *pnts);
+
+/*
+ * int dmalloc_free_batch
+ *
+ * Release a number of pointers back into the heap while only
+ * entering the library once.  All of the pointers are freed even if
+ * some of them generate errors.
+ *
+ * Returns FREE_NOERROR on success or FREE_ERROR if any of the frees
+ * failed.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * pnt_n -> Number of pointers to free.
+ *
+ * pnts -> Array of pnt_n pointers we are freeing.
+ */
+extern
+int	dmalloc_free_batch(const char *file, const int line, const int pnt_n,
+			   DMALLOC_PNT *pnts);
+
+/*
+ * int dmalloc_region_create
+ *
+ * Create a new allocation region.  Pointers allocated into a region
+ * with dmalloc_region_alloc can be freed individually or all at once
+ * with dmalloc_region_destroy.
+ *
+ * Returns the region-id on success or 0 on failure.
+ */
+extern
+int	dmalloc_region_create(void);
+
+/*
+ * DMALLOC_PNT dmalloc_region_alloc
+ *
+ * Allocate and return a memory block of a certain size in a region.
+ *
+ * Returns a valid pointer on success or NULL on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * region -> Region-id returned by dmalloc_region_create.
+ *
+ * size -> Number of bytes requested.
+ */
+extern
+DMALLOC_PNT	dmalloc_region_alloc(const char *file, const int line,
+				     const int region, const DMALLOC_SIZE size);
+
+/*
+ * int dmalloc_region_destroy
+ *
+ * Check and free all of the pointers still allocated in a region in
+ * one pass over the heap and release the region-id.
+ *
+ * Returns DMALLOC_NOERROR on success or DMALLOC_ERROR if the region is
+ * unknown or if any of its pointers failed their checks.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * region -> Region-id returned by dmalloc_region_create.
+ */
+extern
+int	dmalloc_region_destroy(const char *file, const int line,
+			       const int region);
+
+/*
+ * int dmalloc_posix_memalign
+ *
+ * Allocate a memory block aligned to a power-of-two boundary in the
+ * manner of posix_memalign(3).
+ *
+ * Returns 0 on success, EINVAL if the alignment is not a power of two
+ * multiple of the pointer size, or ENOMEM if the allocation failed.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * memptr <- Pointer to a DMALLOC_PNT which, on success, will be set to
+ * the new block.
+ *
+ * alignment -> Value to which the allocation must be aligned.
+ *
+ * size -> Number of bytes requested.
+ */
+extern
+int	dmalloc_posix_memalign(const char *file, const int line,
+			       DMALLOC_PNT *memptr,
+			       const DMALLOC_SIZE alignment,
+			       const DMALLOC_SIZE size);
+
+/*
+ * DMALLOC_PNT dmalloc_aligned_alloc
+ *
+ * Allocate a memory block aligned to a power-of-two boundary in the
+ * manner of the C11 aligned_alloc(3).
+ *
+ * Returns a valid pointer on success or NULL on failure in which case
+ * errno is set to EINVAL if the alignment is not a power of two.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * alignment -> Value to which the allocation must be aligned.
+ *
+ * size -> Number of bytes requested.
+ */
+extern
+DMALLOC_PNT	dmalloc_aligned_alloc(const char *file, const int line,
+				      const DMALLOC_SIZE alignment,
+				      const DMALLOC_SIZE size);
+
+/*
+ * int dmalloc_try_expand
+ *
+ * Try to grow an allocation in place into the slack at the end of
+ * its chunk so containers can grow without a realloc copy.  The
+ * pointer never moves.
+ *
+ * Returns 1 if the pointer can now hold new_size bytes or 0 if it
+ * could not be grown in place.
+ *
+ * ARGUMENTS:
+ *
+ * pnt -> Existing pointer we are expanding.
+ *
+ * new_size -> Number of bytes the pointer needs to hold.
+ */
+extern
+int	dmalloc_try_expand(DMALLOC_PNT pnt, const DMALLOC_SIZE new_size);
+
 /*
  * DMALLOC_PNT dmalloc_strndup
  *
@@ -224,8 +439,7 @@ DMALLOC_PNT	recalloc(DMALLOC_PNT old_pnt, DMALLOC_SIZE new_size);
  * ARGUMENTS:
  *
  * alignment -> Value to which the allocation must be aligned.  This
- * should probably be a multiple of 2 with a maximum value equivalent
- * to the block-size which is often 1k or 4k.
+ * is rounded up to the next power of two.
  *
  * size -> Number of bytes requested.
  */
@@ -248,6 +462,65 @@ DMALLOC_PNT	memalign(DMALLOC_SIZE alignment, DMALLOC_SIZE size);
 extern
 DMALLOC_PNT	valloc(DMALLOC_SIZE size);
 
+/*
+ * int posix_memalign
+ *
+ * Overloading the posix_memalign(3) function.  Allocate a memory
+ * block of a certain size which has been aligned to a power-of-two
+ * boundary.
+ *
+ * Returns 0 on success, EINVAL if the alignment is not a power of two
+ * multiple of the pointer size, or ENOMEM if the allocation failed.
+ *
+ * ARGUMENTS:
+ *
+ * memptr <- Pointer to a DMALLOC_PNT which, on success, will be set to
+ * the new block.
+ *
+ * alignment -> Value to which the allocation must be aligned.
+ *
+ * size -> Number of bytes requested.
+ */
+extern
+int	posix_memalign(DMALLOC_PNT *memptr, DMALLOC_SIZE alignment,
+		       DMALLOC_SIZE size);
+
+/*
+ * DMALLOC_PNT aligned_alloc
+ *
+ * Overloading the C11 aligned_alloc(3) function.  Allocate and return
+ * a memory block of a certain size which has been aligned to a
+ * power-of-two boundary.
+ *
+ * Returns a valid pointer on success or NULL on failure.
+ *
+ * ARGUMENTS:
+ *
+ * alignment -> Value to which the allocation must be aligned.  This
+ * must be a power of two.
+ *
+ * size -> Number of bytes requested.
+ */
+extern
+DMALLOC_PNT	aligned_alloc(DMALLOC_SIZE alignment, DMALLOC_SIZE size);
+
+/*
+ * DMALLOC_SIZE malloc_usable_size
+ *
+ * Overloading the malloc_usable_size(3) function.  Return the number
+ * of bytes that can be used in an allocation.  Any slack at the end of
+ * the chunk is claimed for the pointer and the top fence-post moved
+ * above it so the caller can write all of the returned bytes.
+ *
+ * Returns the usable size of the pointer or 0 on error.
+ *
+ * ARGUMENTS:
+ *
+ * pnt -> Existing pointer we are examining.
+ */
+extern
+DMALLOC_SIZE	malloc_usable_size(DMALLOC_PNT pnt);
+
 #ifndef DMALLOC_STRDUP_MACRO
 /*
  * DMALLOC_PNT strdup
@@ -418,6 +691,38 @@ int	dmalloc_verify_pnt(const char *file, const int line, const char *func,
 			   const void *pnt, const int exact_b,
 			   const int min_size);
 
+/*
+ * int dmalloc_verify_ranges
+ *
+ * Verify a number of pointers with a single entry into the library.
+ * This is used by the arg_check.c functions which check a source and
+ * a destination so we only lock and do the start checks once.
+ *
+ * Returns MALLOC_VERIFY_NOERROR on success or MALLOC_VERIFY_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.  You can use
+ * __FILE__ for this argument or 0L for none.
+ *
+ * line -> Line-number of the caller.  You can use __LINE__ for this
+ * argument or 0 for none.
+ *
+ * func -> Function string which is checking the pointers.  0L if none.
+ *
+ * exact_b -> Set to 1 if the pointers were definitely handed back
+ * from a memory allocation.  See dmalloc_verify_pnt.
+ *
+ * ranges <-> Array of pointers and the sizes they need to hold.  The
+ * vr_strlen fields are set by the checks.
+ *
+ * range_n -> Number of entries in the ranges array.
+ */
+extern
+int	dmalloc_verify_ranges(const char *file, const int line,
+			      const char *func, const int exact_b,
+			      dmalloc_range_t *ranges, const int range_n);
+
 /*
  * unsigned int dmalloc_debug
  *
@@ -630,6 +935,22 @@ extern
 void	dmalloc_log_changed(const unsigned long mark, const int not_freed_b,
 			    const int free_b, const int details_b);
 
+/*
+ * int dmalloc_write_snapshot
+ *
+ * Write a binary snapshot of the pointers currently in use to a file.
+ * The dmalloc utility's --snapshot option can summarize a snapshot by
+ * allocation location or compare two of them to find the leaks.
+ *
+ * Returns [DMALLOC_NOERROR or DMALLOC_ERROR].
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the snapshot file to write.
+ */
+extern
+int	dmalloc_write_snapshot(const char *path);
+
 /*
  * void dmalloc_vmessage
  *